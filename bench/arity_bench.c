@@ -0,0 +1,75 @@
+/*
+ * Dequeue latency by heap size for the compiled PRIORITY_QUEUE_ARITY.
+ * Build with a PRIORITY_QUEUE_CAPACITY of at least 1M + PRIORITY_QUEUE_ARITY;
+ * `make bench` builds and runs this once per arity.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "priority_queue.h"
+
+#define BENCH_MAX_SIZE (1UL << 20)
+#define BENCH_ROUNDS   5
+
+static_assert(PRIORITY_QUEUE_CAPACITY - PRIORITY_QUEUE_ROOT >= BENCH_MAX_SIZE,
+              "arity_bench needs PRIORITY_QUEUE_CAPACITY >= 1M + PRIORITY_QUEUE_ARITY");
+
+struct element {
+	uint64_t key;
+};
+
+static struct element        elements[BENCH_MAX_SIZE];
+static struct priority_queue queue;
+
+static uint64_t
+element_get_key(void *element)
+{
+	return ((struct element *)element)->key;
+}
+
+static uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+int
+main(void)
+{
+	uint64_t state = UINT64_C(0x9E3779B97F4A7C15);
+	for (size_t i = 0; i < BENCH_MAX_SIZE; i++) elements[i].key = next_random_key(&state);
+
+	priority_queue_initialize(&queue, element_get_key);
+
+	for (size_t size = 256; size <= BENCH_MAX_SIZE; size *= 4) {
+		uint64_t best_ns = UINT64_MAX;
+		for (int round = 0; round < BENCH_ROUNDS; round++) {
+			priority_queue_clear(&queue);
+			for (size_t i = 0; i < size; i++) {
+				if (priority_queue_enqueue(&queue, &elements[i]) != 0) return 1;
+			}
+
+			// Drain half the heap so every timed dequeue runs against at least size/2 elements
+			uint64_t start = now_ns();
+			for (size_t i = 0; i < size / 2; i++) (void)priority_queue_dequeue(&queue);
+			uint64_t elapsed = now_ns() - start;
+			if (elapsed < best_ns) best_ns = elapsed;
+		}
+		printf("arity=%d size=%zu dequeue_ns=%.1f\n", PRIORITY_QUEUE_ARITY, size,
+		       (double)best_ns / (double)(size / 2));
+	}
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Hold-model latency of a large binary heap, for comparing the array layout
+ * with PRIORITY_QUEUE_BHEAP. Each size fills a dynamic queue with random keys,
+ * then every step dequeues the earliest element and re-enqueues it a random
+ * increment later, so the size stays constant and every dequeue sifts a leaf
+ * down from the root. `make bench` builds and runs this once per layout.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "priority_queue.h"
+
+#define BENCH_MIN_SIZE      (1UL << 16)
+#define BENCH_MAX_SIZE      (1UL << 24)
+#define BENCH_HOLD_OPS      (1UL << 21)
+#define BENCH_MAX_INCREMENT (UINT64_C(1) << 32)
+
+#ifdef PRIORITY_QUEUE_BHEAP
+#define BENCH_LAYOUT "bheap"
+#else
+#define BENCH_LAYOUT "array"
+#endif
+
+struct element {
+	uint64_t key;
+};
+
+static uint64_t
+element_get_key(void *element)
+{
+	return ((struct element *)element)->key;
+}
+
+static uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+int
+main(void)
+{
+	struct element *elements = malloc(BENCH_MAX_SIZE * sizeof(struct element));
+	if (elements == NULL) return 1;
+
+	for (size_t size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 4) {
+		struct priority_queue        queue;
+		struct priority_queue_config config = { .capacity = size, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+		uint64_t                     state  = UINT64_C(0x9E3779B97F4A7C15);
+		if (priority_queue_initialize_dynamic(&queue, element_get_key, &config) != 0) return 1;
+		for (size_t i = 0; i < size; i++) {
+			elements[i].key = next_random_key(&state) % BENCH_MAX_INCREMENT;
+			if (priority_queue_enqueue(&queue, &elements[i]) != 0) return 1;
+		}
+
+		uint64_t start = now_ns();
+		for (size_t i = 0; i < BENCH_HOLD_OPS; i++) {
+			struct element *element = priority_queue_dequeue(&queue);
+			element->key += next_random_key(&state) % BENCH_MAX_INCREMENT + 1;
+			if (priority_queue_enqueue(&queue, element) != 0) return 1;
+		}
+		uint64_t elapsed = now_ns() - start;
+		printf("layout=%s size=%zu hold_ns=%.1f\n", BENCH_LAYOUT, size, (double)elapsed / BENCH_HOLD_OPS);
+		priority_queue_destroy(&queue);
+	}
+	free(elements);
+	return 0;
+}
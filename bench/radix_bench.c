@@ -0,0 +1,127 @@
+/*
+ * Radix heap against the binary heap on deadline traces. Each trace runs the
+ * hold model: dequeue the earliest request, then re-enqueue it with a deadline
+ * a random delay after the one just dequeued, so keys only move forward.
+ * The binary heap is a fixed-capacity dynamic queue of the same size.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "priority_queue.h"
+#include "priority_queue_radix.h"
+
+#define BENCH_MIN_SIZE 1024UL
+#define BENCH_MAX_SIZE (1UL << 20)
+#define BENCH_OPS      (1UL << 21)
+
+struct element {
+	uint64_t key;
+};
+
+/* Delay distributions: short timer slices, and a wide mix of slices and long timeouts */
+static const struct {
+	const char *name;
+	uint64_t    max_delay;
+} traces[] = {
+	{ "slices", 1000 },
+	{ "timeouts", 1000000000 },
+};
+
+static uint64_t
+element_get_key(void *element)
+{
+	return ((struct element *)element)->key;
+}
+
+static uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static void
+fill(struct element *elements, size_t size, uint64_t max_delay)
+{
+	uint64_t state = UINT64_C(0x9E3779B97F4A7C15);
+	for (size_t i = 0; i < size; i++) elements[i].key = next_random_key(&state) % max_delay;
+}
+
+static double
+run_binary(struct element *elements, size_t size, uint64_t max_delay)
+{
+	struct priority_queue        queue;
+	struct priority_queue_config config = { .capacity = size, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	if (priority_queue_initialize_dynamic(&queue, element_get_key, &config) != 0) return 0;
+	fill(elements, size, max_delay);
+	for (size_t i = 0; i < size; i++) {
+		if (priority_queue_enqueue(&queue, &elements[i]) != 0) return 0;
+	}
+
+	uint64_t state = UINT64_C(0x2545F4914F6CDD1D);
+	uint64_t start = now_ns();
+	for (size_t i = 0; i < BENCH_OPS; i++) {
+		struct element *element = priority_queue_dequeue(&queue);
+		element->key += next_random_key(&state) % max_delay;
+		if (priority_queue_enqueue(&queue, element) != 0) return 0;
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	priority_queue_destroy(&queue);
+	return (double)elapsed / (double)BENCH_OPS;
+}
+
+static double
+run_radix(struct element *elements, size_t size, uint64_t max_delay)
+{
+	struct priority_queue_radix queue;
+	priority_queue_radix_initialize(&queue, element_get_key);
+	fill(elements, size, max_delay);
+	for (size_t i = 0; i < size; i++) {
+		if (priority_queue_radix_enqueue(&queue, &elements[i]) != 0) return 0;
+	}
+
+	uint64_t state = UINT64_C(0x2545F4914F6CDD1D);
+	uint64_t start = now_ns();
+	for (size_t i = 0; i < BENCH_OPS; i++) {
+		struct element *element = priority_queue_radix_dequeue(&queue);
+		element->key += next_random_key(&state) % max_delay;
+		if (priority_queue_radix_enqueue(&queue, element) != 0) return 0;
+	}
+	uint64_t elapsed = now_ns() - start;
+
+	priority_queue_radix_destroy(&queue);
+	return (double)elapsed / (double)BENCH_OPS;
+}
+
+int
+main(void)
+{
+	struct element *elements = malloc(BENCH_MAX_SIZE * sizeof(struct element));
+	if (elements == NULL) return 1;
+
+	for (size_t t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+		for (size_t size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 4) {
+			double binary_ns = run_binary(elements, size, traces[t].max_delay);
+			double radix_ns  = run_radix(elements, size, traces[t].max_delay);
+			printf("trace=%s size=%zu binary_hold_ns=%.1f radix_hold_ns=%.1f\n", traces[t].name, size, binary_ns,
+			       radix_ns);
+		}
+	}
+
+	free(elements);
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Hold-model throughput of per-worker sharded queues against one shared
+ * concurrent queue. Every operation dequeues the earliest element it can get
+ * and re-enqueues it with a later deadline, so the population stays constant.
+ * Built with the default PRIORITY_QUEUE_CAPACITY; `make bench` runs it.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "priority_queue_sharded.h"
+
+#define BENCH_MAX_THREADS     8
+#define BENCH_ELEMENTS        2048
+#define BENCH_OPS_PER_THREAD  200000
+#define BENCH_MAX_INCREMENT   1000000
+#define BENCH_STEAL_BATCH     8
+#define BENCH_STEAL_SLACK     (BENCH_MAX_INCREMENT / 4)
+
+static_assert(BENCH_ELEMENTS + PRIORITY_QUEUE_ROOT <= PRIORITY_QUEUE_CAPACITY,
+              "sharded_bench needs every element to fit in a single shard");
+
+struct element {
+	uint64_t key;
+};
+
+static struct element                   elements[BENCH_ELEMENTS];
+static struct priority_queue_concurrent shards[BENCH_MAX_THREADS];
+static struct priority_queue_concurrent shared;
+static struct priority_queue_sharded    sharded;
+
+struct worker {
+	pthread_t thread;
+	size_t    id;
+	uint64_t  state;
+	int       use_sharded;
+};
+
+static uint64_t
+element_get_key(void *element)
+{
+	return ((struct element *)element)->key;
+}
+
+static uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static void *
+hold(void *arg)
+{
+	struct worker *worker = arg;
+	for (size_t op = 0; op < BENCH_OPS_PER_THREAD; op++) {
+		struct element *element;
+		for (;;) {
+			element = worker->use_sharded ? priority_queue_sharded_dequeue(&sharded, worker->id)
+			                              : priority_queue_concurrent_dequeue(&shared);
+			if (element != NULL) break;
+			sched_yield();
+		}
+
+		element->key += next_random_key(&worker->state) % BENCH_MAX_INCREMENT + 1;
+		int rc = worker->use_sharded ? priority_queue_sharded_enqueue(&sharded, worker->id, element)
+		                             : priority_queue_concurrent_enqueue(&shared, element);
+		if (rc != 0) {
+			fprintf(stderr, "sharded_bench: enqueue failed\n");
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+static double
+run(size_t thread_count, int use_sharded)
+{
+	struct priority_queue_sharded_config config = { .steal_batch = BENCH_STEAL_BATCH,
+		                                        .steal_slack = BENCH_STEAL_SLACK };
+	uint64_t                             state  = UINT64_C(0x9E3779B97F4A7C15);
+
+	if (use_sharded) {
+		for (size_t i = 0; i < thread_count; i++) {
+			priority_queue_concurrent_initialize(&shards[i], element_get_key);
+		}
+		priority_queue_sharded_initialize(&sharded, shards, thread_count, &config);
+	} else {
+		priority_queue_concurrent_initialize(&shared, element_get_key);
+	}
+
+	for (size_t i = 0; i < BENCH_ELEMENTS; i++) {
+		elements[i].key = next_random_key(&state) % BENCH_MAX_INCREMENT;
+		int rc          = use_sharded ? priority_queue_sharded_enqueue(&sharded, i % thread_count, &elements[i])
+		                              : priority_queue_concurrent_enqueue(&shared, &elements[i]);
+		if (rc != 0) return 0;
+	}
+
+	struct worker workers[BENCH_MAX_THREADS];
+	uint64_t      start = now_ns();
+	for (size_t i = 0; i < thread_count; i++) {
+		workers[i] = (struct worker){ .id = i, .state = state + i, .use_sharded = use_sharded };
+		if (pthread_create(&workers[i].thread, NULL, hold, &workers[i]) != 0) return 0;
+	}
+	for (size_t i = 0; i < thread_count; i++) pthread_join(workers[i].thread, NULL);
+	uint64_t elapsed = now_ns() - start;
+
+	return (double)(thread_count * BENCH_OPS_PER_THREAD) * 1e3 / (double)elapsed;
+}
+
+int
+main(void)
+{
+	for (size_t threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+		double shared_mops  = run(threads, 0);
+		double sharded_mops = run(threads, 1);
+		printf("threads=%zu shared_mops=%.2f sharded_mops=%.2f\n", threads, shared_mops, sharded_mops);
+	}
+	return 0;
+}
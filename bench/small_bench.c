@@ -0,0 +1,131 @@
+/*
+ * Finds the queue size up to which PRIORITY_QUEUE_DEFINE_SMALL's sorted array
+ * beats the PRIORITY_QUEUE_DEFINE heap. Each size runs the hold model: the
+ * queue is filled with random deadlines, then every step dequeues the earliest
+ * and re-enqueues it a random increment later, so the size stays constant.
+ * struct priority_queue, with its get_key callback, is measured alongside.
+ *
+ * Prints size,heap_ns,small_ns,priority_queue_ns, one row per size, in ns per
+ * operation, then the largest size at which the sorted array was still faster.
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "priority_queue.h"
+#include "priority_queue_define.h"
+
+#define BENCH_MAX_SIZE      256
+#define BENCH_HOLD_OPS      (1UL << 22)
+#define BENCH_MAX_INCREMENT 1000
+
+struct timer {
+	uint64_t deadline;
+	void    *payload;
+};
+
+PRIORITY_QUEUE_DEFINE(heap_queue, struct timer, elem->deadline, BENCH_MAX_SIZE)
+PRIORITY_QUEUE_DEFINE_SMALL(small_queue, struct timer, elem->deadline, BENCH_MAX_SIZE)
+
+/* Keeps results observable so the loops are not optimized away */
+static volatile uint64_t sink;
+
+static uint64_t
+timer_get_key(void *element)
+{
+	return ((struct timer *)element)->deadline;
+}
+
+static uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+/* The same hold loop for both generated queues, which share one interface */
+#define BENCH_HOLD(prefix, size)                                                                                  \
+	do {                                                                                                      \
+		static struct prefix queue;                                                                       \
+		uint64_t             state = UINT64_C(0x9E3779B97F4A7C15);                                        \
+		prefix##_initialize(&queue);                                                                      \
+		for (size_t i = 0; i < (size); i++) {                                                             \
+			struct timer timer = { next_random_key(&state) % BENCH_MAX_INCREMENT, NULL };             \
+			if (prefix##_enqueue(&queue, timer) != 0) return UINT64_MAX;                              \
+		}                                                                                                 \
+		uint64_t start = now_ns();                                                                        \
+		for (size_t i = 0; i < BENCH_HOLD_OPS / 2; i++) {                                                 \
+			struct timer timer;                                                                       \
+			if (prefix##_dequeue(&queue, &timer) != 0) return UINT64_MAX;                             \
+			timer.deadline += next_random_key(&state) % BENCH_MAX_INCREMENT + 1;                      \
+			if (prefix##_enqueue(&queue, timer) != 0) return UINT64_MAX;                              \
+		}                                                                                                 \
+		uint64_t elapsed = now_ns() - start;                                                              \
+		sink += queue.min_key;                                                                            \
+		return elapsed;                                                                                   \
+	} while (0)
+
+static uint64_t
+bench_heap(size_t size)
+{
+	BENCH_HOLD(heap_queue, size);
+}
+
+static uint64_t
+bench_small(size_t size)
+{
+	BENCH_HOLD(small_queue, size);
+}
+
+static uint64_t
+bench_priority_queue(size_t size)
+{
+	static struct timer          timers[BENCH_MAX_SIZE];
+	struct priority_queue        queue;
+	struct priority_queue_config config = { .capacity = size, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	uint64_t                     state  = UINT64_C(0x9E3779B97F4A7C15);
+	if (priority_queue_initialize_dynamic(&queue, timer_get_key, &config) != 0) return UINT64_MAX;
+	for (size_t i = 0; i < size; i++) {
+		timers[i].deadline = next_random_key(&state) % BENCH_MAX_INCREMENT;
+		if (priority_queue_enqueue(&queue, &timers[i]) != 0) return UINT64_MAX;
+	}
+	uint64_t start = now_ns();
+	for (size_t i = 0; i < BENCH_HOLD_OPS / 2; i++) {
+		struct timer *timer = priority_queue_dequeue(&queue);
+		timer->deadline += next_random_key(&state) % BENCH_MAX_INCREMENT + 1;
+		if (priority_queue_enqueue(&queue, timer) != 0) return UINT64_MAX;
+	}
+	uint64_t elapsed = now_ns() - start;
+	sink += queue.min_key;
+	priority_queue_destroy(&queue);
+	return elapsed;
+}
+
+int
+main(void)
+{
+	size_t crossover = 0;
+	printf("size,heap_ns,small_ns,priority_queue_ns\n");
+	for (size_t size = 2; size <= BENCH_MAX_SIZE; size *= 2) {
+		uint64_t heap  = bench_heap(size);
+		uint64_t small = bench_small(size);
+		uint64_t pq    = bench_priority_queue(size);
+		if (heap == UINT64_MAX || small == UINT64_MAX || pq == UINT64_MAX) return 1;
+		printf("%zu,%.2f,%.2f,%.2f\n", size, (double)heap / BENCH_HOLD_OPS, (double)small / BENCH_HOLD_OPS,
+		       (double)pq / BENCH_HOLD_OPS);
+		if (small < heap) crossover = size;
+	}
+	printf("# sorted array faster up to size %zu\n", crossover);
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Replays a trace written by priority_queue_trace_dump against this build of
+ * the queue, once per growth policy, and reports throughput and per-operation
+ * latency. Operations run back to back; the recorded timestamps are not used
+ * for pacing, so a replay is deterministic. Each policy runs twice: untimed,
+ * for ops/sec, and timing every operation, for percentiles.
+ *
+ * A dequeue that finds the queue empty is skipped, which happens when the ring
+ * dropped the enqueues that preceded it. A dequeue whose key differs from the
+ * recorded one counts as a mismatch; for a complete trace there are none.
+ *
+ * Usage: bench_replay <trace> [noheader]; `make replay TRACE=<trace>` runs it
+ * at each arity.
+ */
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "priority_queue.h"
+#include "priority_queue_trace.h"
+
+/* Initial capacity of the growing policies */
+#define REPLAY_INITIAL_CAPACITY 64
+
+struct element {
+	uint64_t key;
+};
+
+struct replay_result {
+	size_t   ops;
+	uint64_t elapsed_ns;
+	size_t   skipped;    /* dequeues on an empty queue and enqueues on a full one */
+	size_t   mismatches; /* dequeues that returned a different key than recorded */
+};
+
+static uint64_t
+element_get_key(void *element)
+{
+	return ((struct element *)element)->key;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static uint64_t
+percentile(const uint64_t *sorted, size_t count, double fraction)
+{
+	if (count == 0) return 0;
+	return sorted[(size_t)(fraction * (double)(count - 1))];
+}
+
+/* Largest number of elements the trace ever has queued, for sizing the fixed policy */
+static size_t
+trace_peak_length(const struct priority_queue_trace_record *records, size_t count)
+{
+	size_t length = 0, peak = 0;
+	for (size_t i = 0; i < count; i++) {
+		switch (priority_queue_trace_record_op(&records[i])) {
+		case PRIORITY_QUEUE_TRACE_ENQUEUE:
+			if (++length > peak) peak = length;
+			break;
+		case PRIORITY_QUEUE_TRACE_DEQUEUE:
+			if (length > 0) length--;
+			break;
+		case PRIORITY_QUEUE_TRACE_CLEAR:
+			length = 0;
+			break;
+		}
+	}
+	return peak;
+}
+
+/* Runs every record against queue; samples, when not NULL, receives each operation's ns */
+static void
+replay_run(struct priority_queue *queue, const struct priority_queue_trace_record *records, size_t count,
+           struct element *elements, uint64_t *samples, struct replay_result *result)
+{
+	memset(result, 0, sizeof(*result));
+	size_t   next_element = 0;
+	uint64_t start        = now_ns();
+	for (size_t i = 0; i < count; i++) {
+		uint64_t        op_start = samples != NULL ? now_ns() : 0;
+		struct element *element;
+		switch (priority_queue_trace_record_op(&records[i])) {
+		case PRIORITY_QUEUE_TRACE_ENQUEUE:
+			element      = &elements[next_element++];
+			element->key = records[i].key;
+			if (priority_queue_enqueue(queue, element) != 0) result->skipped++;
+			break;
+		case PRIORITY_QUEUE_TRACE_DEQUEUE:
+			element = priority_queue_dequeue(queue);
+			if (element == NULL) {
+				result->skipped++;
+			} else if (element->key != records[i].key) {
+				result->mismatches++;
+			}
+			break;
+		case PRIORITY_QUEUE_TRACE_CLEAR:
+			priority_queue_clear(queue);
+			break;
+		}
+		if (samples != NULL) samples[i] = now_ns() - op_start;
+	}
+	result->elapsed_ns = now_ns() - start;
+	result->ops        = count;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "noheader") != 0)) {
+		fprintf(stderr, "usage: %s <trace> [noheader]\n", argv[0]);
+		return 2;
+	}
+
+	FILE *in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	struct priority_queue_trace_record *records;
+	size_t                              count;
+	int                                 status = priority_queue_trace_load(in, &records, &count);
+	fclose(in);
+	if (status != 0) {
+		fprintf(stderr, "%s: %s\n", argv[1],
+		        status == PRIORITY_QUEUE_TRACE_BAD_FORMAT ? "not a priority queue trace" : "read failed");
+		return 1;
+	}
+
+	size_t enqueues = 0;
+	for (size_t i = 0; i < count; i++) {
+		enqueues += priority_queue_trace_record_op(&records[i]) == PRIORITY_QUEUE_TRACE_ENQUEUE;
+	}
+	size_t          peak     = trace_peak_length(records, count);
+	struct element *elements = malloc((enqueues > 0 ? enqueues : 1) * sizeof(struct element));
+	uint64_t       *samples  = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+	if (elements == NULL || samples == NULL) return 1;
+
+	const struct {
+		const char                  *name;
+		struct priority_queue_config config;
+	} policies[] = {
+		{ "fixed", { .capacity = peak > 0 ? peak : 1, .growth = PRIORITY_QUEUE_GROWTH_FIXED } },
+		{ "double", { .capacity = REPLAY_INITIAL_CAPACITY, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE } },
+		{ "double_shrink",
+		  { .capacity = REPLAY_INITIAL_CAPACITY, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK } },
+	};
+
+	if (argc == 2) printf("arity,policy,records,peak,ops_per_sec,p50_ns,p99_ns,p999_ns,skipped,mismatches\n");
+	for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+		struct priority_queue queue;
+		struct replay_result  untimed, timed;
+
+		// Untimed pass: throughput without clock reads around each operation
+		if (priority_queue_initialize_dynamic(&queue, element_get_key, &policies[p].config) != 0) return 1;
+		replay_run(&queue, records, count, elements, NULL, &untimed);
+		priority_queue_destroy(&queue);
+
+		if (priority_queue_initialize_dynamic(&queue, element_get_key, &policies[p].config) != 0) return 1;
+		replay_run(&queue, records, count, elements, samples, &timed);
+		priority_queue_destroy(&queue);
+		qsort(samples, count, sizeof(uint64_t), compare_u64);
+
+		double seconds = (double)(untimed.elapsed_ns > 0 ? untimed.elapsed_ns : 1) / 1e9;
+		printf("%d,%s,%zu,%zu,%.0f,%llu,%llu,%llu,%zu,%zu\n", PRIORITY_QUEUE_ARITY, policies[p].name, count,
+		       peak, (double)untimed.ops / seconds, (unsigned long long)percentile(samples, count, 0.50),
+		       (unsigned long long)percentile(samples, count, 0.99),
+		       (unsigned long long)percentile(samples, count, 0.999), untimed.skipped, untimed.mismatches);
+	}
+
+	free(samples);
+	free(elements);
+	free(records);
+	return 0;
+}
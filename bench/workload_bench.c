@@ -0,0 +1,452 @@
+/*
+ * Throughput and per-operation latency of the heap across workloads and sizes.
+ * Each workload runs twice per size: once untimed per operation, for ops/sec
+ * and hardware counters, and once timing every operation, for percentiles.
+ * Cache and branch misses come from perf_event_open when the kernel allows it
+ * and are left empty (CSV) or null (JSON) otherwise.
+ *
+ * Usage: bench_workloads [csv|json]; `make bench` writes
+ * bin/bench_workloads.$(BENCH_FORMAT).
+ */
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "priority_queue.h"
+
+#define BENCH_MIN_SIZE       1024UL
+#define BENCH_MAX_SIZE       (1UL << 20)
+#define BENCH_HOLD_OPS       (1UL << 20)
+#define BENCH_MAX_INCREMENT  1000000
+#define BENCH_SAWTOOTH_TEETH 1024
+#define BENCH_MAX_BURST      4096
+
+struct element {
+	uint64_t key;
+};
+
+struct bench_run {
+	struct priority_queue queue;
+	struct element       *elements;
+	size_t                size;
+	uint64_t              state;
+	uint64_t             *samples; /* per-operation ns, or NULL when only counting */
+	size_t                sample_count;
+	size_t                ops;
+	bool                  failed;
+};
+
+struct bench_counters {
+	int      group_fd;
+	int      branch_fd;
+	uint64_t cache_misses;
+	uint64_t branch_misses;
+	bool     available;
+};
+
+static uint64_t
+element_get_key(void *element)
+{
+	return ((struct element *)element)->key;
+}
+
+static uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+/*****************************
+ * Timed queue operations    *
+ *****************************/
+
+static inline void
+bench_enqueue(struct bench_run *run, struct element *element)
+{
+	uint64_t start = run->samples != NULL ? now_ns() : 0;
+	if (priority_queue_enqueue(&run->queue, element) != 0) run->failed = true;
+	if (run->samples != NULL) run->samples[run->sample_count++] = now_ns() - start;
+	run->ops++;
+}
+
+static inline struct element *
+bench_dequeue(struct bench_run *run)
+{
+	uint64_t        start   = run->samples != NULL ? now_ns() : 0;
+	struct element *element = priority_queue_dequeue(&run->queue);
+	if (run->samples != NULL) run->samples[run->sample_count++] = now_ns() - start;
+	if (element == NULL) run->failed = true;
+	run->ops++;
+	return element;
+}
+
+static void
+bench_drain(struct bench_run *run)
+{
+	while (!priority_queue_is_empty(&run->queue)) (void)bench_dequeue(run);
+}
+
+/*****************************
+ * Workloads                 *
+ *****************************/
+
+/* Fill with uniformly random keys, then drain */
+static void
+workload_random(struct bench_run *run)
+{
+	for (size_t i = 0; i < run->size; i++) {
+		run->elements[i].key = next_random_key(&run->state);
+		bench_enqueue(run, &run->elements[i]);
+	}
+	bench_drain(run);
+}
+
+/* Fill with strictly increasing deadlines, the common case for timers, then drain */
+static void
+workload_monotone(struct bench_run *run)
+{
+	for (size_t i = 0; i < run->size; i++) {
+		run->elements[i].key = i;
+		bench_enqueue(run, &run->elements[i]);
+	}
+	bench_drain(run);
+}
+
+/* Fill with rising ramps that fall back to near zero, then drain */
+static void
+workload_sawtooth(struct bench_run *run)
+{
+	size_t period = run->size / BENCH_SAWTOOTH_TEETH > 0 ? run->size / BENCH_SAWTOOTH_TEETH : 1;
+	for (size_t i = 0; i < run->size; i++) {
+		run->elements[i].key = (i % period) * BENCH_SAWTOOTH_TEETH + i / period;
+		bench_enqueue(run, &run->elements[i]);
+	}
+	bench_drain(run);
+}
+
+/* Keep the heap at size: each step dequeues the earliest and re-enqueues it later */
+static void
+workload_hold(struct bench_run *run)
+{
+	for (size_t i = 0; i < run->size; i++) {
+		run->elements[i].key = next_random_key(&run->state) % BENCH_MAX_INCREMENT;
+		if (priority_queue_enqueue(&run->queue, &run->elements[i]) != 0) run->failed = true;
+	}
+	for (size_t i = 0; i < BENCH_HOLD_OPS / 2 && !run->failed; i++) {
+		struct element *element = bench_dequeue(run);
+		element->key += next_random_key(&run->state) % BENCH_MAX_INCREMENT + 1;
+		bench_enqueue(run, element);
+	}
+	priority_queue_clear(&run->queue);
+}
+
+/* Half full, then alternate a burst of near-future inserts with an equal burst of dequeues */
+static void
+workload_bursty(struct bench_run *run)
+{
+	size_t resident = run->size / 2;
+	size_t burst    = run->size - resident < BENCH_MAX_BURST ? run->size - resident : BENCH_MAX_BURST;
+	for (size_t i = 0; i < resident; i++) {
+		run->elements[i].key = next_random_key(&run->state) % BENCH_MAX_INCREMENT;
+		if (priority_queue_enqueue(&run->queue, &run->elements[i]) != 0) run->failed = true;
+	}
+
+	// Dequeued elements are recycled into the next burst
+	struct element **spare = malloc(burst * sizeof(struct element *));
+	if (spare == NULL) {
+		run->failed = true;
+		return;
+	}
+	for (size_t i = 0; i < burst; i++) spare[i] = &run->elements[resident + i];
+
+	uint64_t now = 0;
+	for (size_t round = 0; round < BENCH_HOLD_OPS / (2 * burst) && !run->failed; round++) {
+		for (size_t i = 0; i < burst; i++) {
+			spare[i]->key = now + next_random_key(&run->state) % BENCH_MAX_INCREMENT;
+			bench_enqueue(run, spare[i]);
+		}
+		for (size_t i = 0; i < burst && !run->failed; i++) {
+			spare[i] = bench_dequeue(run);
+			now      = spare[i]->key;
+		}
+	}
+	free(spare);
+	priority_queue_clear(&run->queue);
+}
+
+static size_t
+fill_drain_ops(size_t size)
+{
+	return 2 * size;
+}
+
+static size_t
+hold_ops(size_t size)
+{
+	(void)size;
+	return BENCH_HOLD_OPS;
+}
+
+static const struct {
+	const char *name;
+	void (*run)(struct bench_run *run);
+	size_t (*max_ops)(size_t size); /* upper bound on operations at a given size */
+} workloads[] = {
+	{ "random", workload_random, fill_drain_ops },   { "monotone", workload_monotone, fill_drain_ops },
+	{ "sawtooth", workload_sawtooth, fill_drain_ops }, { "hold", workload_hold, hold_ops },
+	{ "bursty", workload_bursty, hold_ops },
+};
+
+/*****************************
+ * Hardware counters         *
+ *****************************/
+
+#ifdef __linux__
+static int
+perf_open(uint64_t config, int group_fd)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type           = PERF_TYPE_HARDWARE;
+	attr.size           = sizeof(attr);
+	attr.config         = config;
+	attr.disabled       = group_fd == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	attr.read_format    = PERF_FORMAT_GROUP;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+static void
+counters_open(struct bench_counters *counters)
+{
+	counters->group_fd      = -1;
+	counters->branch_fd     = -1;
+	counters->cache_misses  = 0;
+	counters->branch_misses = 0;
+	counters->available     = false;
+#ifdef __linux__
+	counters->group_fd = perf_open(PERF_COUNT_HW_CACHE_MISSES, -1);
+	if (counters->group_fd < 0) return;
+	counters->branch_fd = perf_open(PERF_COUNT_HW_BRANCH_MISSES, counters->group_fd);
+	if (counters->branch_fd < 0) {
+		close(counters->group_fd);
+		counters->group_fd = -1;
+		return;
+	}
+	counters->available = true;
+#endif
+}
+
+static void
+counters_close(struct bench_counters *counters)
+{
+#ifdef __linux__
+	if (counters->branch_fd >= 0) close(counters->branch_fd);
+	if (counters->group_fd >= 0) close(counters->group_fd);
+#endif
+	counters->available = false;
+}
+
+static void
+counters_start(struct bench_counters *counters)
+{
+#ifdef __linux__
+	if (!counters->available) return;
+	ioctl(counters->group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(counters->group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+	(void)counters;
+#endif
+}
+
+static void
+counters_stop(struct bench_counters *counters)
+{
+#ifdef __linux__
+	if (!counters->available) return;
+	ioctl(counters->group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	struct {
+		uint64_t count;
+		uint64_t values[2];
+	} group;
+	if (read(counters->group_fd, &group, sizeof(group)) != (ssize_t)sizeof(group) || group.count != 2) {
+		counters_close(counters);
+		return;
+	}
+	counters->cache_misses  = group.values[0];
+	counters->branch_misses = group.values[1];
+#else
+	(void)counters;
+#endif
+}
+
+/*****************************
+ * Reporting                 *
+ *****************************/
+
+struct bench_result {
+	const char *workload;
+	size_t      size;
+	size_t      ops;
+	double      ops_per_sec;
+	uint64_t    p50_ns;
+	uint64_t    p99_ns;
+	uint64_t    p999_ns;
+	bool        has_counters;
+	uint64_t    cache_misses;
+	uint64_t    branch_misses;
+};
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static uint64_t
+percentile(const uint64_t *sorted, size_t count, double fraction)
+{
+	if (count == 0) return 0;
+	return sorted[(size_t)(fraction * (double)(count - 1))];
+}
+
+static void
+print_result(const struct bench_result *result, bool json, bool first)
+{
+	if (json) {
+		printf("%s\n  {\"workload\": \"%s\", \"size\": %zu, \"ops\": %zu, \"ops_per_sec\": %.0f, "
+		       "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, ",
+		       first ? "" : ",", result->workload, result->size, result->ops, result->ops_per_sec,
+		       (unsigned long long)result->p50_ns, (unsigned long long)result->p99_ns,
+		       (unsigned long long)result->p999_ns);
+		if (result->has_counters) {
+			printf("\"cache_misses\": %llu, \"branch_misses\": %llu}", (unsigned long long)result->cache_misses,
+			       (unsigned long long)result->branch_misses);
+		} else {
+			printf("\"cache_misses\": null, \"branch_misses\": null}");
+		}
+	} else {
+		printf("%s,%zu,%zu,%.0f,%llu,%llu,%llu,", result->workload, result->size, result->ops,
+		       result->ops_per_sec, (unsigned long long)result->p50_ns, (unsigned long long)result->p99_ns,
+		       (unsigned long long)result->p999_ns);
+		if (result->has_counters) {
+			printf("%llu,%llu\n", (unsigned long long)result->cache_misses,
+			       (unsigned long long)result->branch_misses);
+		} else {
+			printf(",\n");
+		}
+	}
+}
+
+/*****************************
+ * Driver                    *
+ *****************************/
+
+static bool
+bench_prepare(struct bench_run *run, struct element *elements, size_t size, uint64_t *samples)
+{
+	struct priority_queue_config config = { .capacity = size, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	if (priority_queue_initialize_dynamic(&run->queue, element_get_key, &config) != 0) return false;
+	run->elements     = elements;
+	run->size         = size;
+	run->state        = UINT64_C(0x9E3779B97F4A7C15);
+	run->samples      = samples;
+	run->sample_count = 0;
+	run->ops          = 0;
+	run->failed       = false;
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	bool json = argc > 1 && strcmp(argv[1], "json") == 0;
+	if (argc > 1 && !json && strcmp(argv[1], "csv") != 0) {
+		fprintf(stderr, "usage: %s [csv|json]\n", argv[0]);
+		return 2;
+	}
+
+	struct element *elements = malloc(BENCH_MAX_SIZE * sizeof(struct element));
+	uint64_t       *samples  = malloc((2 * BENCH_MAX_SIZE > BENCH_HOLD_OPS ? 2 * BENCH_MAX_SIZE : BENCH_HOLD_OPS)
+	                                  * sizeof(uint64_t));
+	if (elements == NULL || samples == NULL) return 1;
+
+	struct bench_counters counters;
+	counters_open(&counters);
+
+	if (json) {
+		printf("[");
+	} else {
+		printf("workload,size,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,cache_misses,branch_misses\n");
+	}
+
+	bool first = true;
+	for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+		for (size_t size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 4) {
+			struct bench_result result = { .workload = workloads[w].name, .size = size };
+			struct bench_run    run;
+
+			// Untimed pass: throughput and counters without clock reads in the loop
+			if (!bench_prepare(&run, elements, size, NULL)) return 1;
+			counters_start(&counters);
+			uint64_t start = now_ns();
+			workloads[w].run(&run);
+			uint64_t elapsed = now_ns() - start;
+			counters_stop(&counters);
+			priority_queue_destroy(&run.queue);
+			if (run.failed) return 1;
+
+			result.ops           = run.ops;
+			result.ops_per_sec   = (double)run.ops * 1e9 / (double)(elapsed > 0 ? elapsed : 1);
+			result.has_counters  = counters.available;
+			result.cache_misses  = counters.cache_misses;
+			result.branch_misses = counters.branch_misses;
+
+			// Timed pass: the same operations, each bracketed by clock reads
+			if (!bench_prepare(&run, elements, size, samples)) return 1;
+			workloads[w].run(&run);
+			priority_queue_destroy(&run.queue);
+			if (run.failed || run.sample_count > workloads[w].max_ops(size)) return 1;
+
+			qsort(samples, run.sample_count, sizeof(uint64_t), compare_u64);
+			result.p50_ns  = percentile(samples, run.sample_count, 0.50);
+			result.p99_ns  = percentile(samples, run.sample_count, 0.99);
+			result.p999_ns = percentile(samples, run.sample_count, 0.999);
+
+			print_result(&result, json, first);
+			first = false;
+		}
+	}
+	if (json) printf("\n]\n");
+
+	counters_close(&counters);
+	free(samples);
+	free(elements);
+	return 0;
+}
@@ -1,12 +1,69 @@
 #ifndef PRIORITY_QUEUE_H
 #define PRIORITY_QUEUE_H
 
+/* Slots embedded in every struct priority_queue for priority_queue_initialize.
+ * Set to 0 to drop the embedded storage when every queue in the program is
+ * created with priority_queue_initialize_dynamic. */
 #ifndef PRIORITY_QUEUE_CAPACITY
 #define PRIORITY_QUEUE_CAPACITY 4096
 #endif
 
-#if PRIORITY_QUEUE_CAPACITY < 2
-#error "PRIORITY_QUEUE_CAPACITY must be at least 2 (index 0 is unused in the 1-indexed heap)"
+/* Number of children per heap node. Must be a power of two so that each group
+ * of siblings starts on a multiple of the arity and, with 8-byte keys, a 4-ary
+ * or 8-ary group never straddles a cache line. */
+#ifndef PRIORITY_QUEUE_ARITY
+#define PRIORITY_QUEUE_ARITY 2
+#endif
+
+#if PRIORITY_QUEUE_ARITY < 2 || PRIORITY_QUEUE_ARITY > 16 || (PRIORITY_QUEUE_ARITY & (PRIORITY_QUEUE_ARITY - 1)) != 0
+#error "PRIORITY_QUEUE_ARITY must be a power of two between 2 and 16"
+#endif
+
+/* Find the smallest of a full group of 4 or more children with AVX2 or SSE4.2
+ * when the CPU has them, checked once at load time, instead of a scalar scan.
+ * Set to 0 to always use the scalar scan. */
+#ifndef PRIORITY_QUEUE_SIMD
+#if PRIORITY_QUEUE_ARITY >= 4 && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PRIORITY_QUEUE_SIMD 1
+#else
+#define PRIORITY_QUEUE_SIMD 0
+#endif
+#endif
+
+/* Index of the heap root. Slots below it are padding: placing the root at
+ * ARITY-1 makes the children of node i start at ARITY*(i-ARITY+2), which is
+ * always a multiple of ARITY. For the default binary heap this is the classic
+ * 1-indexed layout (root at 1, children at 2*i and 2*i+1). */
+#define PRIORITY_QUEUE_ROOT (PRIORITY_QUEUE_ARITY - 1)
+
+#ifndef PRIORITY_QUEUE_CACHE_LINE
+#define PRIORITY_QUEUE_CACHE_LINE 64
+#endif
+
+/* Define PRIORITY_QUEUE_BHEAP to lay the binary heap out as a B-heap: slots
+ * are grouped into pages of PRIORITY_QUEUE_BHEAP_PAGE, each holding small
+ * subtrees whole, so a root-to-leaf path crosses one page per subtree instead
+ * of one per level. The root stays at slot 1 and a queue of n elements still
+ * fills slots 1..n, so only the parent and child arithmetic differs. */
+#ifdef PRIORITY_QUEUE_BHEAP
+#if PRIORITY_QUEUE_ARITY != 2
+#error "PRIORITY_QUEUE_BHEAP requires PRIORITY_QUEUE_ARITY 2"
+#endif
+/* Slots per page; 512 8-byte keys fill a 4 KB page */
+#ifndef PRIORITY_QUEUE_BHEAP_PAGE
+#define PRIORITY_QUEUE_BHEAP_PAGE 512
+#endif
+#if PRIORITY_QUEUE_BHEAP_PAGE < 4 || (PRIORITY_QUEUE_BHEAP_PAGE & (PRIORITY_QUEUE_BHEAP_PAGE - 1)) != 0
+#error "PRIORITY_QUEUE_BHEAP_PAGE must be a power of two of at least 4"
+#endif
+/* The first child of a page's bottom row lands in a later page, at most PAGE * i */
+#define PRIORITY_QUEUE_CHILD_FACTOR PRIORITY_QUEUE_BHEAP_PAGE
+#else
+#define PRIORITY_QUEUE_CHILD_FACTOR PRIORITY_QUEUE_ARITY
+#endif
+
+#if PRIORITY_QUEUE_CAPACITY != 0 && PRIORITY_QUEUE_CAPACITY < PRIORITY_QUEUE_ROOT + 1
+#error "PRIORITY_QUEUE_CAPACITY must be at least PRIORITY_QUEUE_ARITY (slots below the root are unused)"
 #endif
 
 #include <assert.h>
@@ -14,12 +71,15 @@
 #include <stddef.h>
 #include <stdint.h>
 
-/* Child indices are computed as 2*i and 2*i+1 using size_t arithmetic.
- * SIZE_MAX is always odd (2^N - 1 for an N-bit type), so at i = SIZE_MAX/2:
- * 2*i = SIZE_MAX-1 and 2*i+1 = SIZE_MAX — both representable, no overflow.
- * Capacities above SIZE_MAX/2 would allow i to exceed this bound. */
-static_assert(PRIORITY_QUEUE_CAPACITY <= SIZE_MAX / 2,
-              "PRIORITY_QUEUE_CAPACITY must be at most SIZE_MAX/2 to avoid size_t overflow in child index calculations");
+/* Child indices are computed as ARITY*(i-ARITY+2) .. ARITY*(i-ARITY+2)+ARITY-1
+ * using size_t arithmetic. That is at most ARITY*i+1, and SIZE_MAX is always
+ * 2^N - 1, so for i <= SIZE_MAX/ARITY the last child is at most
+ * SIZE_MAX-ARITY+1 — representable, no overflow. For the binary heap this is
+ * the familiar 2*i+1 <= SIZE_MAX bound at i = SIZE_MAX/2. A B-heap's children
+ * stay below PAGE*i, hence the bound on PRIORITY_QUEUE_CHILD_FACTOR. */
+static_assert(PRIORITY_QUEUE_CAPACITY <= SIZE_MAX / PRIORITY_QUEUE_CHILD_FACTOR,
+              "PRIORITY_QUEUE_CAPACITY must be at most SIZE_MAX/PRIORITY_QUEUE_CHILD_FACTOR to avoid size_t overflow "
+              "in child index calculations");
 static_assert(SIZE_MAX % 2 == 1, "SIZE_MAX must be odd (size_t uses pure binary representation per C11 §6.2.6.2)");
 
 #if defined(__GNUC__) || defined(__clang__)
@@ -31,27 +91,196 @@ static_assert(SIZE_MAX % 2 == 1, "SIZE_MAX must be odd (size_t uses pure binary
 /**
  * How to get the priority out of the generic element
  * Extracts the ordering key from an element as a uint64_t (e.g. deadline in
- * cycles or UNIX time in ms). Used to maintain a cached copy of the minimum
- * key currently in the heap.
+ * cycles or UNIX time in ms). Called once per element on enqueue; the result
+ * is cached in keys[] next to the element, so an element's key must not change
+ * while it is queued.
  * @param element
  * @returns priority (a u64)
  **/
 typedef uint64_t (*priority_queue_get_key_t)(void *element);
 
+/**
+ * How much work an element stands for, e.g. its estimated execution time.
+ * Optional; see priority_queue_set_get_cost. Like the key, an element's cost
+ * must not change while it is queued: it is read again when the element leaves.
+ * @param element
+ * @returns cost (a u64)
+ **/
+typedef uint64_t (*priority_queue_get_cost_t)(void *element);
+
+/* Index field value of an element that is not queued, and the index_offset of
+ * a queue that is not in indexed mode */
+#define PRIORITY_QUEUE_UNINDEXED SIZE_MAX
+
+/**
+ * Storage callbacks for dynamic queues. allocate must return memory aligned to
+ * at least alignment bytes, or NULL on failure; release receives the same size
+ * that was passed to allocate.
+ **/
+struct priority_queue_allocator {
+	void *(*allocate)(void *context, size_t size, size_t alignment);
+	void (*release)(void *context, void *ptr, size_t size);
+	void *context;
+};
+
+enum priority_queue_growth
+{
+	PRIORITY_QUEUE_GROWTH_FIXED,         /* never resize; enqueue fails when full */
+	PRIORITY_QUEUE_GROWTH_DOUBLE,        /* double the capacity when full */
+	PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK, /* also halve it when a quarter full, down to the initial capacity */
+};
+
+struct priority_queue_config {
+	size_t                                 capacity;     /* initial number of elements */
+	size_t                                 max_capacity; /* growth limit in elements, 0 for no limit */
+	enum priority_queue_growth             growth;
+	const struct priority_queue_allocator *allocator; /* NULL for aligned_alloc/free */
+	bool                                   indexed;   /* see priority_queue_initialize_indexed */
+	size_t                                 index_offset;
+	priority_queue_get_cost_t              get_cost; /* NULL to keep no aggregates; see priority_queue_set_get_cost */
+};
+
+/**
+ * Running totals over the queued elements for admission control, read with
+ * priority_queue_get_aggregates
+ **/
+struct priority_queue_aggregates {
+	size_t   count;
+	uint64_t total_cost; /* sum of get_cost, wrapping modulo 2^64 */
+	uint64_t key_sum;    /* sum of keys, wrapping modulo 2^64 */
+	uint64_t min_key;    /* UINT64_MAX when empty */
+	uint64_t max_key;    /* 0 when empty */
+};
+
+#ifdef PRIORITY_QUEUE_STATS
+/* Buckets in each percolation depth histogram; the last one also counts deeper percolations */
+#ifndef PRIORITY_QUEUE_STATS_DEPTHS
+#define PRIORITY_QUEUE_STATS_DEPTHS 32
+#endif
+
+/**
+ * Hot-path counters, compiled in only with -DPRIORITY_QUEUE_STATS. They count
+ * from initialization or the last priority_queue_reset_stats, across clears.
+ **/
+struct priority_queue_stats {
+	uint64_t comparisons;     /* key comparisons */
+	uint64_t moves;           /* element moves between slots; a swap counts as two */
+	uint64_t get_key_calls;   /* calls to the get_key callback */
+	uint64_t full_rejections; /* elements turned away by a full queue in enqueue or enqueue_batch */
+	size_t   high_water;      /* largest number of elements queued at once */
+	uint64_t percolate_up_depth[PRIORITY_QUEUE_STATS_DEPTHS];   /* [d]: percolations that moved d levels */
+	uint64_t percolate_down_depth[PRIORITY_QUEUE_STATS_DEPTHS]; /* likewise, including heapify's */
+};
+#endif
+
+#ifdef PRIORITY_QUEUE_TRACE
+/* See priority_queue_trace.h */
+struct priority_queue_trace;
+#endif
+
+/* Elements one priority_queue_peek_k call returns at most; its frontier lives on the stack */
+#ifndef PRIORITY_QUEUE_PEEK_K_MAX
+#define PRIORITY_QUEUE_PEEK_K_MAX 256
+#endif
+
+/**
+ * An iterator frontier entry: a sibling group with slots not yet visited.
+ * index is the unvisited slot with the smallest key.
+ **/
+struct priority_queue_cursor {
+	size_t   index;
+	uint32_t unvisited; /* bit slot % PRIORITY_QUEUE_ARITY set for each unvisited slot of the group */
+};
+
+/**
+ * Walks a queue in ascending key order without writing to it. The frontier is
+ * a small binary heap of sibling groups whose parent was already visited, so
+ * each step costs O(PRIORITY_QUEUE_ARITY + log k) and the first k elements
+ * need only k frontier entries. Any change to the queue invalidates the
+ * iterator.
+ **/
+struct priority_queue_iterator {
+	const struct priority_queue  *queue;
+	struct priority_queue_cursor *frontier; /* caller-owned, frontier_capacity entries */
+	size_t                        frontier_length;
+	size_t                        remaining; /* elements still to visit before the frontier could overflow */
+	size_t                        last;      /* slot visited by the previous step, SIZE_MAX before the first */
+};
+
+/* keys[] and items[] are cache-line aligned so that sibling groups, which start
+ * on multiples of PRIORITY_QUEUE_ARITY, share as few lines as possible. Queues
+ * with embedded storage that are placed on the heap must therefore use
+ * aligned_alloc. */
 struct priority_queue {
-	uint64_t                      min_key; /* cached key of the heap root */
-	void                         *items[PRIORITY_QUEUE_CAPACITY];
-	size_t                        first_free;
+	uint64_t                 min_key; /* cached key of the heap root */
+	uint64_t                *keys;    /* keys[i] caches get_key(items[i]) */
+	void                   **items;
+	size_t                   first_free;
+	size_t                   capacity; /* slots in keys[] and items[], including the padding below the root */
 	priority_queue_get_key_t get_key;
+	size_t                   index_offset; /* offset of the element's slot index field, or PRIORITY_QUEUE_UNINDEXED */
+
+	/* Aggregates, maintained on every enqueue and removal only while get_cost is set */
+	priority_queue_get_cost_t get_cost;
+	uint64_t                  total_cost;
+	uint64_t                  key_sum;
+	uint64_t                  max_key;
+	bool                      max_key_stale; /* max_key is only an upper bound until get_aggregates rescans */
+
+	/* Dynamic queues only; allocator is NULL when keys[] and items[] are the embedded storage */
+	const struct priority_queue_allocator *allocator;
+	enum priority_queue_growth             growth;
+	size_t                                 min_capacity; /* slots, never shrink below */
+	size_t                                 max_capacity; /* slots, never grow above */
+	bool                                   growth_failed; /* allocator refused to grow; cleared on removal */
+
+#ifdef PRIORITY_QUEUE_STATS
+	struct priority_queue_stats stats;
+#endif
+#ifdef PRIORITY_QUEUE_TRACE
+	struct priority_queue_trace *trace; /* NULL when not tracing */
+#endif
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) uint64_t key_storage[PRIORITY_QUEUE_CAPACITY];
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) void *item_storage[PRIORITY_QUEUE_CAPACITY];
+#endif
 };
 
-void   priority_queue_initialize(struct priority_queue *const self, priority_queue_get_key_t get_key);
+#if PRIORITY_QUEUE_CAPACITY > 0
+void priority_queue_initialize(struct priority_queue *const self, priority_queue_get_key_t get_key);
+void priority_queue_initialize_indexed(struct priority_queue *const self, priority_queue_get_key_t get_key,
+                                       size_t index_offset);
+#endif
+WARN_UNUSED_RESULT int priority_queue_initialize_dynamic(struct priority_queue *const       self,
+                                                         priority_queue_get_key_t           get_key,
+                                                         const struct priority_queue_config *config);
+void   priority_queue_destroy(struct priority_queue *const self);
 void   priority_queue_clear(struct priority_queue *const self);
 WARN_UNUSED_RESULT int priority_queue_enqueue(struct priority_queue *const self, void *value);
+WARN_UNUSED_RESULT size_t priority_queue_enqueue_batch(struct priority_queue *const self, void **values, size_t n);
 void  *priority_queue_dequeue(struct priority_queue *const self);
+WARN_UNUSED_RESULT int priority_queue_remove(struct priority_queue *const self, void *value);
+WARN_UNUSED_RESULT int priority_queue_update_key(struct priority_queue *const self, void *value);
+size_t priority_queue_dequeue_until(struct priority_queue *const self, uint64_t key_limit, void **out, size_t max_out);
 void  *priority_queue_peek(const struct priority_queue *const self);
+size_t priority_queue_peek_k(const struct priority_queue *const self, void **out, size_t k);
+void   priority_queue_iterator_initialize(struct priority_queue_iterator *const self,
+                                          const struct priority_queue *const queue,
+                                          struct priority_queue_cursor *frontier, size_t frontier_capacity);
+void  *priority_queue_iterator_next(struct priority_queue_iterator *const self);
 size_t priority_queue_length(const struct priority_queue *const self);
 bool   priority_queue_is_empty(const struct priority_queue *const self);
 bool   priority_queue_is_full(const struct priority_queue *const self);
+void   priority_queue_set_get_cost(struct priority_queue *const self, priority_queue_get_cost_t get_cost);
+void   priority_queue_get_aggregates(struct priority_queue *const self, struct priority_queue_aggregates *out);
+uint64_t priority_queue_cost_until(const struct priority_queue *const self, uint64_t key_limit);
+#ifdef PRIORITY_QUEUE_STATS
+void priority_queue_get_stats(const struct priority_queue *const self, struct priority_queue_stats *stats);
+void priority_queue_reset_stats(struct priority_queue *const self);
+#endif
+#ifdef PRIORITY_QUEUE_TRACE
+void priority_queue_set_trace(struct priority_queue *const self, struct priority_queue_trace *trace);
+#endif
 
 #endif /* PRIORITY_QUEUE_H */
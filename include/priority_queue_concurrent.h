@@ -0,0 +1,65 @@
+#ifndef PRIORITY_QUEUE_CONCURRENT_H
+#define PRIORITY_QUEUE_CONCURRENT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/* Returned by the try_ operations when another thread holds the lock */
+#define PRIORITY_QUEUE_BUSY (-2)
+
+/**
+ * A struct priority_queue guarded by a ticket lock. Every mutation runs under
+ * the lock and republishes the root key to min_key on unlock, so other threads
+ * can read the queue's earliest key with a single atomic load and never touch
+ * the lock. The lock, the published key and the queue sit on separate cache
+ * lines so that readers polling min_key do not bounce the lock's line.
+ **/
+struct priority_queue_concurrent {
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) _Atomic uint64_t min_key; /* published copy of queue.min_key */
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) _Atomic uint32_t next_ticket;
+	_Atomic uint32_t                                     now_serving;
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) struct priority_queue queue;
+};
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+void priority_queue_concurrent_initialize(struct priority_queue_concurrent *const self,
+                                          priority_queue_get_key_t                get_key);
+#endif
+WARN_UNUSED_RESULT int priority_queue_concurrent_initialize_dynamic(struct priority_queue_concurrent *const self,
+                                                                    priority_queue_get_key_t                get_key,
+                                                                    const struct priority_queue_config     *config);
+void priority_queue_concurrent_destroy(struct priority_queue_concurrent *const self);
+
+void priority_queue_concurrent_lock(struct priority_queue_concurrent *const self);
+bool priority_queue_concurrent_try_lock(struct priority_queue_concurrent *const self);
+void priority_queue_concurrent_unlock(struct priority_queue_concurrent *const self);
+
+WARN_UNUSED_RESULT int priority_queue_concurrent_enqueue(struct priority_queue_concurrent *const self, void *value);
+WARN_UNUSED_RESULT int priority_queue_concurrent_try_enqueue(struct priority_queue_concurrent *const self,
+                                                             void                                   *value);
+WARN_UNUSED_RESULT size_t priority_queue_concurrent_enqueue_batch(struct priority_queue_concurrent *const self,
+                                                                  void **values, size_t n);
+void *priority_queue_concurrent_dequeue(struct priority_queue_concurrent *const self);
+WARN_UNUSED_RESULT int priority_queue_concurrent_try_dequeue(struct priority_queue_concurrent *const self,
+                                                             void                                  **out);
+size_t priority_queue_concurrent_dequeue_until(struct priority_queue_concurrent *const self, uint64_t key_limit,
+                                               void **out, size_t max_out);
+size_t priority_queue_concurrent_peek_k(struct priority_queue_concurrent *const self, void **out, size_t k);
+size_t priority_queue_concurrent_length(struct priority_queue_concurrent *const self);
+
+/**
+ * Reads the earliest key in the queue without taking the lock
+ * @param self the concurrent priority queue
+ * @returns the root key as of the last unlock, or UINT64_MAX if the queue was empty
+ **/
+static inline uint64_t
+priority_queue_concurrent_peek_key(const struct priority_queue_concurrent *const self)
+{
+	return atomic_load_explicit(&self->min_key, memory_order_acquire);
+}
+
+#endif /* PRIORITY_QUEUE_CONCURRENT_H */
@@ -0,0 +1,234 @@
+#ifndef PRIORITY_QUEUE_DEFINE_H
+#define PRIORITY_QUEUE_DEFINE_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+#include "priority_queue_layout.h"
+
+/**
+ * Generates a fixed-capacity min-heap specialized for one element type.
+ * Elements are stored by value, and the key is read with key_expr, an
+ * expression over `elem`, an `elem_type const *`. The key is evaluated once per
+ * enqueue and cached in keys[], just like get_key in struct priority_queue, so
+ * the compiler can inline it and no call goes through a function pointer.
+ *
+ * Emits struct name and static inline functions:
+ *   void             name_initialize(struct name *self);
+ *   void             name_clear(struct name *self);
+ *   int              name_enqueue(struct name *self, elem_type value);  // 0, or -1 when full
+ *   int              name_dequeue(struct name *self, elem_type *out);   // 0, or -1 when empty
+ *   elem_type const *name_peek(const struct name *self);                // NULL when empty
+ *   size_t           name_length(const struct name *self);
+ *   bool             name_is_empty(const struct name *self);
+ *   bool             name_is_full(const struct name *self);
+ * self->min_key tracks the root key, UINT64_MAX when empty.
+ *
+ * Example:
+ *   PRIORITY_QUEUE_DEFINE(timer_queue, struct timer, elem->deadline, 1024)
+ *
+ * @param name prefix of the generated struct and functions
+ * @param elem_type the stored type
+ * @param key_expr uint64_t expression of elem
+ * @param capacity maximum number of elements
+ **/
+#define PRIORITY_QUEUE_DEFINE(name, elem_type, key_expr, capacity)                                                \
+	struct name {                                                                                             \
+		uint64_t  min_key; /* cached key of the heap root */                                              \
+		size_t    first_free;                                                                             \
+		_Alignas(PRIORITY_QUEUE_CACHE_LINE) uint64_t keys[(capacity) + PRIORITY_QUEUE_ROOT];              \
+		elem_type items[(capacity) + PRIORITY_QUEUE_ROOT];                                                \
+	};                                                                                                        \
+                                                                                                                  \
+	static_assert((capacity) > 0, #name ": capacity must be positive");                                       \
+	static_assert((capacity) <= SIZE_MAX / PRIORITY_QUEUE_CHILD_FACTOR - PRIORITY_QUEUE_ROOT,                 \
+	              #name ": capacity must respect the child index bound of PRIORITY_QUEUE_CAPACITY");          \
+                                                                                                                  \
+	static inline uint64_t name##_key(elem_type const *elem)                                                  \
+	{                                                                                                         \
+		return (key_expr);                                                                                \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline void name##_initialize(struct name *const self)                                             \
+	{                                                                                                         \
+		assert(self != NULL);                                                                             \
+                                                                                                                  \
+		self->first_free = PRIORITY_QUEUE_ROOT;                                                           \
+		self->min_key    = UINT64_MAX;                                                                    \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline void name##_clear(struct name *const self)                                                  \
+	{                                                                                                         \
+		name##_initialize(self);                                                                          \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline size_t name##_length(const struct name *const self)                                         \
+	{                                                                                                         \
+		return self->first_free - PRIORITY_QUEUE_ROOT;                                                    \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline bool name##_is_empty(const struct name *const self)                                         \
+	{                                                                                                         \
+		return self->first_free == PRIORITY_QUEUE_ROOT;                                                   \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline bool name##_is_full(const struct name *const self)                                          \
+	{                                                                                                         \
+		return self->first_free == (capacity) + PRIORITY_QUEUE_ROOT;                                      \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline elem_type const *name##_peek(const struct name *const self)                                 \
+	{                                                                                                         \
+		return name##_is_empty(self) ? NULL : &self->items[PRIORITY_QUEUE_ROOT];                          \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline WARN_UNUSED_RESULT int name##_enqueue(struct name *const self, elem_type value)             \
+	{                                                                                                         \
+		assert(self != NULL);                                                                             \
+                                                                                                                  \
+		if (name##_is_full(self)) return -1;                                                              \
+		uint64_t key = name##_key(&value);                                                                \
+		size_t   i   = self->first_free++;                                                                \
+		while (i != PRIORITY_QUEUE_ROOT) {                                                                \
+			size_t parent_index = priority_queue_parent_index(i);                                     \
+			if (key >= self->keys[parent_index]) break;                                               \
+			self->keys[i]  = self->keys[parent_index];                                                \
+			self->items[i] = self->items[parent_index];                                               \
+			i              = parent_index;                                                            \
+		}                                                                                                 \
+		self->keys[i]  = key;                                                                             \
+		self->items[i] = value;                                                                           \
+		self->min_key  = self->keys[PRIORITY_QUEUE_ROOT];                                                 \
+		return 0;                                                                                         \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline WARN_UNUSED_RESULT int name##_dequeue(struct name *const self, elem_type *out)              \
+	{                                                                                                         \
+		assert(self != NULL);                                                                             \
+		assert(out != NULL);                                                                              \
+                                                                                                                  \
+		if (name##_is_empty(self)) return -1;                                                             \
+		*out = self->items[PRIORITY_QUEUE_ROOT];                                                          \
+                                                                                                                  \
+		/* Sift the last element down from the root through a hole, like priority_queue_percolate_down */ \
+		size_t last = --self->first_free;                                                                 \
+		if (last > PRIORITY_QUEUE_ROOT) {                                                                 \
+			uint64_t key    = self->keys[last];                                                       \
+			size_t   parent = PRIORITY_QUEUE_ROOT;                                                    \
+			while (priority_queue_first_child_index(parent) < last) {                                 \
+				size_t smallest = priority_queue_smallest_child_index(self->keys, parent, last);  \
+				if (key <= self->keys[smallest]) break;                                           \
+				self->keys[parent]  = self->keys[smallest];                                       \
+				self->items[parent] = self->items[smallest];                                      \
+				parent              = smallest;                                                   \
+			}                                                                                         \
+			self->keys[parent]  = key;                                                                \
+			self->items[parent] = self->items[last];                                                  \
+		}                                                                                                 \
+		self->min_key = last > PRIORITY_QUEUE_ROOT ? self->keys[PRIORITY_QUEUE_ROOT] : UINT64_MAX;        \
+		return 0;                                                                                         \
+	}
+
+/**
+ * Generates a small fixed-capacity queue with the same interface as
+ * PRIORITY_QUEUE_DEFINE, so switching between the two is a one-word change.
+ * Keys are kept sorted in descending order in one array, so the minimum is
+ * always the last element: peek and dequeue are O(1) and never compare, and
+ * enqueue counts the larger keys without branches and shifts the smaller ones
+ * up one slot. Enqueue is O(n), so this is for queues of a few dozen
+ * elements, such as per-connection or per-tenant queues, where it touches a
+ * handful of cache lines and beats the heap's data-dependent branches;
+ * bench/small_bench.c finds the crossover.
+ *
+ * Example:
+ *   PRIORITY_QUEUE_DEFINE_SMALL(conn_timers, struct timer, elem->deadline, 32)
+ *
+ * @param name prefix of the generated struct and functions
+ * @param elem_type the stored type
+ * @param key_expr uint64_t expression of elem
+ * @param capacity maximum number of elements
+ **/
+#define PRIORITY_QUEUE_DEFINE_SMALL(name, elem_type, key_expr, capacity)                                          \
+	struct name {                                                                                             \
+		uint64_t  min_key; /* cached key of the last element, UINT64_MAX when empty */                    \
+		size_t    length;                                                                                 \
+		_Alignas(PRIORITY_QUEUE_CACHE_LINE) uint64_t keys[(capacity)]; /* descending */                   \
+		elem_type items[(capacity)];                                                                      \
+	};                                                                                                        \
+                                                                                                                  \
+	static_assert((capacity) > 0, #name ": capacity must be positive");                                       \
+                                                                                                                  \
+	static inline uint64_t name##_key(elem_type const *elem)                                                  \
+	{                                                                                                         \
+		return (key_expr);                                                                                \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline void name##_initialize(struct name *const self)                                             \
+	{                                                                                                         \
+		assert(self != NULL);                                                                             \
+                                                                                                                  \
+		self->length  = 0;                                                                                \
+		self->min_key = UINT64_MAX;                                                                       \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline void name##_clear(struct name *const self)                                                  \
+	{                                                                                                         \
+		name##_initialize(self);                                                                          \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline size_t name##_length(const struct name *const self)                                         \
+	{                                                                                                         \
+		return self->length;                                                                              \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline bool name##_is_empty(const struct name *const self)                                         \
+	{                                                                                                         \
+		return self->length == 0;                                                                         \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline bool name##_is_full(const struct name *const self)                                          \
+	{                                                                                                         \
+		return self->length == (capacity);                                                                \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline elem_type const *name##_peek(const struct name *const self)                                 \
+	{                                                                                                         \
+		return name##_is_empty(self) ? NULL : &self->items[self->length - 1];                             \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline WARN_UNUSED_RESULT int name##_enqueue(struct name *const self, elem_type value)             \
+	{                                                                                                         \
+		assert(self != NULL);                                                                             \
+                                                                                                                  \
+		if (name##_is_full(self)) return -1;                                                              \
+		uint64_t key = name##_key(&value);                                                                \
+		/* Branchless count of the larger keys, which the compiler vectorizes */                          \
+		size_t position = 0;                                                                              \
+		for (size_t i = 0; i < self->length; i++) position += self->keys[i] > key;                        \
+		/* Shifted inline; a memmove call costs more than moving a few elements */                        \
+		for (size_t i = self->length; i > position; i--) {                                                \
+			self->keys[i]  = self->keys[i - 1];                                                       \
+			self->items[i] = self->items[i - 1];                                                      \
+		}                                                                                                 \
+		self->keys[position]  = key;                                                                      \
+		self->items[position] = value;                                                                    \
+		self->length++;                                                                                   \
+		self->min_key = self->keys[self->length - 1];                                                     \
+		return 0;                                                                                         \
+	}                                                                                                         \
+                                                                                                                  \
+	static inline WARN_UNUSED_RESULT int name##_dequeue(struct name *const self, elem_type *out)              \
+	{                                                                                                         \
+		assert(self != NULL);                                                                             \
+		assert(out != NULL);                                                                              \
+                                                                                                                  \
+		if (name##_is_empty(self)) return -1;                                                             \
+		*out          = self->items[--self->length];                                                      \
+		self->min_key = self->length > 0 ? self->keys[self->length - 1] : UINT64_MAX;                     \
+		return 0;                                                                                         \
+	}
+
+#endif /* PRIORITY_QUEUE_DEFINE_H */
@@ -0,0 +1,55 @@
+#ifndef PRIORITY_QUEUE_INBOX_H
+#define PRIORITY_QUEUE_INBOX_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/* Elements moved per enqueue_batch call while draining */
+#ifndef PRIORITY_QUEUE_INBOX_DRAIN_CHUNK
+#define PRIORITY_QUEUE_INBOX_DRAIN_CHUNK 64
+#endif
+
+/**
+ * A struct priority_queue owned by one consumer thread, fed by any number of
+ * producer threads through a lock-free inbox. Producers push an element onto
+ * an intrusive stack with a single compare-and-swap and never touch the heap.
+ * The consumer takes the whole stack with one atomic exchange and moves it into
+ * the heap in batches before it dequeues or peeks. Elements need a void *
+ * field, at link_offset, that the inbox owns while they wait.
+ *
+ * Elements that do not fit in a full heap wait on a pending list that only the
+ * consumer touches. They are retried on the next drain and are invisible to
+ * dequeue and peek until then.
+ **/
+struct priority_queue_inbox {
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) _Atomic(void *) head; /* most recently pushed element */
+	size_t link_offset;                                        /* offsetof() the void * link field */
+	_Alignas(PRIORITY_QUEUE_CACHE_LINE) void *pending;        /* consumer only: drained but not yet enqueued */
+	struct priority_queue queue;                               /* consumer only */
+};
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+void priority_queue_inbox_initialize(struct priority_queue_inbox *const self, priority_queue_get_key_t get_key,
+                                     size_t link_offset);
+#endif
+WARN_UNUSED_RESULT int priority_queue_inbox_initialize_dynamic(struct priority_queue_inbox *const  self,
+                                                               priority_queue_get_key_t            get_key,
+                                                               size_t                              link_offset,
+                                                               const struct priority_queue_config *config);
+void priority_queue_inbox_destroy(struct priority_queue_inbox *const self);
+
+/* Producers, any thread */
+void priority_queue_inbox_push(struct priority_queue_inbox *const self, void *value);
+void priority_queue_inbox_push_batch(struct priority_queue_inbox *const self, void **values, size_t n);
+
+/* Consumer thread only */
+size_t priority_queue_inbox_drain(struct priority_queue_inbox *const self);
+void  *priority_queue_inbox_dequeue(struct priority_queue_inbox *const self);
+void  *priority_queue_inbox_peek(struct priority_queue_inbox *const self);
+bool   priority_queue_inbox_is_empty(struct priority_queue_inbox *const self);
+
+#endif /* PRIORITY_QUEUE_INBOX_H */
@@ -0,0 +1,137 @@
+#ifndef PRIORITY_QUEUE_LAYOUT_H
+#define PRIORITY_QUEUE_LAYOUT_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/* The d-ary layout that struct priority_queue, every PRIORITY_QUEUE_DEFINE
+ * queue and the mapped queue share: the root at PRIORITY_QUEUE_ROOT, sibling
+ * groups of PRIORITY_QUEUE_ARITY starting on multiples of the arity. With
+ * PRIORITY_QUEUE_BHEAP the binary heap is instead laid out in pages. */
+
+#ifdef PRIORITY_QUEUE_BHEAP
+
+/* Kamp's B-heap. The first page is an ordinary 1-indexed heap whose bottom
+ * row, the upper half of the page, has its children in later pages. Every
+ * later page starts with the two children of one bottom-row slot. Each of
+ * those has a single child, at offsets 2 and 3, below which the page is
+ * again an ordinary heap, 2*offset and 2*offset+1, down to its own bottom
+ * row. Children always sit at higher indices than their parent, so filling
+ * slots in order keeps the tree connected, as in the d-ary layout. */
+
+#define PRIORITY_QUEUE_BHEAP_HALF (PRIORITY_QUEUE_BHEAP_PAGE / 2)
+
+/**
+ * @param child_index index of a non-root node
+ * @returns the index of the node's parent
+ */
+static inline size_t
+priority_queue_parent_index(size_t child_index)
+{
+	assert(child_index > PRIORITY_QUEUE_ROOT);
+
+	size_t page   = child_index / PRIORITY_QUEUE_BHEAP_PAGE;
+	size_t offset = child_index % PRIORITY_QUEUE_BHEAP_PAGE;
+	if (page == 0 || offset >= 4) return child_index - offset + offset / 2;
+	if (offset >= 2) return child_index - 2;
+	// The first two slots of page p hang off bottom-row slot p - 1, counting across pages
+	size_t bottom_row_slot = page - 1;
+	return bottom_row_slot / PRIORITY_QUEUE_BHEAP_HALF * PRIORITY_QUEUE_BHEAP_PAGE + PRIORITY_QUEUE_BHEAP_HALF
+	       + bottom_row_slot % PRIORITY_QUEUE_BHEAP_HALF;
+}
+
+/**
+ * @param parent_index index of a node
+ * @returns the index of the node's first child. priority_queue_child_count siblings follow it contiguously.
+ */
+static inline size_t
+priority_queue_first_child_index(size_t parent_index)
+{
+	assert(parent_index >= PRIORITY_QUEUE_ROOT);
+
+	size_t page   = parent_index / PRIORITY_QUEUE_BHEAP_PAGE;
+	size_t offset = parent_index % PRIORITY_QUEUE_BHEAP_PAGE;
+	if (page != 0 && offset < 2) return parent_index + 2;
+	if (offset < PRIORITY_QUEUE_BHEAP_HALF) return parent_index + offset;
+	// A bottom-row slot's children open a new page
+	size_t bottom_row_slot = page * PRIORITY_QUEUE_BHEAP_HALF + offset - PRIORITY_QUEUE_BHEAP_HALF;
+	return (bottom_row_slot + 1) * PRIORITY_QUEUE_BHEAP_PAGE;
+}
+
+/**
+ * @param parent_index index of a node
+ * @returns how many children the node can have: 1 for the first two slots of a page after the first, else 2
+ */
+static inline size_t
+priority_queue_child_count(size_t parent_index)
+{
+	return parent_index >= PRIORITY_QUEUE_BHEAP_PAGE && parent_index % PRIORITY_QUEUE_BHEAP_PAGE < 2 ? 1 : 2;
+}
+
+#else
+
+/**
+ * @param child_index index of a non-root node
+ * @returns the index of the node's parent
+ */
+static inline size_t
+priority_queue_parent_index(size_t child_index)
+{
+	assert(child_index > PRIORITY_QUEUE_ROOT);
+
+	return child_index / PRIORITY_QUEUE_ARITY + (PRIORITY_QUEUE_ARITY - 2);
+}
+
+/**
+ * @param parent_index index of a node
+ * @returns the index of the node's first child. Its siblings follow it contiguously.
+ */
+static inline size_t
+priority_queue_first_child_index(size_t parent_index)
+{
+	assert(parent_index >= PRIORITY_QUEUE_ROOT);
+
+	return PRIORITY_QUEUE_ARITY * (parent_index - PRIORITY_QUEUE_ROOT + 1);
+}
+
+/**
+ * @param parent_index index of a node
+ * @returns how many children the node can have, always PRIORITY_QUEUE_ARITY
+ */
+static inline size_t
+priority_queue_child_count(size_t parent_index)
+{
+	(void)parent_index;
+	return PRIORITY_QUEUE_ARITY;
+}
+
+#endif
+
+/**
+ * Scans a node's children for the smallest key. The sifts of all three heaps
+ * share this scan; struct priority_queue takes a vector path first when one
+ * is available.
+ * @param keys the heap's cached keys
+ * @param parent_index index of a node with at least one child below first_free
+ * @param first_free the first unused slot; the last sibling group may be partially filled
+ * @returns the index of the smallest child
+ */
+static inline size_t
+priority_queue_smallest_child_index(const uint64_t *keys, size_t parent_index, size_t first_free)
+{
+	size_t first_child_index = priority_queue_first_child_index(parent_index);
+	size_t end_child_index   = first_child_index + priority_queue_child_count(parent_index);
+	if (end_child_index > first_free) end_child_index = first_free;
+	assert(first_child_index < end_child_index);
+
+	size_t smallest_child_index = first_child_index;
+	for (size_t i = first_child_index + 1; i < end_child_index; i++) {
+		smallest_child_index = keys[i] < keys[smallest_child_index] ? i : smallest_child_index;
+	}
+	return smallest_child_index;
+}
+
+#endif /* PRIORITY_QUEUE_LAYOUT_H */
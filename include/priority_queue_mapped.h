@@ -0,0 +1,95 @@
+#ifndef PRIORITY_QUEUE_MAPPED_H
+#define PRIORITY_QUEUE_MAPPED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/* "PQMAPPED", little-endian */
+#define PRIORITY_QUEUE_MAPPED_MAGIC UINT64_C(0x44455050414d5150)
+
+/* Bumped whenever the header or slot layout changes */
+#define PRIORITY_QUEUE_MAPPED_VERSION 2
+
+/* Stored in the header's arity field. A B-heap build adds its page size, so
+ * builds whose slots are laid out differently reject each other's regions. */
+#ifdef PRIORITY_QUEUE_BHEAP
+#define PRIORITY_QUEUE_MAPPED_SHAPE (PRIORITY_QUEUE_ARITY | PRIORITY_QUEUE_BHEAP_PAGE << 8)
+#else
+#define PRIORITY_QUEUE_MAPPED_SHAPE PRIORITY_QUEUE_ARITY
+#endif
+
+/* Returned by priority_queue_mapped_attach and _verify */
+#define PRIORITY_QUEUE_MAPPED_BAD_MAGIC    (-2) /* the region was never formatted as a queue */
+#define PRIORITY_QUEUE_MAPPED_INCOMPATIBLE (-3) /* another layout version, arity, B-heap page or element size */
+#define PRIORITY_QUEUE_MAPPED_CORRUPT      (-4) /* checksum, bounds or heap order do not hold */
+#define PRIORITY_QUEUE_MAPPED_TORN         (-5) /* a writer stopped in the middle of an operation */
+
+/* Returned by priority_queue_mapped_enqueue for an element not wholly inside the region's element area */
+#define PRIORITY_QUEUE_MAPPED_OUTSIDE (-6)
+
+/**
+ * Sits at the start of the region. Every field is fixed width so that any
+ * process built with the same version and arity reads the same layout.
+ **/
+struct priority_queue_mapped_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t arity;
+	uint64_t region_size;  /* bytes, as given to priority_queue_mapped_create */
+	uint64_t element_size; /* bytes per element, as given to priority_queue_mapped_create */
+	uint64_t capacity;
+	uint64_t first_free;
+	uint64_t min_key;    /* cached key of the heap root, UINT64_MAX when empty */
+	uint64_t generation; /* odd while an operation is in progress */
+	uint64_t checksum;   /* over every field above */
+};
+
+static_assert(sizeof(struct priority_queue_mapped_header) == 72, "the mapped header layout must not change silently");
+
+/**
+ * A d-ary min-heap that lives entirely inside a caller-provided region, such
+ * as a MAP_SHARED mapping of a file or shared-memory object, together with the
+ * elements it orders. Slots hold each element's offset from the start of the
+ * region instead of a pointer, so the region means the same thing at whatever
+ * address it is mapped. A restarted or sibling process maps it again and calls
+ * priority_queue_mapped_attach, which validates the header in O(1) and resumes
+ * without re-enqueueing anything.
+ *
+ * The region is laid out as the header, keys[] from the next cache line,
+ * offsets[] and then the element area, which starts
+ * priority_queue_mapped_size(capacity) bytes in and belongs to the caller.
+ * Every byte of an enqueued element must lie in the element area.
+ *
+ * This struct is process-local and holds pointers into the current mapping.
+ * The queue is not synchronized: processes that share one region at the same
+ * time must serialize operations themselves.
+ **/
+struct priority_queue_mapped {
+	struct priority_queue_mapped_header *header;
+	uint64_t                            *keys;    /* capacity + PRIORITY_QUEUE_ROOT cached keys */
+	uint64_t                            *offsets; /* capacity + PRIORITY_QUEUE_ROOT element offsets */
+	char                                *base;
+	size_t                               element_start; /* offset of the element area */
+	priority_queue_get_key_t             get_key;
+};
+
+size_t priority_queue_mapped_size(size_t capacity);
+WARN_UNUSED_RESULT int priority_queue_mapped_create(struct priority_queue_mapped *const self, void *base,
+                                                    size_t region_size, size_t capacity, size_t element_size,
+                                                    priority_queue_get_key_t get_key);
+WARN_UNUSED_RESULT int priority_queue_mapped_attach(struct priority_queue_mapped *const self, void *base,
+                                                    size_t region_size, size_t element_size,
+                                                    priority_queue_get_key_t get_key);
+WARN_UNUSED_RESULT int priority_queue_mapped_verify(const struct priority_queue_mapped *const self);
+void                   priority_queue_mapped_clear(struct priority_queue_mapped *const self);
+WARN_UNUSED_RESULT int priority_queue_mapped_enqueue(struct priority_queue_mapped *const self, void *value);
+void                  *priority_queue_mapped_dequeue(struct priority_queue_mapped *const self);
+void                  *priority_queue_mapped_peek(const struct priority_queue_mapped *const self);
+size_t                 priority_queue_mapped_length(const struct priority_queue_mapped *const self);
+bool                   priority_queue_mapped_is_empty(const struct priority_queue_mapped *const self);
+bool                   priority_queue_mapped_is_full(const struct priority_queue_mapped *const self);
+
+#endif /* PRIORITY_QUEUE_MAPPED_H */
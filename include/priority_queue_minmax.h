@@ -0,0 +1,48 @@
+#ifndef PRIORITY_QUEUE_MINMAX_H
+#define PRIORITY_QUEUE_MINMAX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/**
+ * A double-ended priority queue: a min-max heap, a binary heap whose even
+ * levels are ordered like a min-heap and odd levels like a max-heap. The root
+ * is the smallest key and the larger of its children the largest, so both ends
+ * are O(1) to read and O(log n) to remove.
+ *
+ * Capacity is fixed at initialization. When the queue is full,
+ * priority_queue_minmax_enqueue_or_evict sheds the element with the latest key
+ * instead of turning the new element away.
+ *
+ * Always binary, whatever PRIORITY_QUEUE_ARITY is: the alternating levels are
+ * what make the maximum cheap to find. The root is at index 1, as in the
+ * default binary heap.
+ **/
+struct priority_queue_minmax {
+	uint64_t                 min_key; /* cached smallest key, UINT64_MAX when empty */
+	uint64_t                 max_key; /* cached largest key, 0 when empty */
+	uint64_t                *keys;    /* keys[i] caches get_key(items[i]) */
+	void                   **items;
+	size_t                   first_free;
+	size_t                   capacity; /* elements */
+	priority_queue_get_key_t get_key;
+};
+
+WARN_UNUSED_RESULT int priority_queue_minmax_initialize(struct priority_queue_minmax *const self,
+                                                        priority_queue_get_key_t get_key, size_t capacity);
+void                   priority_queue_minmax_destroy(struct priority_queue_minmax *const self);
+void                   priority_queue_minmax_clear(struct priority_queue_minmax *const self);
+WARN_UNUSED_RESULT int priority_queue_minmax_enqueue(struct priority_queue_minmax *const self, void *value);
+void *priority_queue_minmax_enqueue_or_evict(struct priority_queue_minmax *const self, void *value);
+void *priority_queue_minmax_dequeue(struct priority_queue_minmax *const self);
+void *priority_queue_minmax_dequeue_max(struct priority_queue_minmax *const self);
+void *priority_queue_minmax_peek(const struct priority_queue_minmax *const self);
+void *priority_queue_minmax_peek_max(const struct priority_queue_minmax *const self);
+size_t priority_queue_minmax_length(const struct priority_queue_minmax *const self);
+bool   priority_queue_minmax_is_empty(const struct priority_queue_minmax *const self);
+bool   priority_queue_minmax_is_full(const struct priority_queue_minmax *const self);
+
+#endif /* PRIORITY_QUEUE_MINMAX_H */
@@ -0,0 +1,54 @@
+#ifndef PRIORITY_QUEUE_MULTICLASS_H
+#define PRIORITY_QUEUE_MULTICLASS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/* Classes one multi-class queue can hold: one bit each in nonempty */
+#define PRIORITY_QUEUE_MULTICLASS_MAX 64
+
+/**
+ * Strict priority between service classes, earliest deadline first within
+ * each. Class 0 is served first. Every class is an ordinary struct
+ * priority_queue, and a bitmap of the non-empty classes finds the class to
+ * serve with one count-trailing-zeros instead of a scan of the classes.
+ *
+ * With a nonzero aging_limit, a class that has waited through aging_limit
+ * dequeues without being served is served next, however low its priority.
+ * Non-empty classes are kept in the order they were last served, so the
+ * longest-waiting class is also found in O(1).
+ *
+ * Enqueue and dequeue through this struct so the bitmap stays right. After
+ * changing a class queue directly, e.g. with priority_queue_remove, call
+ * priority_queue_multiclass_refresh. Not synchronized.
+ **/
+struct priority_queue_multiclass {
+	uint64_t               nonempty; /* bit c set while classes[c] has elements */
+	struct priority_queue *classes;  /* caller-owned, initialized queues */
+	size_t                 class_count;
+	uint64_t               aging_limit; /* dequeues a non-empty class may wait; 0 for strict priority */
+	uint64_t               served;      /* dequeues so far */
+
+	/* Non-empty classes from the longest-waiting to the most recently served */
+	uint64_t waiting_since[PRIORITY_QUEUE_MULTICLASS_MAX]; /* served when the class was last served or filled */
+	uint8_t  next[PRIORITY_QUEUE_MULTICLASS_MAX];
+	uint8_t  prev[PRIORITY_QUEUE_MULTICLASS_MAX];
+	uint8_t  oldest; /* PRIORITY_QUEUE_MULTICLASS_MAX when every class is empty */
+	uint8_t  newest;
+};
+
+void priority_queue_multiclass_initialize(struct priority_queue_multiclass *const self, struct priority_queue *classes,
+                                          size_t class_count, uint64_t aging_limit);
+WARN_UNUSED_RESULT int priority_queue_multiclass_enqueue(struct priority_queue_multiclass *const self,
+                                                         size_t class_index, void *value);
+void    *priority_queue_multiclass_dequeue(struct priority_queue_multiclass *const self);
+void    *priority_queue_multiclass_peek(const struct priority_queue_multiclass *const self);
+size_t   priority_queue_multiclass_next_class(const struct priority_queue_multiclass *const self);
+uint64_t priority_queue_multiclass_min_key(const struct priority_queue_multiclass *const self, size_t class_index);
+void     priority_queue_multiclass_refresh(struct priority_queue_multiclass *const self, size_t class_index);
+bool     priority_queue_multiclass_is_empty(const struct priority_queue_multiclass *const self);
+
+#endif /* PRIORITY_QUEUE_MULTICLASS_H */
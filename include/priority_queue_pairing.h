@@ -0,0 +1,52 @@
+#ifndef PRIORITY_QUEUE_PAIRING_H
+#define PRIORITY_QUEUE_PAIRING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/**
+ * Embedded in each element at node_offset. The queue owns it while the element
+ * is queued; its contents mean nothing afterwards.
+ **/
+struct priority_queue_pairing_node {
+	struct priority_queue_pairing_node *child;   /* first child */
+	struct priority_queue_pairing_node *next;    /* next sibling */
+	struct priority_queue_pairing_node *prev;    /* previous sibling, the parent for a first child, NULL at the root */
+	uint64_t                            key;     /* get_key(element) as of enqueue or the last update_key */
+};
+
+/**
+ * An intrusive pairing heap. Elements carry their own node, so there is no
+ * capacity limit and no allocation. Enqueue and meld link two trees with one
+ * comparison in O(1); update_key to an earlier key cuts the element's subtree
+ * and links it to the root in O(1) actual time. Its amortized cost, which
+ * includes the later dequeues it makes more expensive, is sub-logarithmic but
+ * not known to be O(1). Dequeue melds the root's children in two passes in
+ * O(log n) amortized.
+ *
+ * Use it where whole queues move between owners: melding one worker's backlog
+ * into another's is O(1) however long it is.
+ **/
+struct priority_queue_pairing {
+	uint64_t                            min_key; /* cached key of the root, UINT64_MAX when empty */
+	struct priority_queue_pairing_node *root;
+	size_t                              length;
+	priority_queue_get_key_t            get_key;
+	size_t                              node_offset; /* offsetof() the element's struct priority_queue_pairing_node */
+};
+
+void priority_queue_pairing_initialize(struct priority_queue_pairing *const self, priority_queue_get_key_t get_key,
+                                       size_t node_offset);
+void priority_queue_pairing_enqueue(struct priority_queue_pairing *const self, void *value);
+void *priority_queue_pairing_dequeue(struct priority_queue_pairing *const self);
+void *priority_queue_pairing_peek(const struct priority_queue_pairing *const self);
+void  priority_queue_pairing_meld(struct priority_queue_pairing *const self, struct priority_queue_pairing *const other);
+void  priority_queue_pairing_remove(struct priority_queue_pairing *const self, void *value);
+void  priority_queue_pairing_update_key(struct priority_queue_pairing *const self, void *value);
+size_t priority_queue_pairing_length(const struct priority_queue_pairing *const self);
+bool   priority_queue_pairing_is_empty(const struct priority_queue_pairing *const self);
+
+#endif /* PRIORITY_QUEUE_PAIRING_H */
@@ -0,0 +1,64 @@
+#ifndef PRIORITY_QUEUE_RADIX_H
+#define PRIORITY_QUEUE_RADIX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue.h"
+
+/* Returned by priority_queue_radix_enqueue for a key below the monotone floor */
+#define PRIORITY_QUEUE_RADIX_BELOW_FLOOR (-2)
+/* Returned by priority_queue_radix_try_dequeue when a bucket cannot be redistributed */
+#define PRIORITY_QUEUE_RADIX_NO_MEMORY (-3)
+
+/* Bucket 0 holds keys equal to the floor; bucket b > 0 holds keys whose highest
+ * bit that differs from the floor is bit b - 1 */
+#define PRIORITY_QUEUE_RADIX_BUCKETS 65
+
+struct priority_queue_radix_entry {
+	uint64_t key;
+	void    *item;
+};
+
+struct priority_queue_radix_bucket {
+	struct priority_queue_radix_entry *entries;
+	size_t                             length;
+	size_t                             capacity;
+	size_t                             min_index; /* entry with the smallest key, valid while length > 0 */
+};
+
+/**
+ * A monotone priority queue for keys that never go backwards, such as absolute
+ * deadlines: every enqueued key must be at least the key most recently
+ * dequeued (the floor). Elements are bucketed by the highest bit in which
+ * their key differs from the floor, so every key in a lower bucket is smaller
+ * than every key in a higher one. A dequeue that empties bucket 0 moves the
+ * floor up to the minimum of the next bucket and redistributes that bucket
+ * into lower ones; each element moves down at most 64 times in its life, so
+ * operations are amortized O(log C) for keys spanning a range of C, with
+ * appends and linear scans instead of a heap's scattered accesses.
+ *
+ * Mirrors the priority_queue API for the operations monotone schedulers need.
+ * Bucket storage grows with malloc/realloc.
+ **/
+struct priority_queue_radix {
+	uint64_t                           min_key; /* smallest queued key, UINT64_MAX when empty */
+	uint64_t                           floor;   /* key of the last dequeued element; enqueues must not go below */
+	uint64_t                           nonempty; /* bit b - 1 set when bucket b > 0 has entries */
+	size_t                             length;
+	priority_queue_get_key_t           get_key;
+	struct priority_queue_radix_bucket buckets[PRIORITY_QUEUE_RADIX_BUCKETS];
+};
+
+void priority_queue_radix_initialize(struct priority_queue_radix *const self, priority_queue_get_key_t get_key);
+void priority_queue_radix_destroy(struct priority_queue_radix *const self);
+void priority_queue_radix_clear(struct priority_queue_radix *const self);
+WARN_UNUSED_RESULT int priority_queue_radix_enqueue(struct priority_queue_radix *const self, void *value);
+void                  *priority_queue_radix_dequeue(struct priority_queue_radix *const self);
+WARN_UNUSED_RESULT int priority_queue_radix_try_dequeue(struct priority_queue_radix *const self, void **out);
+void                  *priority_queue_radix_peek(const struct priority_queue_radix *const self);
+size_t                 priority_queue_radix_length(const struct priority_queue_radix *const self);
+bool                   priority_queue_radix_is_empty(const struct priority_queue_radix *const self);
+
+#endif /* PRIORITY_QUEUE_RADIX_H */
@@ -0,0 +1,45 @@
+#ifndef PRIORITY_QUEUE_SHARDED_H
+#define PRIORITY_QUEUE_SHARDED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "priority_queue_concurrent.h"
+
+/* Upper bound on steal_batch; stolen elements pass through a stack buffer */
+#ifndef PRIORITY_QUEUE_SHARDED_MAX_STEAL
+#define PRIORITY_QUEUE_SHARDED_MAX_STEAL 64
+#endif
+
+struct priority_queue_sharded_config {
+	size_t   steal_batch; /* earliest elements moved per steal, 1 to PRIORITY_QUEUE_SHARDED_MAX_STEAL */
+	uint64_t steal_slack; /* steal while a victim's earliest key is more than this much earlier than ours;
+	                         UINT64_MAX steals only when the local shard is empty */
+};
+
+/**
+ * One concurrent queue per worker. Owners enqueue and dequeue on their own
+ * shard, whose lock is uncontended unless someone is stealing from it. A worker
+ * whose shard is empty, or whose earliest key trails another shard's by more
+ * than steal_slack, picks the victim with the smallest published min_key and
+ * moves a batch of that victim's earliest elements over. Victims are found by
+ * reading published keys only, so looking for work takes no locks. The move
+ * itself holds the thief's and the victim's locks, taken in shard order.
+ **/
+struct priority_queue_sharded {
+	struct priority_queue_concurrent *shards;
+	size_t                            shard_count;
+	size_t                            steal_batch;
+	uint64_t                          steal_slack;
+};
+
+void priority_queue_sharded_initialize(struct priority_queue_sharded *const self,
+                                       struct priority_queue_concurrent *shards, size_t shard_count,
+                                       const struct priority_queue_sharded_config *config);
+WARN_UNUSED_RESULT int priority_queue_sharded_enqueue(struct priority_queue_sharded *const self, size_t worker,
+                                                      void *value);
+void                  *priority_queue_sharded_dequeue(struct priority_queue_sharded *const self, size_t worker);
+size_t                 priority_queue_sharded_steal(struct priority_queue_sharded *const self, size_t worker);
+uint64_t               priority_queue_sharded_peek_key(const struct priority_queue_sharded *const self);
+
+#endif /* PRIORITY_QUEUE_SHARDED_H */
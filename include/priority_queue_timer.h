@@ -0,0 +1,55 @@
+#ifndef PRIORITY_QUEUE_TIMER_H
+#define PRIORITY_QUEUE_TIMER_H
+
+#ifdef __linux__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "priority_queue.h"
+
+/* Returned when the queue changed but the timerfd could not be re-armed; errno is set */
+#define PRIORITY_QUEUE_TIMER_ARM_FAILED (-2)
+
+/**
+ * A struct priority_queue whose keys are absolute times, in nanoseconds on
+ * clock, paired with a Linux timerfd that is kept armed at the queue's
+ * min_key. The fd becomes readable when the earliest element is due, so an
+ * epoll loop can wait on it next to its other fds instead of polling the
+ * queue or sleeping for a guessed interval.
+ *
+ * The timer is re-armed only when min_key differs from the time it is armed
+ * for, so enqueues behind the root and dequeues of equal keys make no system
+ * call. After changing queue directly, e.g. with priority_queue_remove, call
+ * priority_queue_timer_rearm.
+ *
+ * Not synchronized: use it from the thread that runs the event loop.
+ **/
+struct priority_queue_timer {
+	struct priority_queue queue;
+	int                   fd;        /* timerfd, non-blocking and close-on-exec */
+	clockid_t             clock;     /* CLOCK_MONOTONIC, CLOCK_REALTIME or CLOCK_BOOTTIME */
+	uint64_t              armed_key; /* expiry the timerfd is set to, UINT64_MAX when disarmed */
+};
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+WARN_UNUSED_RESULT int priority_queue_timer_initialize(struct priority_queue_timer *const self,
+                                                       priority_queue_get_key_t get_key, clockid_t clock);
+#endif
+WARN_UNUSED_RESULT int priority_queue_timer_initialize_dynamic(struct priority_queue_timer *const  self,
+                                                               priority_queue_get_key_t            get_key,
+                                                               clockid_t                           clock,
+                                                               const struct priority_queue_config *config);
+void                   priority_queue_timer_destroy(struct priority_queue_timer *const self);
+int                    priority_queue_timer_fd(const struct priority_queue_timer *const self);
+WARN_UNUSED_RESULT int priority_queue_timer_enqueue(struct priority_queue_timer *const self, void *value);
+void                  *priority_queue_timer_dequeue(struct priority_queue_timer *const self);
+size_t priority_queue_timer_dispatch(struct priority_queue_timer *const self, void **out, size_t max_out);
+WARN_UNUSED_RESULT int priority_queue_timer_rearm(struct priority_queue_timer *const self);
+uint64_t               priority_queue_timer_now(const struct priority_queue_timer *const self);
+
+#endif /* __linux__ */
+
+#endif /* PRIORITY_QUEUE_TIMER_H */
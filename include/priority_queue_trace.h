@@ -0,0 +1,94 @@
+#ifndef PRIORITY_QUEUE_TRACE_H
+#define PRIORITY_QUEUE_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "priority_queue.h"
+
+/* "PQTRACE1" read as a little-endian uint64_t */
+#define PRIORITY_QUEUE_TRACE_MAGIC   UINT64_C(0x3145434152545150)
+#define PRIORITY_QUEUE_TRACE_VERSION 1
+
+/* Returned by priority_queue_trace_load for a file that is not a trace this build can read */
+#define PRIORITY_QUEUE_TRACE_BAD_FORMAT (-2)
+
+enum priority_queue_trace_op
+{
+	PRIORITY_QUEUE_TRACE_ENQUEUE = 1, /* key of the element added */
+	PRIORITY_QUEUE_TRACE_DEQUEUE = 2, /* key of the element removed from the root */
+	PRIORITY_QUEUE_TRACE_CLEAR   = 3, /* key is 0 */
+};
+
+/**
+ * One traced operation, 16 bytes. Times are relative to the start of the
+ * trace, so a dump records no wall-clock time.
+ **/
+struct priority_queue_trace_record {
+	uint64_t key;
+	uint64_t stamp; /* nanoseconds since the trace started << 8 | op */
+};
+
+/**
+ * A ring of the most recent operations on a queue, written by a queue built
+ * with -DPRIORITY_QUEUE_TRACE once priority_queue_set_trace points it here.
+ * Enqueues, dequeues and clears are recorded, including those made by
+ * enqueue_batch and dequeue_until; remove and update_key are not.
+ * The records are caller-owned and preallocated, so tracing never allocates;
+ * when the ring is full the oldest records are overwritten.
+ *
+ * Not synchronized: a trace belongs to one queue, and is written under
+ * whatever serializes that queue.
+ **/
+struct priority_queue_trace {
+	struct priority_queue_trace_record *records;
+	size_t                              capacity; /* records, a power of two */
+	uint64_t                            written;  /* records ever appended; the ring holds the last capacity */
+	uint64_t                            start_ns; /* CLOCK_MONOTONIC when the trace was initialized */
+};
+
+/**
+ * Header of a dumped trace. The records follow it oldest first, in host byte
+ * order; a reader on a host of the other byte order sees a bad magic.
+ **/
+struct priority_queue_trace_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t record_size; /* sizeof(struct priority_queue_trace_record) */
+	uint64_t count;       /* records that follow */
+	uint64_t dropped;     /* earlier records the ring overwrote before the dump */
+};
+
+/**
+ * @param record a traced operation
+ * @returns the operation
+ **/
+static inline enum priority_queue_trace_op
+priority_queue_trace_record_op(const struct priority_queue_trace_record *record)
+{
+	return (enum priority_queue_trace_op)(record->stamp & 0xFF);
+}
+
+/**
+ * @param record a traced operation
+ * @returns nanoseconds from the start of the trace to the operation
+ **/
+static inline uint64_t
+priority_queue_trace_record_time(const struct priority_queue_trace_record *record)
+{
+	return record->stamp >> 8;
+}
+
+void   priority_queue_trace_initialize(struct priority_queue_trace *const self,
+                                       struct priority_queue_trace_record *records, size_t capacity);
+void   priority_queue_trace_append(struct priority_queue_trace *const self, enum priority_queue_trace_op op,
+                                   uint64_t key);
+size_t priority_queue_trace_length(const struct priority_queue_trace *const self);
+WARN_UNUSED_RESULT int priority_queue_trace_dump(const struct priority_queue_trace *const self, FILE *out,
+                                                 bool anonymize);
+WARN_UNUSED_RESULT int priority_queue_trace_load(FILE *in, struct priority_queue_trace_record **records,
+                                                 size_t *count);
+
+#endif /* PRIORITY_QUEUE_TRACE_H */
@@ -1,50 +1,440 @@
 #include "priority_queue.h"
+#include "priority_queue_layout.h"
 #include <assert.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if PRIORITY_QUEUE_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef PRIORITY_QUEUE_TRACE
+#include "priority_queue_trace.h"
+#endif
+
+/* Upper bound on the slots of a dynamic queue, so that neither storage array
+ * can overflow size_t bytes, even after rounding up to a cache line, and a
+ * B-heap's child indices stay within size_t */
+#ifdef PRIORITY_QUEUE_BHEAP
+#define PRIORITY_QUEUE_MAX_SLOTS (SIZE_MAX / 4 / sizeof(uint64_t) / PRIORITY_QUEUE_BHEAP_PAGE)
+#else
+#define PRIORITY_QUEUE_MAX_SLOTS (SIZE_MAX / 4 / sizeof(uint64_t))
+#endif
+
+static_assert(PRIORITY_QUEUE_MAX_SLOTS <= SIZE_MAX / PRIORITY_QUEUE_CHILD_FACTOR,
+              "dynamic queues must respect the same child index bound as PRIORITY_QUEUE_CAPACITY");
+
+/* Hot-path counters. Without PRIORITY_QUEUE_STATS they expand to nothing; the
+ * depth of a percolation is still evaluated so that its counter is "used". */
+#ifdef PRIORITY_QUEUE_STATS
+#define PRIORITY_QUEUE_COUNT(self, counter, n) ((self)->stats.counter += (n))
+#define PRIORITY_QUEUE_COUNT_DEPTH(self, histogram, depth) \
+	((self)->stats.histogram[(depth) < PRIORITY_QUEUE_STATS_DEPTHS ? (depth) : PRIORITY_QUEUE_STATS_DEPTHS - 1]++)
+#define PRIORITY_QUEUE_COUNT_HIGH_WATER(self)                                                  \
+	((self)->stats.high_water = (self)->first_free - PRIORITY_QUEUE_ROOT > (self)->stats.high_water \
+	                              ? (self)->first_free - PRIORITY_QUEUE_ROOT                       \
+	                              : (self)->stats.high_water)
+#else
+#define PRIORITY_QUEUE_COUNT(self, counter, n)             ((void)0)
+#define PRIORITY_QUEUE_COUNT_DEPTH(self, histogram, depth) ((void)(depth))
+#define PRIORITY_QUEUE_COUNT_HIGH_WATER(self)              ((void)0)
+#endif
+
+/* Appends to the queue's trace, if it has one. Without PRIORITY_QUEUE_TRACE it
+ * expands to nothing. */
+#ifdef PRIORITY_QUEUE_TRACE
+#define PRIORITY_QUEUE_RECORD(self, op, key) \
+	((self)->trace != NULL ? priority_queue_trace_append((self)->trace, PRIORITY_QUEUE_TRACE_##op, (key)) : (void)0)
+#else
+#define PRIORITY_QUEUE_RECORD(self, op, key) ((void)0)
+#endif
+
 /****************************
  * Private Helper Functions *
  ****************************/
 
 /**
- * Adds a value to the end of the binary heap
+ * @param self the priority queue, in indexed mode
+ * @param item an element
+ * @returns the element's caller-supplied slot index field
+ */
+static inline size_t *
+priority_queue_index_field(const struct priority_queue *const self, void *item)
+{
+	assert(self->index_offset != PRIORITY_QUEUE_UNINDEXED);
+
+	return (size_t *)((char *)item + self->index_offset);
+}
+
+/**
+ * Writes an element and its key into a slot. Every move of an element goes
+ * through here so that, in indexed mode, its index field follows it.
+ * @param self the priority queue
+ * @param index the destination slot
+ * @param key the key of item
+ * @param item the element
+ */
+static inline void
+priority_queue_place(struct priority_queue *const self, size_t index, uint64_t key, void *item)
+{
+	self->keys[index]  = key;
+	self->items[index] = item;
+	if (self->index_offset != PRIORITY_QUEUE_UNINDEXED) *priority_queue_index_field(self, item) = index;
+}
+
+/**
+ * Marks an element that is leaving the queue as no longer queued
+ * @param self the priority queue
+ * @param item the element
+ */
+static inline void
+priority_queue_release(struct priority_queue *const self, void *item)
+{
+	if (self->index_offset != PRIORITY_QUEUE_UNINDEXED) {
+		*priority_queue_index_field(self, item) = PRIORITY_QUEUE_UNINDEXED;
+	}
+}
+
+/**
+ * Adds a newly queued element to the aggregates, if they are kept
+ * @param self the priority queue
+ * @param item the element
+ * @param key its key
+ */
+static inline void
+priority_queue_aggregate_add(struct priority_queue *const self, void *item, uint64_t key)
+{
+	if (self->get_cost == NULL) return;
+	self->total_cost += self->get_cost(item);
+	self->key_sum += key;
+	// Even a stale max_key is at least every queued key, so a key reaching it is the maximum
+	if (key >= self->max_key) {
+		self->max_key       = key;
+		self->max_key_stale = false;
+	}
+}
+
+/**
+ * Takes an element that left the queue out of the sums. Removing the element
+ * that holds max_key only marks it stale, since most removals cannot change it.
+ * @param self the priority queue
+ * @param item the element
+ * @param key its key
+ */
+static inline void
+priority_queue_aggregate_remove(struct priority_queue *const self, void *item, uint64_t key)
+{
+	if (self->get_cost == NULL) return;
+	self->total_cost -= self->get_cost(item);
+	self->key_sum -= key;
+	if (key == self->max_key) self->max_key_stale = true;
+}
+
+/**
+ * Recomputes max_key if the element holding it left or got an earlier key
+ * since it was last known. The maximum of a heap is always a leaf, so only the
+ * leaves are scanned: O(n / ARITY), or O(n) for a B-heap.
+ * @param self the priority queue
+ */
+static inline void
+priority_queue_aggregate_refresh_max(struct priority_queue *const self)
+{
+	if (!self->max_key_stale) return;
+	self->max_key_stale = false;
+	self->max_key       = 0;
+	if (self->first_free == PRIORITY_QUEUE_ROOT) return;
+
+#ifdef PRIORITY_QUEUE_BHEAP
+	// Every page's bottom row holds leaves, so there is no single run of them
+	size_t first_leaf = PRIORITY_QUEUE_ROOT;
+#else
+	size_t first_leaf = self->first_free - 1 == PRIORITY_QUEUE_ROOT
+	                      ? PRIORITY_QUEUE_ROOT
+	                      : priority_queue_parent_index(self->first_free - 1) + 1;
+#endif
+	for (size_t i = first_leaf; i < self->first_free; i++) {
+		if (self->keys[i] > self->max_key) self->max_key = self->keys[i];
+	}
+}
+
+/*****************************
+ * Storage for dynamic queues *
+ *****************************/
+
+static void *
+priority_queue_default_allocate(void *context, size_t size, size_t alignment)
+{
+	(void)context;
+	// size is always a multiple of alignment, as aligned_alloc requires
+	return aligned_alloc(alignment, size);
+}
+
+static void
+priority_queue_default_release(void *context, void *ptr, size_t size)
+{
+	(void)context;
+	(void)size;
+	free(ptr);
+}
+
+static const struct priority_queue_allocator priority_queue_default_allocator = {
+	.allocate = priority_queue_default_allocate,
+	.release  = priority_queue_default_release,
+	.context  = NULL,
+};
+
+/**
+ * keys[] and items[] share one allocation, each starting on a cache line
+ * @param capacity number of slots
+ * @param items_offset receives the byte offset of items[] within the allocation
+ * @returns the size of the allocation in bytes
+ */
+static inline size_t
+priority_queue_storage_size(size_t capacity, size_t *items_offset)
+{
+	const size_t line = PRIORITY_QUEUE_CACHE_LINE;
+
+	*items_offset = (capacity * sizeof(uint64_t) + line - 1) / line * line;
+	return *items_offset + (capacity * sizeof(void *) + line - 1) / line * line;
+}
+
+/**
+ * Moves the elements of a dynamic queue into storage of a different size
+ * @param self the priority queue
+ * @param capacity the new number of slots, at least first_free
+ * @returns 0 on success. -1 when the allocator fails, leaving the queue unchanged
+ */
+static int
+priority_queue_resize(struct priority_queue *const self, size_t capacity)
+{
+	assert(self->allocator != NULL);
+	assert(capacity >= self->first_free && capacity <= PRIORITY_QUEUE_MAX_SLOTS);
+
+	size_t items_offset;
+	size_t size    = priority_queue_storage_size(capacity, &items_offset);
+	char  *storage = self->allocator->allocate(self->allocator->context, size, PRIORITY_QUEUE_CACHE_LINE);
+	if (storage == NULL) return -1;
+
+	uint64_t *keys  = (uint64_t *)storage;
+	void    **items = (void **)(storage + items_offset);
+	if (self->keys != NULL) {
+		size_t length = self->first_free - PRIORITY_QUEUE_ROOT;
+		memcpy(keys + PRIORITY_QUEUE_ROOT, self->keys + PRIORITY_QUEUE_ROOT, length * sizeof(uint64_t));
+		memcpy(items + PRIORITY_QUEUE_ROOT, self->items + PRIORITY_QUEUE_ROOT, length * sizeof(void *));
+		self->allocator->release(self->allocator->context, self->keys,
+		                         priority_queue_storage_size(self->capacity, &items_offset));
+	}
+	self->keys     = keys;
+	self->items    = items;
+	self->capacity = capacity;
+	return 0;
+}
+
+/**
+ * Doubles the capacity of a growable queue until it has at least needed slots,
+ * or as many as max_capacity and the allocator allow. Queues with a fixed
+ * capacity are left alone.
+ * @param self the priority queue
+ * @param needed the number of slots wanted
+ */
+static void
+priority_queue_grow(struct priority_queue *const self, size_t needed)
+{
+	if (self->growth == PRIORITY_QUEUE_GROWTH_FIXED || self->capacity >= self->max_capacity) return;
+	if (self->growth_failed) return;
+
+	size_t capacity = self->capacity;
+	while (capacity < needed && capacity < self->max_capacity) {
+		capacity = capacity > self->max_capacity / 2 ? self->max_capacity : capacity * 2;
+	}
+	// On allocation failure the queue keeps its current storage and reports itself full
+	// until an element leaves, so priority_queue_is_full agrees with enqueue
+	if (priority_queue_resize(self, capacity) != 0) self->growth_failed = true;
+}
+
+/**
+ * Halves the capacity of a shrinkable queue once it is a quarter full. The gap
+ * between the grow and shrink thresholds keeps resizes amortized O(1).
+ * @param self the priority queue
+ */
+static inline void
+priority_queue_shrink(struct priority_queue *const self)
+{
+	// An element left, so the next enqueue that finds the queue full may try to grow again
+	self->growth_failed = false;
+	if (self->growth != PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK) return;
+
+	// Count elements rather than slots: halving the slots of a wide heap takes
+	// the padding below the root out of the half that is left, so require the
+	// smaller queue to end up at most half full, or the next enqueue would grow it again
+	size_t capacity = self->capacity / 2;
+	size_t length   = self->first_free - PRIORITY_QUEUE_ROOT;
+	if (capacity < self->min_capacity || capacity < PRIORITY_QUEUE_ROOT) return;
+	if (length > (capacity - PRIORITY_QUEUE_ROOT) / 2) return;
+	// Shrinking is an optimization, so an allocation failure is not an error
+	(void)priority_queue_resize(self, capacity);
+}
+
+/**
+ * Adds a value and its key to the end of the heap
  * @param self the priority queue
  * @param new_item the value we are adding
+ * @param key the key of new_item
  * @return 0 on success. -1 when priority queue is full
  **/
 static inline int
-priority_queue_append(struct priority_queue *const self, void *new_item)
+priority_queue_append(struct priority_queue *const self, void *new_item, uint64_t key)
 {
 	assert(self != NULL);
 
-	if (self->first_free >= PRIORITY_QUEUE_CAPACITY) return -1;
+	if (self->first_free >= self->capacity) {
+		priority_queue_grow(self, self->first_free + 1);
+		if (self->first_free >= self->capacity) return -1;
+	}
 
-	self->items[self->first_free] = new_item;
+	priority_queue_place(self, self->first_free, key, new_item);
 	self->first_free++;
 	return 0;
 }
 
 /**
- * Shifts an appended value upwards to restore heap structure property
+ * Swaps two slots of the heap, keeping keys[] in step with items[]
+ * @param self the priority queue
+ * @param a index of the first slot
+ * @param b index of the second slot
+ */
+static inline void
+priority_queue_swap(struct priority_queue *const self, size_t a, size_t b)
+{
+	uint64_t temp_key  = self->keys[a];
+	void    *temp_item = self->items[a];
+	priority_queue_place(self, a, self->keys[b], self->items[b]);
+	priority_queue_place(self, b, temp_key, temp_item);
+	PRIORITY_QUEUE_COUNT(self, moves, 2);
+}
+
+/**
+ * Shifts a value upwards to restore heap structure property. The value is held
+ * aside while larger parents move down into the hole it leaves, so each level
+ * costs one key/item move instead of a full swap. Callers refresh min_key.
  * @param self the priority queue
+ * @param index the slot holding the value to shift
  */
 static inline void
-priority_queue_percolate_up(struct priority_queue *const self)
+priority_queue_percolate_up(struct priority_queue *const self, size_t index)
 {
 	assert(self != NULL);
-	assert(self->get_key != NULL);
+	assert(index >= PRIORITY_QUEUE_ROOT && index < self->first_free);
+
+	size_t   i     = index;
+	size_t   depth = 0;
+	uint64_t key   = self->keys[i];
+	void    *item  = self->items[i];
+	while (i != PRIORITY_QUEUE_ROOT) {
+		size_t parent_index = priority_queue_parent_index(i);
+		PRIORITY_QUEUE_COUNT(self, comparisons, 1);
+		if (key >= self->keys[parent_index]) break;
+		priority_queue_place(self, i, self->keys[parent_index], self->items[parent_index]);
+		PRIORITY_QUEUE_COUNT(self, moves, 1);
+		i = parent_index;
+		depth++;
+	}
+	priority_queue_place(self, i, key, item);
+	PRIORITY_QUEUE_COUNT_DEPTH(self, percolate_up_depth, depth);
+}
+
+#if PRIORITY_QUEUE_SIMD
+static_assert(PRIORITY_QUEUE_ARITY >= 4, "the SIMD kernels need at least 4 children per group");
+
+/* Flipping the sign bit turns unsigned 64-bit order into the signed order that
+ * the SIMD compare instructions implement */
+#define PRIORITY_QUEUE_SIGN_BIT ((long long)INT64_MIN)
+
+/**
+ * Finds the smallest of a full group of sibling keys with AVX2, without
+ * branches: an element-wise min across 4-key vectors, a min across lanes, then
+ * the first lane equal to it. Ties go to the first child, as in the scalar scan.
+ * Not inlined: it is compiled for AVX2 and only called on CPUs that have it.
+ * @param keys the group's first key
+ * @returns the offset of the smallest key within the group
+ */
+__attribute__((target("avx2"))) static size_t
+priority_queue_smallest_child_avx2(const uint64_t *keys)
+{
+	const __m256i sign = _mm256_set1_epi64x(PRIORITY_QUEUE_SIGN_BIT);
+	__m256i       lanes[PRIORITY_QUEUE_ARITY / 4];
+	for (size_t j = 0; j < PRIORITY_QUEUE_ARITY / 4; j++) {
+		lanes[j] = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(keys + 4 * j)), sign);
+	}
+
+	__m256i min = lanes[0];
+	for (size_t j = 1; j < PRIORITY_QUEUE_ARITY / 4; j++) {
+		min = _mm256_blendv_epi8(min, lanes[j], _mm256_cmpgt_epi64(min, lanes[j]));
+	}
+	__m256i other = _mm256_permute4x64_epi64(min, _MM_SHUFFLE(2, 3, 0, 1));
+	min           = _mm256_blendv_epi8(min, other, _mm256_cmpgt_epi64(min, other));
+	other         = _mm256_permute4x64_epi64(min, _MM_SHUFFLE(1, 0, 3, 2));
+	min           = _mm256_blendv_epi8(min, other, _mm256_cmpgt_epi64(min, other));
+
+	unsigned int equal = 0;
+	for (size_t j = 0; j < PRIORITY_QUEUE_ARITY / 4; j++) {
+		int lane_mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lanes[j], min)));
+		equal |= (unsigned int)lane_mask << (4 * j);
+	}
+	return (size_t)__builtin_ctz(equal);
+}
 
-	for (size_t i = self->first_free - 1;
-	     i / 2 != 0 && self->get_key(self->items[i]) < self->get_key(self->items[i / 2]); i /= 2) {
-		void *temp         = self->items[i / 2];
-		self->items[i / 2] = self->items[i];
-		self->items[i]     = temp;
-		// If percolated to highest priority, update highest priority
-		if (i / 2 == 1) self->min_key = self->get_key(self->items[1]);
+/**
+ * Like priority_queue_smallest_child_avx2, over 2-key SSE4.2 vectors
+ * @param keys the group's first key
+ * @returns the offset of the smallest key within the group
+ */
+__attribute__((target("sse4.2"))) static size_t
+priority_queue_smallest_child_sse42(const uint64_t *keys)
+{
+	const __m128i sign = _mm_set1_epi64x(PRIORITY_QUEUE_SIGN_BIT);
+	__m128i       lanes[PRIORITY_QUEUE_ARITY / 2];
+	for (size_t j = 0; j < PRIORITY_QUEUE_ARITY / 2; j++) {
+		lanes[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(keys + 2 * j)), sign);
 	}
+
+	__m128i min = lanes[0];
+	for (size_t j = 1; j < PRIORITY_QUEUE_ARITY / 2; j++) {
+		min = _mm_blendv_epi8(min, lanes[j], _mm_cmpgt_epi64(min, lanes[j]));
+	}
+	__m128i other = _mm_shuffle_epi32(min, _MM_SHUFFLE(1, 0, 3, 2));
+	min           = _mm_blendv_epi8(min, other, _mm_cmpgt_epi64(min, other));
+
+	unsigned int equal = 0;
+	for (size_t j = 0; j < PRIORITY_QUEUE_ARITY / 2; j++) {
+		int lane_mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(lanes[j], min)));
+		equal |= (unsigned int)lane_mask << (2 * j);
+	}
+	return (size_t)__builtin_ctz(equal);
 }
 
+/* The widest kernel this CPU supports, or NULL for the scalar scan. Chosen once
+ * at load time rather than on every sift step */
+static size_t (*priority_queue_smallest_child_simd)(const uint64_t *keys);
+
+/**
+ * Picks priority_queue_smallest_child_simd before main runs, so the queue
+ * needs no initialization order and no synchronization to read it
+ */
+__attribute__((constructor)) static void
+priority_queue_select_simd(void)
+{
+	// Constructors may run before the compiler's own CPU detection
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		priority_queue_smallest_child_simd = priority_queue_smallest_child_avx2;
+	} else if (__builtin_cpu_supports("sse4.2")) {
+		priority_queue_smallest_child_simd = priority_queue_smallest_child_sse42;
+	}
+}
+#endif /* PRIORITY_QUEUE_SIMD */
+
 /**
  * Returns the index of a node's smallest child
  * @param self the priority queue
@@ -52,63 +442,312 @@ priority_queue_percolate_up(struct priority_queue *const self)
  * @returns the index of the smallest child
  */
 static inline size_t
-priority_queue_find_smallest_child(const struct priority_queue *const self, size_t parent_index)
+priority_queue_find_smallest_child(struct priority_queue *const self, size_t parent_index)
 {
 	assert(self != NULL);
-	assert(parent_index >= 1 && parent_index < self->first_free);
-	assert(self->get_key != NULL);
+	assert(parent_index >= PRIORITY_QUEUE_ROOT && parent_index < self->first_free);
 
-	size_t left_child_index  = 2 * parent_index;
-	size_t right_child_index = 2 * parent_index + 1;
-	assert(self->items[left_child_index] != NULL);
+	size_t first_child_index = priority_queue_first_child_index(parent_index);
+	size_t end_child_index   = first_child_index + priority_queue_child_count(parent_index);
+	// The last sibling group may be partially filled
+	if (end_child_index > self->first_free) end_child_index = self->first_free;
+	assert(first_child_index < end_child_index);
 
-	// If we don't have a right child or the left child is smaller, return it
-	if (right_child_index == self->first_free) {
-		return left_child_index;
-	} else if (self->get_key(self->items[left_child_index])
-	           < self->get_key(self->items[right_child_index])) {
-		return left_child_index;
-	} else {
-		// Otherwise, return the right child
-		return right_child_index;
+	PRIORITY_QUEUE_COUNT(self, comparisons, end_child_index - first_child_index - 1);
+#if PRIORITY_QUEUE_SIMD
+	// Only the last sibling group can be partial, so almost every call takes a vector path
+	size_t child_count = end_child_index - first_child_index;
+	if (child_count == PRIORITY_QUEUE_ARITY && priority_queue_smallest_child_simd != NULL) {
+		return first_child_index + priority_queue_smallest_child_simd(&self->keys[first_child_index]);
 	}
+#endif
+
+	return priority_queue_smallest_child_index(self->keys, parent_index, self->first_free);
 }
 
 /**
- * Shifts the top of the heap downwards. Used after placing the last value at
- * the top
+ * Shifts a value downwards until it is no larger than its children. Used after
+ * placing the last value at the top, and by heapify on every internal node.
+ * Like percolate_up, smaller children move up into a hole and the displaced
+ * value is written once at its final position.
  * @param self the priority queue
+ * @param index the slot holding the value to shift
  */
 static inline void
-priority_queue_percolate_down(struct priority_queue *const self)
+priority_queue_percolate_down(struct priority_queue *const self, size_t index)
 {
 	assert(self != NULL);
-	assert(self->get_key != NULL);
+	assert(index >= PRIORITY_QUEUE_ROOT && index < self->first_free);
 
-	size_t parent_index     = 1;
-	size_t left_child_index = 2 * parent_index;
-	while (left_child_index >= 2 && left_child_index < self->first_free) {
+	size_t   parent_index = index;
+	size_t   depth        = 0;
+	uint64_t key          = self->keys[parent_index];
+	void    *item         = self->items[parent_index];
+	while (priority_queue_first_child_index(parent_index) < self->first_free) {
 		size_t smallest_child_index = priority_queue_find_smallest_child(self, parent_index);
 		// Once the parent is equal to or less than its smallest child, break;
-		if (self->get_key(self->items[parent_index])
-		    <= self->get_key(self->items[smallest_child_index]))
-			break;
-		// Otherwise, swap and continue down the tree
-		void *temp                        = self->items[smallest_child_index];
-		self->items[smallest_child_index] = self->items[parent_index];
-		self->items[parent_index]         = temp;
+		PRIORITY_QUEUE_COUNT(self, comparisons, 1);
+		if (key <= self->keys[smallest_child_index]) break;
+		// Otherwise, move the child up and continue down the tree
+		priority_queue_place(self, parent_index, self->keys[smallest_child_index], self->items[smallest_child_index]);
+		PRIORITY_QUEUE_COUNT(self, moves, 1);
+
+		parent_index = smallest_child_index;
+		depth++;
+	}
+	priority_queue_place(self, parent_index, key, item);
+	PRIORITY_QUEUE_COUNT_DEPTH(self, percolate_down_depth, depth);
+}
+
+/**
+ * Restores the heap property after the slots from first_new to first_free - 1
+ * were filled without percolating. Only ancestors of the new slots can be out
+ * of order, so this sifts them down one level at a time, deepest first. The
+ * ancestors of a contiguous run of slots form a contiguous run one level up,
+ * and once that run reaches the root the pass is a plain Floyd heapify of the
+ * prefix, so the cost is O(k + log n) for k new slots and O(n) at worst.
+ * In a B-heap a page's first slots have parents far behind them, so runs do
+ * not map to runs; it heapifies the whole prefix when every slot is new and
+ * otherwise percolates each new slot up, O(k log n).
+ * @param self the priority queue
+ * @param first_new index of the first slot that was appended
+ */
+static inline void
+priority_queue_heapify_from(struct priority_queue *const self, size_t first_new)
+{
+	assert(self != NULL);
+	assert(first_new >= PRIORITY_QUEUE_ROOT && first_new <= self->first_free);
+
+	if (first_new == self->first_free) return;
+
+#ifdef PRIORITY_QUEUE_BHEAP
+	if (first_new == PRIORITY_QUEUE_ROOT) {
+		for (size_t i = self->first_free; i-- > PRIORITY_QUEUE_ROOT;) priority_queue_percolate_down(self, i);
+	} else {
+		for (size_t i = first_new; i < self->first_free; i++) priority_queue_percolate_up(self, i);
+	}
+#else
+	size_t low  = first_new;
+	size_t high = self->first_free - 1;
+	while (high > PRIORITY_QUEUE_ROOT) {
+		low  = low > PRIORITY_QUEUE_ROOT ? priority_queue_parent_index(low) : PRIORITY_QUEUE_ROOT;
+		high = priority_queue_parent_index(high);
+		for (size_t i = high + 1; i-- > low;) priority_queue_percolate_down(self, i);
+		// A run that starts at the root has covered every remaining ancestor
+		if (low == PRIORITY_QUEUE_ROOT) break;
+	}
+#endif
+}
+
+/**
+ * @param n a positive integer
+ * @returns floor(log2(n))
+ */
+static inline size_t
+priority_queue_log2(size_t n)
+{
+	assert(n > 0);
+
+	size_t result = 0;
+	while (n >>= 1) result++;
+	return result;
+}
+
+/**
+ * Sifts slot i of a 0-indexed binary max-heap laid over keys[base..base+length)
+ * @param self the priority queue
+ * @param base index of the first slot of the max-heap
+ * @param length number of slots in the max-heap
+ * @param i the 0-based node to sift down
+ */
+static inline void
+priority_queue_sift_down_max(struct priority_queue *const self, size_t base, size_t length, size_t i)
+{
+	for (;;) {
+		size_t largest = i;
+		size_t left    = 2 * i + 1;
+		size_t right   = left + 1;
+		if (left < length && self->keys[base + left] > self->keys[base + largest]) largest = left;
+		if (right < length && self->keys[base + right] > self->keys[base + largest]) largest = right;
+		PRIORITY_QUEUE_COUNT(self, comparisons, (uint64_t)(left < length) + (uint64_t)(right < length));
+		if (largest == i) return;
+		priority_queue_swap(self, base + i, base + largest);
+		i = largest;
+	}
+}
+
+/**
+ * Sorts the slots from begin to end - 1 by ascending key with an in-place
+ * heapsort, so no scratch memory is needed
+ * @param self the priority queue
+ * @param begin index of the first slot to sort
+ * @param end index one past the last slot to sort
+ */
+static void
+priority_queue_sort_range(struct priority_queue *const self, size_t begin, size_t end)
+{
+	assert(begin <= end);
+
+	size_t length = end - begin;
+	for (size_t i = length / 2; i-- > 0;) priority_queue_sift_down_max(self, begin, length, i);
+	for (size_t last = length; last-- > 1;) {
+		priority_queue_swap(self, begin, begin + last);
+		priority_queue_sift_down_max(self, begin, last, 0);
+	}
+}
+
+/**
+ * Removes every element with a key at or below key_limit in one pass: the
+ * qualifying slots are partitioned to the end of the heap, sorted, copied out,
+ * and the remaining elements are heapified once. Costs O(n + k log k) no
+ * matter how many elements qualify.
+ * @param self the priority queue
+ * @param key_limit the largest key to remove
+ * @param out buffer receiving the removed elements in ascending key order,
+ * with room for every queued element
+ * @returns the number of elements removed
+ */
+static size_t
+priority_queue_extract_until(struct priority_queue *const self, uint64_t key_limit, void **out)
+{
+	assert(self != NULL);
+
+	PRIORITY_QUEUE_COUNT(self, comparisons, priority_queue_length(self));
+	size_t end = self->first_free;
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < end;) {
+		if (self->keys[i] <= key_limit) {
+			priority_queue_swap(self, i, --end);
+		} else {
+			i++;
+		}
+	}
+	size_t qualifying = self->first_free - end;
+
+	priority_queue_sort_range(self, end, self->first_free);
+	for (size_t i = 0; i < qualifying; i++) {
+		out[i]               = self->items[end + i];
+		self->items[end + i] = NULL;
+		priority_queue_release(self, out[i]);
+		priority_queue_aggregate_remove(self, out[i], self->keys[end + i]);
+		PRIORITY_QUEUE_RECORD(self, DEQUEUE, self->keys[end + i]);
+	}
+	self->first_free = end;
+	// Only the smallest keys left, so the maximum stays unless nothing does
+	if (self->first_free == PRIORITY_QUEUE_ROOT) {
+		self->max_key       = 0;
+		self->max_key_stale = false;
+	}
+
+	priority_queue_heapify_from(self, PRIORITY_QUEUE_ROOT);
+	self->min_key = self->first_free > PRIORITY_QUEUE_ROOT ? self->keys[PRIORITY_QUEUE_ROOT] : UINT64_MAX;
+	priority_queue_shrink(self);
+	return qualifying;
+}
+
+/**
+ * Moves the value at index up or down, whichever restores the heap property
+ * after its key changed or it replaced a removed element
+ * @param self the priority queue
+ * @param index the slot whose key changed
+ */
+static inline void
+priority_queue_restore(struct priority_queue *const self, size_t index)
+{
+	assert(self != NULL);
+	assert(index >= PRIORITY_QUEUE_ROOT && index < self->first_free);
+
+	PRIORITY_QUEUE_COUNT(self, comparisons, index > PRIORITY_QUEUE_ROOT);
+	if (index > PRIORITY_QUEUE_ROOT && self->keys[index] < self->keys[priority_queue_parent_index(index)]) {
+		priority_queue_percolate_up(self, index);
+	} else {
+		priority_queue_percolate_down(self, index);
+	}
+}
+
+/**
+ * @param self the priority queue, in indexed mode
+ * @param value an element
+ * @returns the slot holding value, or PRIORITY_QUEUE_UNINDEXED if it is not queued here
+ */
+static inline size_t
+priority_queue_find(const struct priority_queue *const self, void *value)
+{
+	size_t index = *priority_queue_index_field(self, value);
+	if (index < PRIORITY_QUEUE_ROOT || index >= self->first_free || self->items[index] != value) {
+		return PRIORITY_QUEUE_UNINDEXED;
+	}
+	return index;
+}
 
-		parent_index     = smallest_child_index;
-		left_child_index = 2 * parent_index;
+/**
+ * Points a cursor at the unvisited slot of its sibling group with the smallest key
+ * @param queue the queue being iterated
+ * @param cursor a cursor with at least one unvisited slot
+ */
+static inline void
+priority_queue_cursor_settle(const struct priority_queue *const queue, struct priority_queue_cursor *cursor)
+{
+	assert(cursor->unvisited != 0);
+
+	size_t   group_start = cursor->index - cursor->index % PRIORITY_QUEUE_ARITY;
+	uint32_t unvisited   = cursor->unvisited;
+	size_t   smallest    = group_start + (size_t)__builtin_ctz(unvisited);
+	for (unvisited &= unvisited - 1; unvisited != 0; unvisited &= unvisited - 1) {
+		size_t i = group_start + (size_t)__builtin_ctz(unvisited);
+		smallest = queue->keys[i] < queue->keys[smallest] ? i : smallest;
+	}
+	cursor->index = smallest;
+}
+
+/**
+ * Moves the frontier entry at index up to its place in the frontier's binary heap
+ * @param self the iterator
+ * @param index the frontier entry to shift
+ */
+static inline void
+priority_queue_frontier_sift_up(struct priority_queue_iterator *const self, size_t index)
+{
+	const uint64_t              *keys   = self->queue->keys;
+	struct priority_queue_cursor cursor = self->frontier[index];
+	while (index > 0) {
+		size_t parent = (index - 1) / 2;
+		if (keys[cursor.index] >= keys[self->frontier[parent].index]) break;
+		self->frontier[index] = self->frontier[parent];
+		index                 = parent;
+	}
+	self->frontier[index] = cursor;
+}
+
+/**
+ * Moves the frontier entry at index down to its place in the frontier's binary heap
+ * @param self the iterator
+ * @param index the frontier entry to shift
+ */
+static inline void
+priority_queue_frontier_sift_down(struct priority_queue_iterator *const self, size_t index)
+{
+	const uint64_t              *keys   = self->queue->keys;
+	struct priority_queue_cursor cursor = self->frontier[index];
+	for (size_t child = 2 * index + 1; child < self->frontier_length; child = 2 * index + 1) {
+		if (child + 1 < self->frontier_length
+		    && keys[self->frontier[child + 1].index] < keys[self->frontier[child].index]) {
+			child++;
+		}
+		if (keys[cursor.index] <= keys[self->frontier[child].index]) break;
+		self->frontier[index] = self->frontier[child];
+		index                 = child;
 	}
+	self->frontier[index] = cursor;
 }
 
 /*********************
  * Public API        *
  *********************/
 
+#if PRIORITY_QUEUE_CAPACITY > 0
 /**
- * Initialized the Priority Queue Data structure
+ * Initialized the Priority Queue Data structure, using the storage embedded in
+ * the struct. Slots are not zeroed; only first_free decides what is queued.
  * @param self the priority_queue to initialize
  * @param get_key pointer to a function that extracts the ordering key from an element
  **/
@@ -118,11 +757,123 @@ priority_queue_initialize(struct priority_queue *const self, priority_queue_get_
 	assert(self != NULL);
 	assert(get_key != NULL);
 
-	memset(self->items, 0, sizeof(void *) * PRIORITY_QUEUE_CAPACITY);
-	self->first_free   = 1;
-	self->get_key = get_key;
+	self->keys         = self->key_storage;
+	self->items        = self->item_storage;
+	self->first_free   = PRIORITY_QUEUE_ROOT;
+	self->capacity     = PRIORITY_QUEUE_CAPACITY;
+	self->get_key      = get_key;
+	self->index_offset = PRIORITY_QUEUE_UNINDEXED;
+
+	self->allocator     = NULL;
+	self->growth        = PRIORITY_QUEUE_GROWTH_FIXED;
+	self->min_capacity  = PRIORITY_QUEUE_CAPACITY;
+	self->max_capacity  = PRIORITY_QUEUE_CAPACITY;
+	self->growth_failed = false;
 
 	self->min_key = UINT64_MAX;
+	priority_queue_set_get_cost(self, NULL);
+#ifdef PRIORITY_QUEUE_STATS
+	priority_queue_reset_stats(self);
+#endif
+#ifdef PRIORITY_QUEUE_TRACE
+	self->trace = NULL;
+#endif
+}
+
+/**
+ * Initializes the Priority Queue in indexed mode. Each element embeds a size_t
+ * that the queue keeps set to the element's current slot, which makes
+ * priority_queue_remove and priority_queue_update_key O(log n). The field is
+ * set to PRIORITY_QUEUE_UNINDEXED whenever the element leaves the queue.
+ * @param self the priority_queue to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param index_offset offsetof() the size_t index field within the element type
+ **/
+void
+priority_queue_initialize_indexed(struct priority_queue *const self, priority_queue_get_key_t get_key,
+                                  size_t index_offset)
+{
+	assert(index_offset != PRIORITY_QUEUE_UNINDEXED);
+
+	priority_queue_initialize(self, get_key);
+	self->index_offset = index_offset;
+}
+#endif /* PRIORITY_QUEUE_CAPACITY > 0 */
+
+/**
+ * Initializes a Priority Queue whose storage comes from an allocator instead
+ * of the struct, sized per queue at runtime and optionally growing on demand
+ * @param self the priority_queue to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param config initial capacity, growth policy, allocator and indexed mode
+ * @returns 0 on success. -1 when the capacity is too large or allocation fails
+ **/
+int
+priority_queue_initialize_dynamic(struct priority_queue *const self, priority_queue_get_key_t get_key,
+                                  const struct priority_queue_config *config)
+{
+	assert(self != NULL);
+	assert(get_key != NULL);
+	assert(config != NULL);
+	assert(config->capacity > 0);
+	assert(config->max_capacity == 0 || config->max_capacity >= config->capacity);
+	assert(!config->indexed || config->index_offset != PRIORITY_QUEUE_UNINDEXED);
+
+	const size_t max_elements = PRIORITY_QUEUE_MAX_SLOTS - PRIORITY_QUEUE_ROOT;
+	if (config->capacity > max_elements) return -1;
+
+	self->keys         = NULL;
+	self->items        = NULL;
+	self->first_free   = PRIORITY_QUEUE_ROOT;
+	self->capacity     = 0;
+	self->get_key      = get_key;
+	self->index_offset = config->indexed ? config->index_offset : PRIORITY_QUEUE_UNINDEXED;
+
+	self->allocator    = config->allocator != NULL ? config->allocator : &priority_queue_default_allocator;
+	self->growth       = config->growth;
+	self->min_capacity = config->capacity + PRIORITY_QUEUE_ROOT;
+	if (config->growth == PRIORITY_QUEUE_GROWTH_FIXED) {
+		self->max_capacity = self->min_capacity;
+	} else if (config->max_capacity == 0 || config->max_capacity > max_elements) {
+		self->max_capacity = PRIORITY_QUEUE_MAX_SLOTS;
+	} else {
+		self->max_capacity = config->max_capacity + PRIORITY_QUEUE_ROOT;
+	}
+	self->growth_failed = false;
+
+	self->min_key = UINT64_MAX;
+	priority_queue_set_get_cost(self, config->get_cost);
+#ifdef PRIORITY_QUEUE_STATS
+	priority_queue_reset_stats(self);
+#endif
+#ifdef PRIORITY_QUEUE_TRACE
+	self->trace = NULL;
+#endif
+	return priority_queue_resize(self, self->min_capacity);
+}
+
+/**
+ * Releases the storage of a dynamic queue. Queued elements are not touched.
+ * Does nothing beyond clearing a queue that uses embedded storage.
+ * @param self the priority queue to destroy
+ **/
+void
+priority_queue_destroy(struct priority_queue *const self)
+{
+	assert(self != NULL);
+
+	if (self->allocator != NULL && self->keys != NULL) {
+		size_t items_offset;
+		self->allocator->release(self->allocator->context, self->keys,
+		                         priority_queue_storage_size(self->capacity, &items_offset));
+		self->keys     = NULL;
+		self->items    = NULL;
+		self->capacity = 0;
+	}
+	self->first_free    = PRIORITY_QUEUE_ROOT;
+	self->min_key       = UINT64_MAX;
+	self->growth_failed = false;
+	priority_queue_set_get_cost(self, self->get_cost);
 }
 
 /**
@@ -135,9 +886,18 @@ priority_queue_clear(struct priority_queue *const self)
 {
 	assert(self != NULL);
 
-	memset(self->items, 0, sizeof(void *) * PRIORITY_QUEUE_CAPACITY);
-	self->first_free       = 1;
-	self->min_key = UINT64_MAX;
+	if (self->index_offset != PRIORITY_QUEUE_UNINDEXED) {
+		for (size_t i = PRIORITY_QUEUE_ROOT; i < self->first_free; i++) priority_queue_release(self, self->items[i]);
+	}
+	self->first_free    = PRIORITY_QUEUE_ROOT;
+	self->min_key       = UINT64_MAX;
+	self->growth_failed = false;
+	PRIORITY_QUEUE_RECORD(self, CLEAR, 0);
+	priority_queue_set_get_cost(self, self->get_cost);
+	// A shrinkable queue returns to its initial capacity
+	if (self->growth == PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK && self->capacity > self->min_capacity) {
+		(void)priority_queue_resize(self, self->min_capacity);
+	}
 }
 
 /**
@@ -149,7 +909,7 @@ priority_queue_length(const struct priority_queue *const self)
 {
 	assert(self != NULL);
 
-	return self->first_free - 1;
+	return self->first_free - PRIORITY_QUEUE_ROOT;
 }
 
 /**
@@ -161,8 +921,110 @@ priority_queue_peek(const struct priority_queue *const self)
 {
 	assert(self != NULL);
 
-	if (self->first_free == 1) return NULL;
-	return self->items[1];
+	if (self->first_free == PRIORITY_QUEUE_ROOT) return NULL;
+	return self->items[PRIORITY_QUEUE_ROOT];
+}
+
+/**
+ * Copies the k elements with the smallest keys to out in ascending key order,
+ * without changing the queue. Costs O(k (PRIORITY_QUEUE_ARITY + log k)) reads
+ * instead of the O(k log n) writes of dequeuing and enqueuing them again.
+ * @param self the priority queue
+ * @param out buffer receiving the elements
+ * @param k capacity of out
+ * @returns the number of elements written: the smallest of k, the queue's
+ * length and PRIORITY_QUEUE_PEEK_K_MAX. Use an iterator to go further
+ **/
+size_t
+priority_queue_peek_k(const struct priority_queue *const self, void **out, size_t k)
+{
+	assert(self != NULL);
+	assert(out != NULL || k == 0);
+
+	struct priority_queue_cursor   frontier[PRIORITY_QUEUE_PEEK_K_MAX];
+	struct priority_queue_iterator iterator;
+	if (k > PRIORITY_QUEUE_PEEK_K_MAX) k = PRIORITY_QUEUE_PEEK_K_MAX;
+	priority_queue_iterator_initialize(&iterator, self, frontier, k);
+
+	size_t count = 0;
+	for (void *item; (item = priority_queue_iterator_next(&iterator)) != NULL;) out[count++] = item;
+	return count;
+}
+
+/**
+ * Starts an ordered walk over a queue. The queue is only read, so iteration can
+ * be interleaved with other readers, but not with changes to the queue.
+ * @param self the iterator to initialize
+ * @param queue the priority queue to walk
+ * @param frontier scratch space owned by the caller for the iterator's lifetime
+ * @param frontier_capacity entries in frontier, which is also the number of
+ * elements the iterator visits at most
+ **/
+void
+priority_queue_iterator_initialize(struct priority_queue_iterator *const self, const struct priority_queue *const queue,
+                                   struct priority_queue_cursor *frontier, size_t frontier_capacity)
+{
+	assert(self != NULL);
+	assert(queue != NULL);
+	assert(frontier != NULL || frontier_capacity == 0);
+
+	self->queue           = queue;
+	self->frontier        = frontier;
+	self->frontier_length = 0;
+	self->remaining       = frontier_capacity;
+	self->last            = SIZE_MAX;
+	if (frontier_capacity > 0 && queue->first_free > PRIORITY_QUEUE_ROOT) {
+		// The root is alone in its sibling group, as its last slot
+		frontier[0] = (struct priority_queue_cursor){ .index     = PRIORITY_QUEUE_ROOT,
+			                                      .unvisited = UINT32_C(1) << PRIORITY_QUEUE_ROOT };
+		self->frontier_length = 1;
+	}
+}
+
+/**
+ * Visits the next element in ascending key order. Before visiting the k-th
+ * element the frontier holds at most k entries: each step adds at most the
+ * previous element's children as one entry and visits one slot.
+ * @param self the iterator
+ * @returns the element with the next smallest key, or NULL once every element
+ * or frontier_capacity elements have been visited
+ **/
+void *
+priority_queue_iterator_next(struct priority_queue_iterator *const self)
+{
+	assert(self != NULL);
+
+	if (self->remaining == 0) return NULL;
+
+	const struct priority_queue *queue = self->queue;
+	if (self->last != SIZE_MAX) {
+		size_t first_child_index = priority_queue_first_child_index(self->last);
+		if (first_child_index < queue->first_free) {
+			size_t children = queue->first_free - first_child_index;
+			size_t limit    = priority_queue_child_count(self->last);
+			if (children > limit) children = limit;
+			// A B-heap's only children may sit in the second slot of their group
+			uint32_t unvisited = (uint32_t)((UINT64_C(1) << children) - 1)
+			                     << first_child_index % PRIORITY_QUEUE_ARITY;
+			struct priority_queue_cursor cursor = { .index = first_child_index, .unvisited = unvisited };
+			priority_queue_cursor_settle(queue, &cursor);
+			self->frontier[self->frontier_length] = cursor;
+			priority_queue_frontier_sift_up(self, self->frontier_length++);
+		}
+	}
+	if (self->frontier_length == 0) return NULL;
+
+	struct priority_queue_cursor *top = &self->frontier[0];
+	self->last = top->index;
+	top->unvisited &= ~(UINT32_C(1) << (top->index % PRIORITY_QUEUE_ARITY));
+	if (top->unvisited != 0) {
+		priority_queue_cursor_settle(queue, top);
+	} else {
+		*top = self->frontier[--self->frontier_length];
+	}
+	if (self->frontier_length > 0) priority_queue_frontier_sift_down(self, 0);
+	self->remaining--;
+	return queue->items[self->last];
 }
 
 /**
@@ -174,17 +1036,67 @@ int
 priority_queue_enqueue(struct priority_queue *const self, void *value)
 {
 	assert(self != NULL);
+	assert(self->get_key != NULL);
 
-	if (priority_queue_append(self, value) == -1) return -1;
-	if (self->first_free > 2) {
-		priority_queue_percolate_up(self);
-	} else {
-		// If this is the first element we add, update the highest priority
-		self->min_key = self->get_key(value);
+	// The only get_key call for this element; comparisons use keys[] from here on
+	uint64_t key = self->get_key(value);
+	PRIORITY_QUEUE_COUNT(self, get_key_calls, 1);
+	if (priority_queue_append(self, value, key) == -1) {
+		PRIORITY_QUEUE_COUNT(self, full_rejections, 1);
+		return -1;
 	}
+	PRIORITY_QUEUE_COUNT_HIGH_WATER(self);
+	PRIORITY_QUEUE_RECORD(self, ENQUEUE, key);
+	priority_queue_aggregate_add(self, value, key);
+	priority_queue_percolate_up(self, self->first_free - 1);
+	self->min_key = self->keys[PRIORITY_QUEUE_ROOT];
 	return 0;
 }
 
+/**
+ * Adds several values at once. The values are appended as-is and the heap is
+ * rebuilt bottom-up a single time instead of percolating each value. When the
+ * batch is at least as large as the queue the whole heap is rebuilt with
+ * Floyd's O(n) heapify; otherwise only the ancestors of the new slots are.
+ * @param self - the priority queue we want to add to
+ * @param values - the values we want to add
+ * @param n - the number of values
+ * @returns the number of values accepted, always a prefix of values. Less than
+ * n only when the priority queue fills up
+ **/
+size_t
+priority_queue_enqueue_batch(struct priority_queue *const self, void **values, size_t n)
+{
+	assert(self != NULL);
+	assert(self->get_key != NULL);
+	assert(values != NULL || n == 0);
+
+	size_t needed = n > SIZE_MAX - self->first_free ? SIZE_MAX : self->first_free + n;
+	if (needed > self->capacity) priority_queue_grow(self, needed);
+
+	size_t free_slots = self->capacity - self->first_free;
+	size_t accepted   = n < free_slots ? n : free_slots;
+	PRIORITY_QUEUE_COUNT(self, full_rejections, n - accepted);
+	if (accepted == 0) return 0;
+
+	size_t old_length = priority_queue_length(self);
+	size_t first_new  = self->first_free;
+	// Capacity was checked above, so these appends cannot fail
+	for (size_t i = 0; i < accepted; i++) {
+		uint64_t key = self->get_key(values[i]);
+		priority_queue_place(self, self->first_free, key, values[i]);
+		priority_queue_aggregate_add(self, values[i], key);
+		PRIORITY_QUEUE_RECORD(self, ENQUEUE, key);
+		self->first_free++;
+	}
+	PRIORITY_QUEUE_COUNT(self, get_key_calls, accepted);
+	PRIORITY_QUEUE_COUNT_HIGH_WATER(self);
+
+	priority_queue_heapify_from(self, accepted >= old_length ? PRIORITY_QUEUE_ROOT : first_new);
+	self->min_key = self->keys[PRIORITY_QUEUE_ROOT];
+	return accepted;
+}
+
 /**
  * @param self - the priority queue we want to add to
  * @returns The head of the priority queue or NULL when empty
@@ -193,26 +1105,226 @@ void *
 priority_queue_dequeue(struct priority_queue *const self)
 {
 	assert(self != NULL);
-	assert(self->get_key != NULL);
-	// If first_free is 1, we're empty
-	if (self->first_free == 1) return NULL;
+	// If first_free is the root index, we're empty
+	if (self->first_free == PRIORITY_QUEUE_ROOT) return NULL;
 
-	void *min                         = self->items[1];
-	self->items[1]                    = self->items[self->first_free - 1];
+	void *min = self->items[PRIORITY_QUEUE_ROOT];
+	priority_queue_aggregate_remove(self, min, self->keys[PRIORITY_QUEUE_ROOT]);
+	PRIORITY_QUEUE_RECORD(self, DEQUEUE, self->keys[PRIORITY_QUEUE_ROOT]);
+	priority_queue_place(self, PRIORITY_QUEUE_ROOT, self->keys[self->first_free - 1], self->items[self->first_free - 1]);
+	PRIORITY_QUEUE_COUNT(self, moves, 1);
 	self->items[self->first_free - 1] = NULL;
+	priority_queue_release(self, min);
 	self->first_free--;
-	assert(self->first_free == 1 || self->items[self->first_free - 1] != NULL);
-	// Because of 1-based indices, first_free is 2 when there is only one element
-	if (self->first_free > 2) priority_queue_percolate_down(self);
+	assert(self->first_free == PRIORITY_QUEUE_ROOT || self->items[self->first_free - 1] != NULL);
+	// first_free is ROOT + 1 when there is only one element
+	if (self->first_free > PRIORITY_QUEUE_ROOT + 1) priority_queue_percolate_down(self, PRIORITY_QUEUE_ROOT);
 
-	if (self->first_free > 1) {
-		self->min_key = self->get_key(self->items[1]);
+	if (self->first_free > PRIORITY_QUEUE_ROOT) {
+		self->min_key = self->keys[PRIORITY_QUEUE_ROOT];
 	} else {
-		self->min_key = UINT64_MAX;
+		self->min_key       = UINT64_MAX;
+		self->max_key       = 0;
+		self->max_key_stale = false;
 	}
+	priority_queue_shrink(self);
 	return min;
 }
 
+/**
+ * Removes an arbitrary element in O(log n). Requires indexed mode.
+ * @param self - the priority queue we want to remove from
+ * @param value - the element to remove
+ * @returns 0 on success. -1 when value is not in the priority queue
+ **/
+int
+priority_queue_remove(struct priority_queue *const self, void *value)
+{
+	assert(self != NULL);
+	assert(value != NULL);
+
+	size_t index = priority_queue_find(self, value);
+	if (index == PRIORITY_QUEUE_UNINDEXED) return -1;
+
+	uint64_t key  = self->keys[index];
+	size_t   last = self->first_free - 1;
+	priority_queue_aggregate_remove(self, value, key);
+	if (index != last) {
+		priority_queue_place(self, index, self->keys[last], self->items[last]);
+		PRIORITY_QUEUE_COUNT(self, moves, 1);
+	}
+	self->items[last] = NULL;
+	self->first_free--;
+	priority_queue_release(self, value);
+	if (index != last) priority_queue_restore(self, index);
+
+	self->min_key = self->first_free > PRIORITY_QUEUE_ROOT ? self->keys[PRIORITY_QUEUE_ROOT] : UINT64_MAX;
+	priority_queue_shrink(self);
+	return 0;
+}
+
+/**
+ * Re-reads an element's key after the caller changed it, and moves the element
+ * to its new position in O(log n). Works for both earlier and later keys.
+ * Requires indexed mode.
+ * @param self - the priority queue holding value
+ * @param value - the element whose key changed
+ * @returns 0 on success. -1 when value is not in the priority queue
+ **/
+int
+priority_queue_update_key(struct priority_queue *const self, void *value)
+{
+	assert(self != NULL);
+	assert(self->get_key != NULL);
+	assert(value != NULL);
+
+	size_t index = priority_queue_find(self, value);
+	if (index == PRIORITY_QUEUE_UNINDEXED) return -1;
+
+	uint64_t old_key  = self->keys[index];
+	uint64_t key      = self->get_key(value);
+	self->keys[index] = key;
+	PRIORITY_QUEUE_COUNT(self, get_key_calls, 1);
+	priority_queue_restore(self, index);
+	if (self->get_cost != NULL) {
+		self->key_sum += key - old_key;
+		if (key >= self->max_key) {
+			self->max_key       = key;
+			self->max_key_stale = false;
+		} else if (old_key == self->max_key) {
+			self->max_key_stale = true;
+		}
+	}
+
+	self->min_key = self->keys[PRIORITY_QUEUE_ROOT];
+	return 0;
+}
+
+/**
+ * Removes every element with a key at or below key_limit, up to max_out of
+ * them, in ascending key order. Small drains pop one element at a time. Once
+ * about n / log n elements have been popped and more still qualify, the rest
+ * are extracted together and the heap is rebuilt once, which is cheaper than
+ * percolating the root for each of them. The bulk path is only taken when out
+ * has room for every remaining element, so a bounded drain of a large queue,
+ * such as a steal of a few elements, keeps popping.
+ * @param self - the priority queue we want to remove from
+ * @param key_limit - the largest key to remove, e.g. the current time
+ * @param out - buffer receiving the removed elements
+ * @param max_out - capacity of out
+ * @returns the number of elements written to out
+ **/
+size_t
+priority_queue_dequeue_until(struct priority_queue *const self, uint64_t key_limit, void **out, size_t max_out)
+{
+	assert(self != NULL);
+	assert(out != NULL || max_out == 0);
+
+	size_t length    = priority_queue_length(self);
+	size_t pop_limit = length > 1 ? length / priority_queue_log2(length) : length;
+	size_t count     = 0;
+	while (count < max_out && self->first_free > PRIORITY_QUEUE_ROOT && self->keys[PRIORITY_QUEUE_ROOT] <= key_limit) {
+		// Length and room shrink together, so if everything left does not fit now it never will
+		if (count == pop_limit && priority_queue_length(self) <= max_out - count) {
+			return count + priority_queue_extract_until(self, key_limit, &out[count]);
+		}
+		out[count++] = priority_queue_dequeue(self);
+	}
+	return count;
+}
+
+/**
+ * Starts or stops keeping admission-control aggregates. With a get_cost
+ * callback, every enqueue and removal updates the total cost, key sum and
+ * maximum key in O(1), at the price of one get_cost call per element on the
+ * way in and one on the way out. Removing the maximum only marks it stale;
+ * priority_queue_get_aggregates recomputes it when asked. The aggregates are recomputed from the
+ * queued elements, so this can be called on a queue that is in use.
+ * @param self the priority queue
+ * @param get_cost pointer to a function returning an element's cost, or NULL to stop
+ **/
+void
+priority_queue_set_get_cost(struct priority_queue *const self, priority_queue_get_cost_t get_cost)
+{
+	assert(self != NULL);
+
+	self->get_cost      = get_cost;
+	self->total_cost    = 0;
+	self->key_sum       = 0;
+	self->max_key       = 0;
+	self->max_key_stale = false;
+	if (get_cost == NULL) return;
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < self->first_free; i++) {
+		priority_queue_aggregate_add(self, self->items[i], self->keys[i]);
+	}
+}
+
+/**
+ * Reads the running aggregates. O(1), except that the first read after the
+ * element holding max_key was removed or got an earlier key scans the heap's
+ * leaves to find the new maximum. Requires a get_cost callback.
+ * @param self the priority queue
+ * @param out receives the aggregates
+ **/
+void
+priority_queue_get_aggregates(struct priority_queue *const self, struct priority_queue_aggregates *out)
+{
+	assert(self != NULL);
+	assert(self->get_cost != NULL);
+	assert(out != NULL);
+
+	priority_queue_aggregate_refresh_max(self);
+	*out = (struct priority_queue_aggregates){ .count      = priority_queue_length(self),
+		                                   .total_cost = self->total_cost,
+		                                   .key_sum    = self->key_sum,
+		                                   .min_key    = self->min_key,
+		                                   .max_key    = self->max_key };
+}
+
+/**
+ * Visits the subtree at index, pruned at the first key past key_limit
+ * @param self the priority queue
+ * @param index root of the subtree
+ * @param key_limit the largest key to count
+ * @returns the total cost of the subtree's elements with keys at or below key_limit
+ */
+static uint64_t
+priority_queue_subtree_cost_until(const struct priority_queue *const self, size_t index, uint64_t key_limit)
+{
+	if (self->keys[index] > key_limit) return 0;
+
+	uint64_t cost              = self->get_cost(self->items[index]);
+	size_t   first_child_index = priority_queue_first_child_index(index);
+	size_t   end_child_index   = first_child_index + priority_queue_child_count(index);
+	for (size_t i = first_child_index; i < end_child_index && i < self->first_free; i++) {
+		cost += priority_queue_subtree_cost_until(self, i, key_limit);
+	}
+	return cost;
+}
+
+/**
+ * Answers "how much work is queued at or before key_limit?". The cost is
+ * output-sensitive, not O(1): only elements that qualify and their children are
+ * visited, since a heap puts no larger key above a smaller one, so a limit that
+ * k elements meet takes O(k * ARITY). It is O(1) when key_limit is below
+ * min_key or at least max_key. A stale max_key is still an upper bound on every
+ * key, so that shortcut stays correct without refreshing it. Requires a
+ * get_cost callback.
+ * @param self the priority queue
+ * @param key_limit the largest key to count, e.g. a new request's deadline
+ * @returns the total cost of queued elements with keys at or below key_limit
+ **/
+uint64_t
+priority_queue_cost_until(const struct priority_queue *const self, uint64_t key_limit)
+{
+	assert(self != NULL);
+	assert(self->get_cost != NULL);
+
+	if (self->first_free == PRIORITY_QUEUE_ROOT || key_limit < self->min_key) return 0;
+	if (key_limit >= self->max_key) return self->total_cost;
+	return priority_queue_subtree_cost_until(self, PRIORITY_QUEUE_ROOT, key_limit);
+}
+
 /**
  * @param self the priority queue
  * @returns true if the priority queue contains no elements
@@ -222,17 +1334,65 @@ priority_queue_is_empty(const struct priority_queue *const self)
 {
 	assert(self != NULL);
 
-	return self->first_free == 1;
+	return self->first_free == PRIORITY_QUEUE_ROOT;
 }
 
 /**
  * @param self the priority queue
- * @returns true if the priority queue has reached maximum capacity
+ * @returns true if the next enqueue would fail: every slot is used and the
+ * queue cannot grow, either because it reached max_capacity or because the
+ * allocator refused to grow it and no element has left since
  **/
 bool
 priority_queue_is_full(const struct priority_queue *const self)
 {
 	assert(self != NULL);
 
-	return self->first_free >= PRIORITY_QUEUE_CAPACITY;
+	if (self->first_free < self->capacity) return false;
+	return self->capacity >= self->max_capacity || self->growth_failed;
+}
+
+#ifdef PRIORITY_QUEUE_STATS
+/**
+ * Copies the hot-path counters. Only built with -DPRIORITY_QUEUE_STATS.
+ * @param self the priority queue
+ * @param stats receives the counters
+ **/
+void
+priority_queue_get_stats(const struct priority_queue *const self, struct priority_queue_stats *stats)
+{
+	assert(self != NULL);
+	assert(stats != NULL);
+
+	*stats = self->stats;
+}
+
+/**
+ * Zeroes the hot-path counters. The high-water mark restarts from the current length.
+ * @param self the priority queue
+ **/
+void
+priority_queue_reset_stats(struct priority_queue *const self)
+{
+	assert(self != NULL);
+
+	memset(&self->stats, 0, sizeof(self->stats));
+	self->stats.high_water = self->first_free - PRIORITY_QUEUE_ROOT;
+}
+#endif
+
+#ifdef PRIORITY_QUEUE_TRACE
+/**
+ * Starts or stops recording this queue's operations. Only built with
+ * -DPRIORITY_QUEUE_TRACE.
+ * @param self the priority queue
+ * @param trace an initialized trace, or NULL to stop
+ **/
+void
+priority_queue_set_trace(struct priority_queue *const self, struct priority_queue_trace *trace)
+{
+	assert(self != NULL);
+
+	self->trace = trace;
 }
+#endif
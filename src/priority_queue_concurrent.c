@@ -0,0 +1,280 @@
+#include "priority_queue_concurrent.h"
+#include <assert.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Spins of a waiting thread before it yields its CPU. Yielding lets a lock
+ * holder or an earlier ticket that was preempted run again, which matters
+ * once threads outnumber cores. */
+#define PRIORITY_QUEUE_CONCURRENT_SPINS_BEFORE_YIELD 128
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * Hints to the CPU that we are busy-waiting, which saves power and frees
+ * pipeline resources for a sibling hyperthread
+ */
+static inline void
+priority_queue_concurrent_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * Waits a little longer for the lock: a pause instruction most of the time,
+ * and a yield of the CPU every PRIORITY_QUEUE_CONCURRENT_SPINS_BEFORE_YIELD calls
+ * @param spins the caller's spin counter
+ */
+static inline void
+priority_queue_concurrent_backoff(uint32_t *spins)
+{
+	if (++*spins < PRIORITY_QUEUE_CONCURRENT_SPINS_BEFORE_YIELD) {
+		priority_queue_concurrent_cpu_relax();
+	} else {
+		*spins = 0;
+		sched_yield();
+	}
+}
+
+/**
+ * Resets the lock and publishes the empty queue's key
+ * @param self the concurrent priority queue
+ */
+static inline void
+priority_queue_concurrent_initialize_lock(struct priority_queue_concurrent *const self)
+{
+	atomic_init(&self->next_ticket, 0);
+	atomic_init(&self->now_serving, 0);
+	atomic_init(&self->min_key, self->queue.min_key);
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+/**
+ * Initializes a concurrent queue backed by embedded storage
+ * @param self the concurrent priority queue to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ **/
+void
+priority_queue_concurrent_initialize(struct priority_queue_concurrent *const self, priority_queue_get_key_t get_key)
+{
+	assert(self != NULL);
+
+	priority_queue_initialize(&self->queue, get_key);
+	priority_queue_concurrent_initialize_lock(self);
+}
+#endif
+
+/**
+ * Initializes a concurrent queue backed by allocator storage
+ * @param self the concurrent priority queue to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param config see priority_queue_initialize_dynamic
+ * @returns 0 on success. -1 when allocation fails
+ **/
+int
+priority_queue_concurrent_initialize_dynamic(struct priority_queue_concurrent *const self,
+                                             priority_queue_get_key_t get_key, const struct priority_queue_config *config)
+{
+	assert(self != NULL);
+
+	if (priority_queue_initialize_dynamic(&self->queue, get_key, config) != 0) return -1;
+	priority_queue_concurrent_initialize_lock(self);
+	return 0;
+}
+
+/**
+ * Releases the queue's storage. No other thread may use the queue afterwards.
+ * @param self the concurrent priority queue to destroy
+ **/
+void
+priority_queue_concurrent_destroy(struct priority_queue_concurrent *const self)
+{
+	assert(self != NULL);
+
+	priority_queue_destroy(&self->queue);
+	atomic_store_explicit(&self->min_key, UINT64_MAX, memory_order_release);
+}
+
+/**
+ * Takes the lock, spinning until it is this thread's turn. Tickets are served
+ * in order, so waiters cannot starve. Callers may then use self->queue
+ * directly; priority_queue_concurrent_unlock republishes min_key.
+ * @param self the concurrent priority queue
+ **/
+void
+priority_queue_concurrent_lock(struct priority_queue_concurrent *const self)
+{
+	assert(self != NULL);
+
+	uint32_t ticket = atomic_fetch_add_explicit(&self->next_ticket, 1, memory_order_relaxed);
+	uint32_t spins  = 0;
+	while (atomic_load_explicit(&self->now_serving, memory_order_acquire) != ticket) {
+		priority_queue_concurrent_backoff(&spins);
+	}
+}
+
+/**
+ * Takes the lock only if nobody holds it or is waiting for it
+ * @param self the concurrent priority queue
+ * @returns true if the lock was taken
+ **/
+bool
+priority_queue_concurrent_try_lock(struct priority_queue_concurrent *const self)
+{
+	assert(self != NULL);
+
+	uint32_t serving = atomic_load_explicit(&self->now_serving, memory_order_acquire);
+	// The lock is free exactly when the next ticket to hand out is the one being served
+	return atomic_compare_exchange_strong_explicit(&self->next_ticket, &serving, serving + 1, memory_order_acquire,
+	                                               memory_order_relaxed);
+}
+
+/**
+ * Publishes the queue's current root key and releases the lock
+ * @param self the concurrent priority queue
+ **/
+void
+priority_queue_concurrent_unlock(struct priority_queue_concurrent *const self)
+{
+	assert(self != NULL);
+
+	atomic_store_explicit(&self->min_key, self->queue.min_key, memory_order_release);
+	uint32_t serving = atomic_load_explicit(&self->now_serving, memory_order_relaxed);
+	atomic_store_explicit(&self->now_serving, serving + 1, memory_order_release);
+}
+
+/**
+ * @param self the concurrent priority queue
+ * @param value the value we want to add
+ * @returns 0 on success. -1 when the priority queue is full
+ **/
+int
+priority_queue_concurrent_enqueue(struct priority_queue_concurrent *const self, void *value)
+{
+	priority_queue_concurrent_lock(self);
+	int rc = priority_queue_enqueue(&self->queue, value);
+	priority_queue_concurrent_unlock(self);
+	return rc;
+}
+
+/**
+ * Like priority_queue_concurrent_enqueue, but fails instead of waiting
+ * @param self the concurrent priority queue
+ * @param value the value we want to add
+ * @returns 0 on success. -1 when the priority queue is full. PRIORITY_QUEUE_BUSY
+ * when another thread holds the lock
+ **/
+int
+priority_queue_concurrent_try_enqueue(struct priority_queue_concurrent *const self, void *value)
+{
+	if (!priority_queue_concurrent_try_lock(self)) return PRIORITY_QUEUE_BUSY;
+	int rc = priority_queue_enqueue(&self->queue, value);
+	priority_queue_concurrent_unlock(self);
+	return rc;
+}
+
+/**
+ * @param self the concurrent priority queue
+ * @param values the values we want to add
+ * @param n the number of values
+ * @returns the number of values accepted; see priority_queue_enqueue_batch
+ **/
+size_t
+priority_queue_concurrent_enqueue_batch(struct priority_queue_concurrent *const self, void **values, size_t n)
+{
+	priority_queue_concurrent_lock(self);
+	size_t accepted = priority_queue_enqueue_batch(&self->queue, values, n);
+	priority_queue_concurrent_unlock(self);
+	return accepted;
+}
+
+/**
+ * @param self the concurrent priority queue
+ * @returns The head of the priority queue or NULL when empty
+ **/
+void *
+priority_queue_concurrent_dequeue(struct priority_queue_concurrent *const self)
+{
+	priority_queue_concurrent_lock(self);
+	void *value = priority_queue_dequeue(&self->queue);
+	priority_queue_concurrent_unlock(self);
+	return value;
+}
+
+/**
+ * Like priority_queue_concurrent_dequeue, but fails instead of waiting
+ * @param self the concurrent priority queue
+ * @param out receives the head of the priority queue on success
+ * @returns 0 on success. -1 when the priority queue is empty. PRIORITY_QUEUE_BUSY
+ * when another thread holds the lock
+ **/
+int
+priority_queue_concurrent_try_dequeue(struct priority_queue_concurrent *const self, void **out)
+{
+	assert(out != NULL);
+
+	if (!priority_queue_concurrent_try_lock(self)) return PRIORITY_QUEUE_BUSY;
+	*out = priority_queue_dequeue(&self->queue);
+	priority_queue_concurrent_unlock(self);
+	return *out == NULL ? -1 : 0;
+}
+
+/**
+ * @param self the concurrent priority queue
+ * @param key_limit the largest key to remove
+ * @param out buffer receiving the removed elements in ascending key order
+ * @param max_out capacity of out
+ * @returns the number of elements written to out; see priority_queue_dequeue_until
+ **/
+size_t
+priority_queue_concurrent_dequeue_until(struct priority_queue_concurrent *const self, uint64_t key_limit, void **out,
+                                        size_t max_out)
+{
+	// Nothing is due as of the last publish, so don't contend for the lock
+	if (priority_queue_concurrent_peek_key(self) > key_limit) return 0;
+	priority_queue_concurrent_lock(self);
+	size_t count = priority_queue_dequeue_until(&self->queue, key_limit, out, max_out);
+	priority_queue_concurrent_unlock(self);
+	return count;
+}
+
+/**
+ * Copies the k earliest elements to out in key order under the lock, without
+ * removing them; see priority_queue_peek_k
+ * @param self the concurrent priority queue
+ * @param out buffer receiving the elements
+ * @param k capacity of out
+ * @returns the number of elements written to out
+ **/
+size_t
+priority_queue_concurrent_peek_k(struct priority_queue_concurrent *const self, void **out, size_t k)
+{
+	priority_queue_concurrent_lock(self);
+	size_t count = priority_queue_peek_k(&self->queue, out, k);
+	priority_queue_concurrent_unlock(self);
+	return count;
+}
+
+/**
+ * @param self the concurrent priority queue
+ * @returns the number of elements in the priority queue
+ **/
+size_t
+priority_queue_concurrent_length(struct priority_queue_concurrent *const self)
+{
+	priority_queue_concurrent_lock(self);
+	size_t length = priority_queue_length(&self->queue);
+	priority_queue_concurrent_unlock(self);
+	return length;
+}
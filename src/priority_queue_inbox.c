@@ -0,0 +1,222 @@
+#include "priority_queue_inbox.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * @param self the inbox
+ * @param item an element
+ * @returns a pointer to the element's link field
+ */
+static inline void **
+priority_queue_inbox_link(const struct priority_queue_inbox *const self, void *item)
+{
+	return (void **)((char *)item + self->link_offset);
+}
+
+/**
+ * Publishes an already linked chain of elements with one compare-and-swap
+ * @param self the inbox
+ * @param first the chain's first element
+ * @param last the chain's last element, whose link is overwritten
+ */
+static inline void
+priority_queue_inbox_push_chain(struct priority_queue_inbox *const self, void *first, void *last)
+{
+	void **last_link = priority_queue_inbox_link(self, last);
+	void  *head      = atomic_load_explicit(&self->head, memory_order_relaxed);
+	do {
+		*last_link = head;
+	} while (!atomic_compare_exchange_weak_explicit(&self->head, &head, first, memory_order_release,
+	                                                memory_order_relaxed));
+}
+
+/**
+ * Resets the inbox's own fields
+ * @param self the inbox
+ * @param link_offset offsetof() the element's void * link field
+ */
+static inline void
+priority_queue_inbox_initialize_links(struct priority_queue_inbox *const self, size_t link_offset)
+{
+	atomic_init(&self->head, NULL);
+	self->link_offset = link_offset;
+	self->pending     = NULL;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+/**
+ * Initializes an inbox whose heap uses embedded storage
+ * @param self the inbox to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param link_offset offsetof() a void * field in the element that the inbox links through
+ **/
+void
+priority_queue_inbox_initialize(struct priority_queue_inbox *const self, priority_queue_get_key_t get_key,
+                                size_t link_offset)
+{
+	assert(self != NULL);
+
+	priority_queue_initialize(&self->queue, get_key);
+	priority_queue_inbox_initialize_links(self, link_offset);
+}
+#endif
+
+/**
+ * Initializes an inbox whose heap uses allocator storage
+ * @param self the inbox to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param link_offset offsetof() a void * field in the element that the inbox links through
+ * @param config see priority_queue_initialize_dynamic
+ * @returns 0 on success. -1 when allocation fails
+ **/
+int
+priority_queue_inbox_initialize_dynamic(struct priority_queue_inbox *const self, priority_queue_get_key_t get_key,
+                                        size_t link_offset, const struct priority_queue_config *config)
+{
+	assert(self != NULL);
+
+	if (priority_queue_initialize_dynamic(&self->queue, get_key, config) != 0) return -1;
+	priority_queue_inbox_initialize_links(self, link_offset);
+	return 0;
+}
+
+/**
+ * Releases the heap's storage. Elements still in the inbox are not touched, and
+ * no thread may push afterwards.
+ * @param self the inbox to destroy
+ **/
+void
+priority_queue_inbox_destroy(struct priority_queue_inbox *const self)
+{
+	assert(self != NULL);
+
+	priority_queue_destroy(&self->queue);
+	atomic_store_explicit(&self->head, NULL, memory_order_relaxed);
+	self->pending = NULL;
+}
+
+/**
+ * Hands an element to the consumer. Safe to call from any number of threads at once.
+ * @param self the inbox
+ * @param value the value we want to add
+ **/
+void
+priority_queue_inbox_push(struct priority_queue_inbox *const self, void *value)
+{
+	assert(self != NULL);
+	assert(value != NULL);
+
+	priority_queue_inbox_push_chain(self, value, value);
+}
+
+/**
+ * Hands several elements to the consumer with a single compare-and-swap
+ * @param self the inbox
+ * @param values the values we want to add
+ * @param n the number of values
+ **/
+void
+priority_queue_inbox_push_batch(struct priority_queue_inbox *const self, void **values, size_t n)
+{
+	assert(self != NULL);
+	assert(n == 0 || values != NULL);
+
+	if (n == 0) return;
+	for (size_t i = 0; i + 1 < n; i++) *priority_queue_inbox_link(self, values[i]) = values[i + 1];
+	priority_queue_inbox_push_chain(self, values[0], values[n - 1]);
+}
+
+/**
+ * Moves everything producers have pushed, and anything left pending by an
+ * earlier drain, into the heap. Whatever does not fit stays pending.
+ * priority_queue_inbox_dequeue and _peek call this first.
+ * @param self the inbox
+ * @returns the number of elements moved into the heap
+ **/
+size_t
+priority_queue_inbox_drain(struct priority_queue_inbox *const self)
+{
+	assert(self != NULL);
+
+	void *chain = self->pending;
+	if (atomic_load_explicit(&self->head, memory_order_relaxed) != NULL) {
+		void *pushed = atomic_exchange_explicit(&self->head, NULL, memory_order_acquire);
+		// Splice the pending list, usually empty, onto the end of the freshly pushed one
+		if (chain != NULL) {
+			void *last = pushed;
+			while (*priority_queue_inbox_link(self, last) != NULL) last = *priority_queue_inbox_link(self, last);
+			*priority_queue_inbox_link(self, last) = chain;
+		}
+		chain = pushed;
+	}
+
+	size_t moved = 0;
+	void  *batch[PRIORITY_QUEUE_INBOX_DRAIN_CHUNK];
+	while (chain != NULL) {
+		size_t count = 0;
+		for (; chain != NULL && count < PRIORITY_QUEUE_INBOX_DRAIN_CHUNK; count++) {
+			batch[count] = chain;
+			chain        = *priority_queue_inbox_link(self, chain);
+		}
+
+		size_t accepted = priority_queue_enqueue_batch(&self->queue, batch, count);
+		moved += accepted;
+		if (accepted < count) {
+			// The heap is full: relink the rejected elements in front of the rest
+			for (size_t i = count; i > accepted; i--) {
+				*priority_queue_inbox_link(self, batch[i - 1]) = chain;
+				chain                                          = batch[i - 1];
+			}
+			break;
+		}
+	}
+
+	self->pending = chain;
+	return moved;
+}
+
+/**
+ * Drains the inbox, then removes the minimum-key element
+ * @param self the inbox
+ * @returns The head of the priority queue or NULL when empty
+ **/
+void *
+priority_queue_inbox_dequeue(struct priority_queue_inbox *const self)
+{
+	(void)priority_queue_inbox_drain(self);
+	return priority_queue_dequeue(&self->queue);
+}
+
+/**
+ * Drains the inbox, then returns the minimum-key element without removing it
+ * @param self the inbox
+ * @returns The head of the priority queue or NULL when empty
+ **/
+void *
+priority_queue_inbox_peek(struct priority_queue_inbox *const self)
+{
+	(void)priority_queue_inbox_drain(self);
+	return priority_queue_peek(&self->queue);
+}
+
+/**
+ * @param self the inbox
+ * @returns true if the heap, the pending list and the inbox are all empty
+ **/
+bool
+priority_queue_inbox_is_empty(struct priority_queue_inbox *const self)
+{
+	assert(self != NULL);
+
+	return priority_queue_is_empty(&self->queue) && self->pending == NULL
+	       && atomic_load_explicit(&self->head, memory_order_relaxed) == NULL;
+}
@@ -0,0 +1,390 @@
+#include "priority_queue_mapped.h"
+#include "priority_queue_layout.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * FNV-1a over the header's 64-bit words, excluding the checksum itself
+ * @param header the mapped header
+ * @param generation the generation to checksum in place of header->generation
+ * @returns the checksum
+ */
+static inline uint64_t
+priority_queue_mapped_checksum(const struct priority_queue_mapped_header *header, uint64_t generation)
+{
+	uint64_t words[] = { header->magic,
+		             (uint64_t)header->version << 32 | header->arity,
+		             header->region_size,
+		             header->element_size,
+		             header->capacity,
+		             header->first_free,
+		             header->min_key,
+		             generation };
+	uint64_t hash    = UINT64_C(0xcbf29ce484222325);
+	for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		hash ^= words[i];
+		hash *= UINT64_C(0x100000001b3);
+	}
+	return hash;
+}
+
+/**
+ * Marks the region as being modified. An attach that finds the generation odd
+ * knows the writer stopped before priority_queue_mapped_end_write.
+ * @param self the mapped queue
+ */
+static inline void
+priority_queue_mapped_begin_write(struct priority_queue_mapped *const self)
+{
+	self->header->generation++;
+	atomic_signal_fence(memory_order_seq_cst);
+}
+
+/**
+ * Publishes a finished operation: the checksum for the next, even generation
+ * is written before the generation itself, so there is no point at which the
+ * header looks consistent but is not.
+ * @param self the mapped queue
+ */
+static inline void
+priority_queue_mapped_end_write(struct priority_queue_mapped *const self)
+{
+	struct priority_queue_mapped_header *header     = self->header;
+	uint64_t                             generation = header->generation + 1;
+
+	header->min_key  = header->first_free > PRIORITY_QUEUE_ROOT ? self->keys[PRIORITY_QUEUE_ROOT] : UINT64_MAX;
+	header->checksum = priority_queue_mapped_checksum(header, generation);
+	atomic_signal_fence(memory_order_seq_cst);
+	header->generation = generation;
+}
+
+/**
+ * keys[] starts on the first cache line after the header, so sibling groups are
+ * cache-line aligned whenever the region is, as in struct priority_queue
+ * @returns the offset of keys[] from the start of the region
+ */
+static inline size_t
+priority_queue_mapped_keys_start(void)
+{
+	size_t header_size = sizeof(struct priority_queue_mapped_header);
+	return (header_size + PRIORITY_QUEUE_CACHE_LINE - 1) / PRIORITY_QUEUE_CACHE_LINE * PRIORITY_QUEUE_CACHE_LINE;
+}
+
+/**
+ * Points the process-local struct at a region whose header is already set
+ * @param self the mapped queue
+ * @param base start of the region
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ */
+static inline void
+priority_queue_mapped_bind(struct priority_queue_mapped *const self, void *base, priority_queue_get_key_t get_key)
+{
+	self->base          = base;
+	self->header        = base;
+	self->keys          = (uint64_t *)(self->base + priority_queue_mapped_keys_start());
+	self->offsets       = self->keys + self->header->capacity + PRIORITY_QUEUE_ROOT;
+	self->element_start = priority_queue_mapped_size((size_t)self->header->capacity);
+	self->get_key       = get_key;
+}
+
+/**
+ * Shifts the slot at index up to its place, moving larger parents down into the hole
+ * @param self the mapped queue
+ * @param index the slot holding the value to shift
+ */
+static inline void
+priority_queue_mapped_percolate_up(struct priority_queue_mapped *const self, size_t index)
+{
+	size_t   i      = index;
+	uint64_t key    = self->keys[i];
+	uint64_t offset = self->offsets[i];
+	while (i != PRIORITY_QUEUE_ROOT) {
+		size_t parent_index = priority_queue_parent_index(i);
+		if (key >= self->keys[parent_index]) break;
+		self->keys[i]    = self->keys[parent_index];
+		self->offsets[i] = self->offsets[parent_index];
+		i                = parent_index;
+	}
+	self->keys[i]    = key;
+	self->offsets[i] = offset;
+}
+
+/**
+ * Shifts the slot at index down until it is no larger than its children
+ * @param self the mapped queue
+ * @param index the slot holding the value to shift
+ */
+static inline void
+priority_queue_mapped_percolate_down(struct priority_queue_mapped *const self, size_t index)
+{
+	size_t   first_free   = (size_t)self->header->first_free;
+	size_t   parent_index = index;
+	uint64_t key          = self->keys[parent_index];
+	uint64_t offset       = self->offsets[parent_index];
+	while (priority_queue_first_child_index(parent_index) < first_free) {
+		size_t smallest_child_index = priority_queue_smallest_child_index(self->keys, parent_index,
+		                                                                  first_free);
+		if (key <= self->keys[smallest_child_index]) break;
+		self->keys[parent_index]    = self->keys[smallest_child_index];
+		self->offsets[parent_index] = self->offsets[smallest_child_index];
+		parent_index                = smallest_child_index;
+	}
+	self->keys[parent_index]    = key;
+	self->offsets[parent_index] = offset;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * @param capacity maximum number of elements
+ * @returns the bytes the header and slots take at the start of a region, which
+ * is also where the element area begins. SIZE_MAX if capacity is too large
+ **/
+size_t
+priority_queue_mapped_size(size_t capacity)
+{
+	size_t header_size = priority_queue_mapped_keys_start();
+	if (capacity > SIZE_MAX / PRIORITY_QUEUE_CHILD_FACTOR - PRIORITY_QUEUE_ROOT) return SIZE_MAX;
+	size_t slots = capacity + PRIORITY_QUEUE_ROOT;
+	if (slots > (SIZE_MAX - header_size - PRIORITY_QUEUE_CACHE_LINE) / (2 * sizeof(uint64_t))) return SIZE_MAX;
+
+	size_t size = header_size + slots * 2 * sizeof(uint64_t);
+	return (size + PRIORITY_QUEUE_CACHE_LINE - 1) / PRIORITY_QUEUE_CACHE_LINE * PRIORITY_QUEUE_CACHE_LINE;
+}
+
+/**
+ * Formats a region as an empty queue, discarding anything it held
+ * @param self the process-local handle to initialize
+ * @param base start of the region, aligned to at least 8 bytes (mmap returns page-aligned memory)
+ * @param region_size bytes in the region, including the element area
+ * @param capacity maximum number of elements
+ * @param element_size bytes per element, e.g. sizeof the element type
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @returns 0 on success. -1 if capacity or element_size is 0 or the region is
+ * misaligned or too small to hold the queue and at least one element
+ **/
+int
+priority_queue_mapped_create(struct priority_queue_mapped *const self, void *base, size_t region_size,
+                             size_t capacity, size_t element_size, priority_queue_get_key_t get_key)
+{
+	assert(self != NULL);
+	assert(get_key != NULL);
+
+	if (base == NULL || (uintptr_t)base % _Alignof(uint64_t) != 0) return -1;
+	if (capacity == 0 || priority_queue_mapped_size(capacity) > region_size) return -1;
+	if (element_size == 0 || element_size > region_size - priority_queue_mapped_size(capacity)) return -1;
+
+	struct priority_queue_mapped_header *header = base;
+	*header = (struct priority_queue_mapped_header){ .magic        = PRIORITY_QUEUE_MAPPED_MAGIC,
+		                                         .version      = PRIORITY_QUEUE_MAPPED_VERSION,
+		                                         .arity        = PRIORITY_QUEUE_MAPPED_SHAPE,
+		                                         .region_size  = region_size,
+		                                         .element_size = element_size,
+		                                         .capacity     = capacity,
+		                                         .first_free   = PRIORITY_QUEUE_ROOT,
+		                                         .min_key      = UINT64_MAX };
+	priority_queue_mapped_bind(self, base, get_key);
+	priority_queue_mapped_begin_write(self);
+	priority_queue_mapped_end_write(self);
+	return 0;
+}
+
+/**
+ * Resumes a queue left in a region by priority_queue_mapped_create and later
+ * operations, in this or another process, in O(1). Only the header is checked;
+ * call priority_queue_mapped_verify to also walk the slots.
+ * @param self the process-local handle to initialize
+ * @param base start of the region, which may be mapped at a different address than before
+ * @param region_size bytes mapped, at least the size the region was created with
+ * @param element_size bytes per element, which must match the size the region was created with
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @returns 0 on success. -1 if the mapping is misaligned or smaller than the
+ * header. PRIORITY_QUEUE_MAPPED_BAD_MAGIC, _INCOMPATIBLE, _TORN or _CORRUPT if
+ * the region must not be trusted
+ **/
+int
+priority_queue_mapped_attach(struct priority_queue_mapped *const self, void *base, size_t region_size,
+                             size_t element_size, priority_queue_get_key_t get_key)
+{
+	assert(self != NULL);
+	assert(get_key != NULL);
+
+	if (base == NULL || (uintptr_t)base % _Alignof(uint64_t) != 0) return -1;
+	if (region_size < sizeof(struct priority_queue_mapped_header)) return -1;
+
+	const struct priority_queue_mapped_header *header = base;
+	if (header->magic != PRIORITY_QUEUE_MAPPED_MAGIC) return PRIORITY_QUEUE_MAPPED_BAD_MAGIC;
+	if (header->version != PRIORITY_QUEUE_MAPPED_VERSION || header->arity != PRIORITY_QUEUE_MAPPED_SHAPE) {
+		return PRIORITY_QUEUE_MAPPED_INCOMPATIBLE;
+	}
+	if (header->element_size != element_size) return PRIORITY_QUEUE_MAPPED_INCOMPATIBLE;
+	if (header->generation % 2 != 0) return PRIORITY_QUEUE_MAPPED_TORN;
+	if (header->checksum != priority_queue_mapped_checksum(header, header->generation)) {
+		return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	}
+
+	// The checksum only proves the header was written by this code; these bounds keep a
+	// header that was valid for a larger mapping from sending slot accesses past this one
+	if (header->region_size > region_size || (uint64_t)(size_t)header->capacity != header->capacity) {
+		return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	}
+	size_t element_start = priority_queue_mapped_size((size_t)header->capacity);
+	if (element_start > header->region_size) return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	if (element_size == 0 || element_size > header->region_size - element_start) {
+		return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	}
+	if (header->first_free < PRIORITY_QUEUE_ROOT || header->first_free > header->capacity + PRIORITY_QUEUE_ROOT) {
+		return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	}
+
+	priority_queue_mapped_bind(self, base, get_key);
+	uint64_t root_key = header->first_free > PRIORITY_QUEUE_ROOT ? self->keys[PRIORITY_QUEUE_ROOT] : UINT64_MAX;
+	if (header->min_key != root_key) return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	return 0;
+}
+
+/**
+ * Checks every slot in O(n): elements lie wholly in the element area, cached
+ * keys are in heap order and still match get_key of their element
+ * @param self the mapped queue
+ * @returns 0 if the slots are sound, PRIORITY_QUEUE_MAPPED_CORRUPT otherwise
+ **/
+int
+priority_queue_mapped_verify(const struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	// create and attach guarantee that the element area holds at least one element
+	size_t first_free = (size_t)self->header->first_free;
+	size_t last_start = (size_t)(self->header->region_size - self->header->element_size);
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < first_free; i++) {
+		if (self->offsets[i] < self->element_start || self->offsets[i] > last_start) {
+			return PRIORITY_QUEUE_MAPPED_CORRUPT;
+		}
+		if (i > PRIORITY_QUEUE_ROOT && self->keys[i] < self->keys[priority_queue_parent_index(i)]) {
+			return PRIORITY_QUEUE_MAPPED_CORRUPT;
+		}
+		if (self->get_key(self->base + self->offsets[i]) != self->keys[i]) return PRIORITY_QUEUE_MAPPED_CORRUPT;
+	}
+	return 0;
+}
+
+/**
+ * Empties the queue. The element area is left as it is.
+ * @param self the mapped queue
+ **/
+void
+priority_queue_mapped_clear(struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	priority_queue_mapped_begin_write(self);
+	self->header->first_free = PRIORITY_QUEUE_ROOT;
+	priority_queue_mapped_end_write(self);
+}
+
+/**
+ * @param self the mapped queue
+ * @param value element in the region's element area
+ * @returns 0 on success. -1 when full. PRIORITY_QUEUE_MAPPED_OUTSIDE if any
+ * byte of value lies outside the element area
+ **/
+int
+priority_queue_mapped_enqueue(struct priority_queue_mapped *const self, void *value)
+{
+	assert(self != NULL);
+
+	// The whole element must fit between the start of the element area and the end of the region
+	uintptr_t address    = (uintptr_t)value;
+	uintptr_t base       = (uintptr_t)self->base;
+	uint64_t  last_start = self->header->region_size - self->header->element_size;
+	if (address < base + self->element_start || address - base > last_start) {
+		return PRIORITY_QUEUE_MAPPED_OUTSIDE;
+	}
+	if (priority_queue_mapped_is_full(self)) return -1;
+
+	priority_queue_mapped_begin_write(self);
+	size_t index         = (size_t)self->header->first_free++;
+	self->keys[index]    = self->get_key(value);
+	self->offsets[index] = address - base;
+	priority_queue_mapped_percolate_up(self, index);
+	priority_queue_mapped_end_write(self);
+	return 0;
+}
+
+/**
+ * @param self the mapped queue
+ * @returns the element with the smallest key, or NULL if empty
+ **/
+void *
+priority_queue_mapped_dequeue(struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	if (priority_queue_mapped_is_empty(self)) return NULL;
+
+	void *min = self->base + self->offsets[PRIORITY_QUEUE_ROOT];
+	priority_queue_mapped_begin_write(self);
+	size_t last                        = (size_t)--self->header->first_free;
+	self->keys[PRIORITY_QUEUE_ROOT]    = self->keys[last];
+	self->offsets[PRIORITY_QUEUE_ROOT] = self->offsets[last];
+	if (last > PRIORITY_QUEUE_ROOT + 1) priority_queue_mapped_percolate_down(self, PRIORITY_QUEUE_ROOT);
+	priority_queue_mapped_end_write(self);
+	return min;
+}
+
+/**
+ * @param self the mapped queue
+ * @returns the element with the smallest key without removing it, or NULL if empty
+ **/
+void *
+priority_queue_mapped_peek(const struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	if (priority_queue_mapped_is_empty(self)) return NULL;
+	return self->base + self->offsets[PRIORITY_QUEUE_ROOT];
+}
+
+/**
+ * @param self the mapped queue
+ * @returns the number of queued elements
+ **/
+size_t
+priority_queue_mapped_length(const struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	return (size_t)self->header->first_free - PRIORITY_QUEUE_ROOT;
+}
+
+/**
+ * @param self the mapped queue
+ * @returns true if no elements are queued
+ **/
+bool
+priority_queue_mapped_is_empty(const struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	return self->header->first_free == PRIORITY_QUEUE_ROOT;
+}
+
+/**
+ * @param self the mapped queue
+ * @returns true if the queue holds capacity elements
+ **/
+bool
+priority_queue_mapped_is_full(const struct priority_queue_mapped *const self)
+{
+	assert(self != NULL);
+
+	return self->header->first_free == self->header->capacity + PRIORITY_QUEUE_ROOT;
+}
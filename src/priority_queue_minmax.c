@@ -0,0 +1,381 @@
+#include "priority_queue_minmax.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Index of the root, as in the 1-indexed binary heap */
+#define PRIORITY_QUEUE_MINMAX_ROOT 1
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * @param index a slot at or below the root
+ * @returns true if the slot is on an odd, max-ordered level
+ */
+static inline bool
+priority_queue_minmax_is_max_level(size_t index)
+{
+	assert(index >= PRIORITY_QUEUE_MINMAX_ROOT);
+
+	return ((sizeof(unsigned long long) * 8 - 1 - (size_t)__builtin_clzll(index)) & 1) != 0;
+}
+
+/**
+ * @param max_level whether the comparison is made on a max level
+ * @param a a key
+ * @param b a key
+ * @returns true if a belongs above b on such a level: larger on max levels, smaller on min levels
+ */
+static inline bool
+priority_queue_minmax_precedes(bool max_level, uint64_t a, uint64_t b)
+{
+	return max_level ? a > b : a < b;
+}
+
+/**
+ * @param self the min-max queue
+ * @param a a slot
+ * @param b a slot
+ */
+static inline void
+priority_queue_minmax_swap(struct priority_queue_minmax *const self, size_t a, size_t b)
+{
+	uint64_t key   = self->keys[a];
+	void    *item  = self->items[a];
+	self->keys[a]  = self->keys[b];
+	self->items[a] = self->items[b];
+	self->keys[b]  = key;
+	self->items[b] = item;
+}
+
+/**
+ * @param self a non-empty min-max queue
+ * @returns the slot holding the largest key: the root if it is alone, else the larger of its children
+ */
+static inline size_t
+priority_queue_minmax_max_index(const struct priority_queue_minmax *const self)
+{
+	assert(self->first_free > PRIORITY_QUEUE_MINMAX_ROOT);
+
+	if (self->first_free <= 2) return PRIORITY_QUEUE_MINMAX_ROOT;
+	if (self->first_free == 3 || self->keys[2] >= self->keys[3]) return 2;
+	return 3;
+}
+
+/**
+ * Refreshes min_key and max_key after the heap changed
+ * @param self the min-max queue
+ */
+static inline void
+priority_queue_minmax_update_keys(struct priority_queue_minmax *const self)
+{
+	if (self->first_free == PRIORITY_QUEUE_MINMAX_ROOT) {
+		self->min_key = UINT64_MAX;
+		self->max_key = 0;
+		return;
+	}
+	self->min_key = self->keys[PRIORITY_QUEUE_MINMAX_ROOT];
+	self->max_key = self->keys[priority_queue_minmax_max_index(self)];
+}
+
+/**
+ * Moves the element at index up through its grandparents, which share its
+ * level's ordering
+ * @param self the min-max queue
+ * @param index the slot to shift
+ * @param max_level whether index is on a max level
+ */
+static inline void
+priority_queue_minmax_percolate_up_levels(struct priority_queue_minmax *const self, size_t index, bool max_level)
+{
+	while (index >= 4 && priority_queue_minmax_precedes(max_level, self->keys[index], self->keys[index / 4])) {
+		priority_queue_minmax_swap(self, index, index / 4);
+		index /= 4;
+	}
+}
+
+/**
+ * Restores the min-max property for a new element in the last slot. An
+ * element that belongs on the other kind of level first swaps with its parent.
+ * @param self the min-max queue
+ * @param index the slot to shift
+ */
+static inline void
+priority_queue_minmax_percolate_up(struct priority_queue_minmax *const self, size_t index)
+{
+	if (index == PRIORITY_QUEUE_MINMAX_ROOT) return;
+
+	bool   max_level = priority_queue_minmax_is_max_level(index);
+	size_t parent    = index / 2;
+	if (priority_queue_minmax_precedes(!max_level, self->keys[index], self->keys[parent])) {
+		priority_queue_minmax_swap(self, index, parent);
+		priority_queue_minmax_percolate_up_levels(self, parent, !max_level);
+	} else {
+		priority_queue_minmax_percolate_up_levels(self, index, max_level);
+	}
+}
+
+/**
+ * Moves the element at index down to its place. It is compared with the most
+ * extreme of its children and grandchildren for its level; after dropping
+ * two levels it may have to trade places with its new parent, which is on a
+ * level of the other kind.
+ * @param self the min-max queue
+ * @param index the slot to shift
+ */
+static inline void
+priority_queue_minmax_percolate_down(struct priority_queue_minmax *const self, size_t index)
+{
+	bool max_level = priority_queue_minmax_is_max_level(index);
+	while (2 * index < self->first_free) {
+		size_t first_child = 2 * index;
+		size_t extreme     = first_child;
+		if (first_child + 1 < self->first_free
+		    && priority_queue_minmax_precedes(max_level, self->keys[first_child + 1], self->keys[extreme])) {
+			extreme = first_child + 1;
+		}
+		for (size_t i = 4 * index; i < 4 * index + 4 && i < self->first_free; i++) {
+			if (priority_queue_minmax_precedes(max_level, self->keys[i], self->keys[extreme])) extreme = i;
+		}
+		if (!priority_queue_minmax_precedes(max_level, self->keys[extreme], self->keys[index])) return;
+
+		priority_queue_minmax_swap(self, index, extreme);
+		if (extreme < 4 * index) return;
+		if (priority_queue_minmax_precedes(max_level, self->keys[extreme / 2], self->keys[extreme])) {
+			priority_queue_minmax_swap(self, extreme, extreme / 2);
+		}
+		index = extreme;
+	}
+}
+
+/**
+ * Removes the element at index, which must be the root or the maximum, and
+ * fills the hole with the last element
+ * @param self a non-empty min-max queue
+ * @param index the slot to empty
+ * @returns the removed element
+ */
+static inline void *
+priority_queue_minmax_take(struct priority_queue_minmax *const self, size_t index)
+{
+	void  *item = self->items[index];
+	size_t last = --self->first_free;
+	if (index != last) {
+		self->keys[index]  = self->keys[last];
+		self->items[index] = self->items[last];
+		// The last element is no smaller than the root, so it only moves down
+		priority_queue_minmax_percolate_down(self, index);
+	}
+	priority_queue_minmax_update_keys(self);
+	return item;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * @param self the min-max queue to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param capacity maximum number of elements
+ * @returns 0 on success. -1 if capacity is 0 or too large, or allocation fails
+ **/
+int
+priority_queue_minmax_initialize(struct priority_queue_minmax *const self, priority_queue_get_key_t get_key,
+                                 size_t capacity)
+{
+	assert(self != NULL);
+	assert(get_key != NULL);
+
+	// Grandchildren of the last slot are at most 4 * (capacity + 1) + 3
+	if (capacity == 0 || capacity > SIZE_MAX / 4 / sizeof(uint64_t) - PRIORITY_QUEUE_MINMAX_ROOT) return -1;
+
+	size_t slots = capacity + PRIORITY_QUEUE_MINMAX_ROOT;
+	self->keys   = malloc(slots * sizeof(uint64_t));
+	self->items  = malloc(slots * sizeof(void *));
+	if (self->keys == NULL || self->items == NULL) {
+		free(self->keys);
+		free(self->items);
+		return -1;
+	}
+	self->capacity   = capacity;
+	self->get_key    = get_key;
+	self->first_free = PRIORITY_QUEUE_MINMAX_ROOT;
+	priority_queue_minmax_update_keys(self);
+	return 0;
+}
+
+/**
+ * Releases the queue's storage. It must be initialized again before reuse.
+ * @param self the min-max queue to destroy
+ **/
+void
+priority_queue_minmax_destroy(struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	free(self->keys);
+	free(self->items);
+	self->keys       = NULL;
+	self->items      = NULL;
+	self->capacity   = 0;
+	self->first_free = PRIORITY_QUEUE_MINMAX_ROOT;
+	priority_queue_minmax_update_keys(self);
+}
+
+/**
+ * Removes all elements, keeping the storage and get_key callback
+ * @param self the min-max queue to clear
+ **/
+void
+priority_queue_minmax_clear(struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	self->first_free = PRIORITY_QUEUE_MINMAX_ROOT;
+	priority_queue_minmax_update_keys(self);
+}
+
+/**
+ * @param self the min-max queue
+ * @param value the element to add
+ * @returns 0 on success. -1 when full
+ **/
+int
+priority_queue_minmax_enqueue(struct priority_queue_minmax *const self, void *value)
+{
+	assert(self != NULL);
+
+	if (priority_queue_minmax_is_full(self)) return -1;
+
+	size_t index       = self->first_free++;
+	self->keys[index]  = self->get_key(value);
+	self->items[index] = value;
+	priority_queue_minmax_percolate_up(self, index);
+	priority_queue_minmax_update_keys(self);
+	return 0;
+}
+
+/**
+ * Adds an element, shedding the element with the latest key if the queue is
+ * full. A full queue keeps the capacity elements with the earliest keys; on a
+ * tie with the current maximum the queued element stays and value is shed.
+ * @param self the min-max queue
+ * @param value the element to add
+ * @returns NULL if value was queued and nothing was shed. Otherwise the shed
+ * element: the former maximum, which value replaced, or value itself when its
+ * key is no earlier than the maximum
+ **/
+void *
+priority_queue_minmax_enqueue_or_evict(struct priority_queue_minmax *const self, void *value)
+{
+	assert(self != NULL);
+
+	if (priority_queue_minmax_enqueue(self, value) == 0) return NULL;
+
+	uint64_t key = self->get_key(value);
+	if (key >= self->max_key) return value;
+
+	// Overwrite the maximum in place. Everything is at least the root, so only
+	// a new overall minimum has to swap with it; the slot's value then moves down.
+	size_t index   = priority_queue_minmax_max_index(self);
+	void  *evicted = self->items[index];
+	self->keys[index]  = key;
+	self->items[index] = value;
+	if (index != PRIORITY_QUEUE_MINMAX_ROOT && key < self->keys[PRIORITY_QUEUE_MINMAX_ROOT]) {
+		priority_queue_minmax_swap(self, index, PRIORITY_QUEUE_MINMAX_ROOT);
+	}
+	priority_queue_minmax_percolate_down(self, index);
+	priority_queue_minmax_update_keys(self);
+	return evicted;
+}
+
+/**
+ * @param self the min-max queue
+ * @returns the element with the smallest key, or NULL if empty
+ **/
+void *
+priority_queue_minmax_dequeue(struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	if (priority_queue_minmax_is_empty(self)) return NULL;
+	return priority_queue_minmax_take(self, PRIORITY_QUEUE_MINMAX_ROOT);
+}
+
+/**
+ * @param self the min-max queue
+ * @returns the element with the largest key, or NULL if empty
+ **/
+void *
+priority_queue_minmax_dequeue_max(struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	if (priority_queue_minmax_is_empty(self)) return NULL;
+	return priority_queue_minmax_take(self, priority_queue_minmax_max_index(self));
+}
+
+/**
+ * @param self the min-max queue
+ * @returns the element with the smallest key without removing it, or NULL if empty
+ **/
+void *
+priority_queue_minmax_peek(const struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	if (priority_queue_minmax_is_empty(self)) return NULL;
+	return self->items[PRIORITY_QUEUE_MINMAX_ROOT];
+}
+
+/**
+ * @param self the min-max queue
+ * @returns the element with the largest key without removing it, or NULL if empty
+ **/
+void *
+priority_queue_minmax_peek_max(const struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	if (priority_queue_minmax_is_empty(self)) return NULL;
+	return self->items[priority_queue_minmax_max_index(self)];
+}
+
+/**
+ * @param self the min-max queue
+ * @returns the number of queued elements
+ **/
+size_t
+priority_queue_minmax_length(const struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	return self->first_free - PRIORITY_QUEUE_MINMAX_ROOT;
+}
+
+/**
+ * @param self the min-max queue
+ * @returns true if no elements are queued
+ **/
+bool
+priority_queue_minmax_is_empty(const struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	return self->first_free == PRIORITY_QUEUE_MINMAX_ROOT;
+}
+
+/**
+ * @param self the min-max queue
+ * @returns true if the queue holds capacity elements
+ **/
+bool
+priority_queue_minmax_is_full(const struct priority_queue_minmax *const self)
+{
+	assert(self != NULL);
+
+	return self->first_free == self->capacity + PRIORITY_QUEUE_MINMAX_ROOT;
+}
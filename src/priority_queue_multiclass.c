@@ -0,0 +1,207 @@
+#include "priority_queue_multiclass.h"
+#include <assert.h>
+#include <stdint.h>
+
+/* Marks the end of the waiting list */
+#define PRIORITY_QUEUE_MULTICLASS_NONE PRIORITY_QUEUE_MULTICLASS_MAX
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * Appends a class to the waiting list as the most recently served
+ * @param self the multi-class queue
+ * @param class_index a class not on the list
+ */
+static inline void
+priority_queue_multiclass_link(struct priority_queue_multiclass *const self, size_t class_index)
+{
+	uint8_t c = (uint8_t)class_index;
+
+	self->waiting_since[c] = self->served;
+	self->prev[c]          = self->newest;
+	self->next[c]          = PRIORITY_QUEUE_MULTICLASS_NONE;
+	if (self->newest == PRIORITY_QUEUE_MULTICLASS_NONE) {
+		self->oldest = c;
+	} else {
+		self->next[self->newest] = c;
+	}
+	self->newest = c;
+}
+
+/**
+ * Takes a class off the waiting list
+ * @param self the multi-class queue
+ * @param class_index a class on the list
+ */
+static inline void
+priority_queue_multiclass_unlink(struct priority_queue_multiclass *const self, size_t class_index)
+{
+	uint8_t prev = self->prev[class_index];
+	uint8_t next = self->next[class_index];
+	if (prev == PRIORITY_QUEUE_MULTICLASS_NONE) {
+		self->oldest = next;
+	} else {
+		self->next[prev] = next;
+	}
+	if (next == PRIORITY_QUEUE_MULTICLASS_NONE) {
+		self->newest = prev;
+	} else {
+		self->prev[next] = prev;
+	}
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * @param self the multi-class queue to initialize
+ * @param classes class_count initialized queues, highest priority first. They may already hold elements.
+ * @param class_count number of classes, 1 to PRIORITY_QUEUE_MULTICLASS_MAX
+ * @param aging_limit dequeues a non-empty class may go unserved before it is
+ * served regardless of priority, or 0 for strict priority
+ **/
+void
+priority_queue_multiclass_initialize(struct priority_queue_multiclass *const self, struct priority_queue *classes,
+                                     size_t class_count, uint64_t aging_limit)
+{
+	assert(self != NULL);
+	assert(classes != NULL);
+	assert(class_count > 0 && class_count <= PRIORITY_QUEUE_MULTICLASS_MAX);
+
+	self->nonempty    = 0;
+	self->classes     = classes;
+	self->class_count = class_count;
+	self->aging_limit = aging_limit;
+	self->served      = 0;
+	self->oldest      = PRIORITY_QUEUE_MULTICLASS_NONE;
+	self->newest      = PRIORITY_QUEUE_MULTICLASS_NONE;
+	for (size_t i = 0; i < class_count; i++) priority_queue_multiclass_refresh(self, i);
+}
+
+/**
+ * @param self the multi-class queue
+ * @param class_index the class to add to
+ * @param value the element to add
+ * @returns 0 on success. -1 when the class's queue is full
+ **/
+int
+priority_queue_multiclass_enqueue(struct priority_queue_multiclass *const self, size_t class_index, void *value)
+{
+	assert(self != NULL);
+	assert(class_index < self->class_count);
+
+	if (priority_queue_enqueue(&self->classes[class_index], value) != 0) return -1;
+	if ((self->nonempty & (UINT64_C(1) << class_index)) == 0) {
+		self->nonempty |= UINT64_C(1) << class_index;
+		priority_queue_multiclass_link(self, class_index);
+	}
+	return 0;
+}
+
+/**
+ * Removes the earliest element of the class priority_queue_multiclass_next_class picks
+ * @param self the multi-class queue
+ * @returns the element, or NULL if every class is empty
+ **/
+void *
+priority_queue_multiclass_dequeue(struct priority_queue_multiclass *const self)
+{
+	assert(self != NULL);
+
+	size_t class_index = priority_queue_multiclass_next_class(self);
+	if (class_index == SIZE_MAX) return NULL;
+
+	void *value = priority_queue_dequeue(&self->classes[class_index]);
+	self->served++;
+	priority_queue_multiclass_unlink(self, class_index);
+	if (priority_queue_is_empty(&self->classes[class_index])) {
+		self->nonempty &= ~(UINT64_C(1) << class_index);
+	} else {
+		priority_queue_multiclass_link(self, class_index);
+	}
+	return value;
+}
+
+/**
+ * @param self the multi-class queue
+ * @returns the element priority_queue_multiclass_dequeue would return, or NULL if every class is empty
+ **/
+void *
+priority_queue_multiclass_peek(const struct priority_queue_multiclass *const self)
+{
+	assert(self != NULL);
+
+	size_t class_index = priority_queue_multiclass_next_class(self);
+	if (class_index == SIZE_MAX) return NULL;
+	return priority_queue_peek(&self->classes[class_index]);
+}
+
+/**
+ * Picks the class to serve in O(1): the longest-waiting class once it has
+ * waited aging_limit dequeues, else the non-empty class with the highest priority
+ * @param self the multi-class queue
+ * @returns the class index, or SIZE_MAX if every class is empty
+ **/
+size_t
+priority_queue_multiclass_next_class(const struct priority_queue_multiclass *const self)
+{
+	assert(self != NULL);
+
+	if (self->nonempty == 0) return SIZE_MAX;
+	if (self->aging_limit != 0 && self->served - self->waiting_since[self->oldest] >= self->aging_limit) {
+		return self->oldest;
+	}
+	return (size_t)__builtin_ctzll(self->nonempty);
+}
+
+/**
+ * @param self the multi-class queue
+ * @param class_index a class
+ * @returns the earliest key queued in that class, UINT64_MAX when it is empty
+ **/
+uint64_t
+priority_queue_multiclass_min_key(const struct priority_queue_multiclass *const self, size_t class_index)
+{
+	assert(self != NULL);
+	assert(class_index < self->class_count);
+
+	return self->classes[class_index].min_key;
+}
+
+/**
+ * Brings the bitmap up to date after a class's queue was changed directly. A
+ * class that just became non-empty starts waiting now.
+ * @param self the multi-class queue
+ * @param class_index the class that changed
+ **/
+void
+priority_queue_multiclass_refresh(struct priority_queue_multiclass *const self, size_t class_index)
+{
+	assert(self != NULL);
+	assert(class_index < self->class_count);
+
+	bool listed = (self->nonempty & (UINT64_C(1) << class_index)) != 0;
+	bool queued = !priority_queue_is_empty(&self->classes[class_index]);
+	if (queued && !listed) {
+		self->nonempty |= UINT64_C(1) << class_index;
+		priority_queue_multiclass_link(self, class_index);
+	} else if (!queued && listed) {
+		self->nonempty &= ~(UINT64_C(1) << class_index);
+		priority_queue_multiclass_unlink(self, class_index);
+	}
+}
+
+/**
+ * @param self the multi-class queue
+ * @returns true if every class is empty
+ **/
+bool
+priority_queue_multiclass_is_empty(const struct priority_queue_multiclass *const self)
+{
+	assert(self != NULL);
+
+	return self->nonempty == 0;
+}
@@ -0,0 +1,292 @@
+#include "priority_queue_pairing.h"
+#include <assert.h>
+#include <stdint.h>
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * @param self the pairing heap
+ * @param value an element
+ * @returns the element's embedded node
+ */
+static inline struct priority_queue_pairing_node *
+priority_queue_pairing_node_of(const struct priority_queue_pairing *const self, void *value)
+{
+	return (struct priority_queue_pairing_node *)((char *)value + self->node_offset);
+}
+
+/**
+ * @param self the pairing heap
+ * @param node a node
+ * @returns the element that embeds node
+ */
+static inline void *
+priority_queue_pairing_value_of(const struct priority_queue_pairing *const self,
+                                struct priority_queue_pairing_node *node)
+{
+	return (char *)node - self->node_offset;
+}
+
+/**
+ * Makes the root with the larger key the first child of the other
+ * @param a the root of a tree, or NULL
+ * @param b the root of another tree, or NULL
+ * @returns the root of the combined tree
+ */
+static inline struct priority_queue_pairing_node *
+priority_queue_pairing_link(struct priority_queue_pairing_node *a, struct priority_queue_pairing_node *b)
+{
+	if (a == NULL) return b;
+	if (b == NULL) return a;
+	if (b->key < a->key) {
+		struct priority_queue_pairing_node *temp = a;
+		a                                         = b;
+		b                                         = temp;
+	}
+
+	b->next = a->child;
+	if (a->child != NULL) a->child->prev = b;
+	b->prev  = a;
+	a->child = b;
+	a->next  = NULL;
+	a->prev  = NULL;
+	return a;
+}
+
+/**
+ * Combines a list of sibling trees into one with the two-pass pairing rule:
+ * link them in pairs from left to right, then link the pairs from right to
+ * left. This is what makes dequeue O(log n) amortized.
+ * @param first the first tree of the list, or NULL
+ * @returns the root of the combined tree
+ */
+static struct priority_queue_pairing_node *
+priority_queue_pairing_merge_pairs(struct priority_queue_pairing_node *first)
+{
+	// First pass: link neighbours, collecting the pairs in reverse through next
+	struct priority_queue_pairing_node *pairs = NULL;
+	while (first != NULL) {
+		struct priority_queue_pairing_node *a = first;
+		struct priority_queue_pairing_node *b = a->next;
+		first                                 = b != NULL ? b->next : NULL;
+
+		struct priority_queue_pairing_node *pair = priority_queue_pairing_link(a, b);
+		pair->next                                = pairs;
+		pairs                                     = pair;
+	}
+
+	// Second pass: fold the pairs from the last one back to the first
+	struct priority_queue_pairing_node *root = NULL;
+	while (pairs != NULL) {
+		struct priority_queue_pairing_node *pair = pairs;
+		pairs                                     = pair->next;
+		root                                      = priority_queue_pairing_link(root, pair);
+	}
+	// A tree that never lost a link still has its old sibling pointers
+	if (root != NULL) root->next = root->prev = NULL;
+	return root;
+}
+
+/**
+ * Detaches a non-root node, with its subtree, from its parent and siblings
+ * @param node a node other than the root
+ */
+static inline void
+priority_queue_pairing_cut(struct priority_queue_pairing_node *node)
+{
+	assert(node->prev != NULL);
+
+	if (node->prev->child == node) {
+		node->prev->child = node->next;
+	} else {
+		node->prev->next = node->next;
+	}
+	if (node->next != NULL) node->next->prev = node->prev;
+	node->next = NULL;
+	node->prev = NULL;
+}
+
+/**
+ * Refreshes min_key after the root changed
+ * @param self the pairing heap
+ */
+static inline void
+priority_queue_pairing_update_min_key(struct priority_queue_pairing *const self)
+{
+	self->min_key = self->root != NULL ? self->root->key : UINT64_MAX;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * Initializes an empty pairing heap
+ * @param self the pairing heap to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ * @param node_offset offsetof() the struct priority_queue_pairing_node within the element type
+ **/
+void
+priority_queue_pairing_initialize(struct priority_queue_pairing *const self, priority_queue_get_key_t get_key,
+                                  size_t node_offset)
+{
+	assert(self != NULL);
+	assert(get_key != NULL);
+
+	self->min_key     = UINT64_MAX;
+	self->root        = NULL;
+	self->length      = 0;
+	self->get_key     = get_key;
+	self->node_offset = node_offset;
+}
+
+/**
+ * Adds an element in O(1). Never fails: the element brings its own node.
+ * @param self the pairing heap
+ * @param value the value we want to add
+ **/
+void
+priority_queue_pairing_enqueue(struct priority_queue_pairing *const self, void *value)
+{
+	assert(self != NULL);
+	assert(value != NULL);
+
+	struct priority_queue_pairing_node *node = priority_queue_pairing_node_of(self, value);
+	*node = (struct priority_queue_pairing_node){ .key = self->get_key(value) };
+
+	self->root = priority_queue_pairing_link(self->root, node);
+	self->length++;
+	priority_queue_pairing_update_min_key(self);
+}
+
+/**
+ * @param self the pairing heap
+ * @returns The minimum-key element or NULL when empty
+ **/
+void *
+priority_queue_pairing_dequeue(struct priority_queue_pairing *const self)
+{
+	assert(self != NULL);
+
+	struct priority_queue_pairing_node *root = self->root;
+	if (root == NULL) return NULL;
+
+	self->root = priority_queue_pairing_merge_pairs(root->child);
+	self->length--;
+	priority_queue_pairing_update_min_key(self);
+	return priority_queue_pairing_value_of(self, root);
+}
+
+/**
+ * @param self the pairing heap
+ * @returns the minimum-key element without removing it, or NULL if empty
+ **/
+void *
+priority_queue_pairing_peek(const struct priority_queue_pairing *const self)
+{
+	assert(self != NULL);
+
+	return self->root != NULL ? priority_queue_pairing_value_of(self, self->root) : NULL;
+}
+
+/**
+ * Moves every element of other into self in O(1), leaving other empty. Both
+ * heaps must use the same node_offset and agree on keys.
+ * @param self the pairing heap receiving the elements
+ * @param other the pairing heap to empty
+ **/
+void
+priority_queue_pairing_meld(struct priority_queue_pairing *const self, struct priority_queue_pairing *const other)
+{
+	assert(self != NULL && other != NULL);
+	assert(self != other);
+	assert(self->node_offset == other->node_offset);
+
+	self->root = priority_queue_pairing_link(self->root, other->root);
+	self->length += other->length;
+	priority_queue_pairing_update_min_key(self);
+
+	other->root   = NULL;
+	other->length = 0;
+	priority_queue_pairing_update_min_key(other);
+}
+
+/**
+ * Removes an element queued in self in O(log n) amortized
+ * @param self the pairing heap holding value
+ * @param value the element to remove
+ **/
+void
+priority_queue_pairing_remove(struct priority_queue_pairing *const self, void *value)
+{
+	assert(self != NULL);
+	assert(value != NULL && self->length > 0);
+
+	struct priority_queue_pairing_node *node = priority_queue_pairing_node_of(self, value);
+	if (node == self->root) {
+		(void)priority_queue_pairing_dequeue(self);
+		return;
+	}
+
+	priority_queue_pairing_cut(node);
+	self->root = priority_queue_pairing_link(self->root, priority_queue_pairing_merge_pairs(node->child));
+	self->length--;
+	priority_queue_pairing_update_min_key(self);
+}
+
+/**
+ * Re-reads an element's key after the caller changed it. An earlier key cuts
+ * the element's subtree and links it to the root in O(1) actual time, though
+ * the amortized bound is sub-logarithmic rather than O(1); a later key costs a
+ * remove and a re-enqueue.
+ * @param self the pairing heap holding value
+ * @param value the element whose key changed
+ **/
+void
+priority_queue_pairing_update_key(struct priority_queue_pairing *const self, void *value)
+{
+	assert(self != NULL);
+	assert(value != NULL && self->length > 0);
+
+	struct priority_queue_pairing_node *node = priority_queue_pairing_node_of(self, value);
+	uint64_t                            key  = self->get_key(value);
+	if (key > node->key) {
+		priority_queue_pairing_remove(self, value);
+		priority_queue_pairing_enqueue(self, value);
+		return;
+	}
+
+	node->key = key;
+	// Its children still have keys at least as large, so the subtree stays valid
+	if (node != self->root) {
+		priority_queue_pairing_cut(node);
+		self->root = priority_queue_pairing_link(self->root, node);
+	}
+	priority_queue_pairing_update_min_key(self);
+}
+
+/**
+ * @param self the pairing heap
+ * @returns the number of elements in the pairing heap
+ **/
+size_t
+priority_queue_pairing_length(const struct priority_queue_pairing *const self)
+{
+	assert(self != NULL);
+
+	return self->length;
+}
+
+/**
+ * @param self the pairing heap
+ * @returns true if the pairing heap contains no elements
+ **/
+bool
+priority_queue_pairing_is_empty(const struct priority_queue_pairing *const self)
+{
+	assert(self != NULL);
+
+	return self->root == NULL;
+}
@@ -0,0 +1,287 @@
+#include "priority_queue_radix.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Entries in a bucket's first allocation */
+#define PRIORITY_QUEUE_RADIX_INITIAL_ENTRIES 8
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * @param floor the queue's floor
+ * @param key a key at or above the floor
+ * @returns the bucket for key: 0 if it equals the floor, else one more than
+ * the index of the highest bit in which it differs from the floor
+ */
+static inline size_t
+priority_queue_radix_bucket_index(uint64_t floor, uint64_t key)
+{
+	assert(key >= floor);
+
+	uint64_t differing = key ^ floor;
+	return differing == 0 ? 0 : (size_t)(64 - __builtin_clzll(differing));
+}
+
+/**
+ * Appends an entry to a bucket, growing its storage if needed
+ * @param self the radix queue
+ * @param index the bucket
+ * @param key the entry's key
+ * @param item the entry's element
+ * @returns 0 on success. -1 when allocation fails
+ */
+static inline int
+priority_queue_radix_push(struct priority_queue_radix *const self, size_t index, uint64_t key, void *item)
+{
+	struct priority_queue_radix_bucket *bucket = &self->buckets[index];
+	if (bucket->length == bucket->capacity) {
+		size_t capacity = bucket->capacity == 0 ? PRIORITY_QUEUE_RADIX_INITIAL_ENTRIES : bucket->capacity * 2;
+		if (capacity > SIZE_MAX / sizeof(struct priority_queue_radix_entry)) return -1;
+		struct priority_queue_radix_entry *entries = realloc(bucket->entries,
+		                                                     capacity * sizeof(struct priority_queue_radix_entry));
+		if (entries == NULL) return -1;
+		bucket->entries  = entries;
+		bucket->capacity = capacity;
+	}
+
+	if (bucket->length == 0 || key < bucket->entries[bucket->min_index].key) bucket->min_index = bucket->length;
+	bucket->entries[bucket->length++] = (struct priority_queue_radix_entry){ .key = key, .item = item };
+	if (index > 0) self->nonempty |= UINT64_C(1) << (index - 1);
+	return 0;
+}
+
+/**
+ * @param self the radix queue
+ * @returns the lowest non-empty bucket, or PRIORITY_QUEUE_RADIX_BUCKETS when the queue is empty
+ */
+static inline size_t
+priority_queue_radix_first_bucket(const struct priority_queue_radix *const self)
+{
+	if (self->buckets[0].length > 0) return 0;
+	if (self->nonempty == 0) return PRIORITY_QUEUE_RADIX_BUCKETS;
+	return (size_t)__builtin_ctzll(self->nonempty) + 1;
+}
+
+/**
+ * Recomputes min_key from the lowest non-empty bucket, whose keys are all
+ * smaller than those of any higher bucket
+ * @param self the radix queue
+ */
+static inline void
+priority_queue_radix_update_min_key(struct priority_queue_radix *const self)
+{
+	size_t index = priority_queue_radix_first_bucket(self);
+	if (index == PRIORITY_QUEUE_RADIX_BUCKETS) {
+		self->min_key = UINT64_MAX;
+	} else {
+		const struct priority_queue_radix_bucket *bucket = &self->buckets[index];
+		self->min_key                                    = bucket->entries[bucket->min_index].key;
+	}
+}
+
+/**
+ * Raises the floor to the smallest key in the lowest non-empty bucket and
+ * spreads that bucket over the buckets below it, so bucket 0 ends up holding
+ * the queue's minimum. Entries only move to strictly lower buckets, which are
+ * all empty, and room for them is reserved before anything moves.
+ * @param self the radix queue, not empty, with bucket 0 empty
+ * @returns 0 on success. -1 when allocation fails, leaving the queue unchanged
+ */
+static int
+priority_queue_radix_redistribute(struct priority_queue_radix *const self)
+{
+	size_t index = priority_queue_radix_first_bucket(self);
+	assert(index > 0 && index < PRIORITY_QUEUE_RADIX_BUCKETS);
+
+	struct priority_queue_radix_bucket *bucket = &self->buckets[index];
+	// Reserve room first so a failed allocation leaves every entry where it was
+	size_t needed[PRIORITY_QUEUE_RADIX_BUCKETS] = { 0 };
+	uint64_t floor = bucket->entries[bucket->min_index].key;
+	for (size_t i = 0; i < bucket->length; i++) {
+		needed[priority_queue_radix_bucket_index(floor, bucket->entries[i].key)]++;
+	}
+	for (size_t target = 0; target < index; target++) {
+		struct priority_queue_radix_bucket *lower = &self->buckets[target];
+		assert(lower->length == 0);
+		if (needed[target] <= lower->capacity) continue;
+		size_t capacity = lower->capacity == 0 ? PRIORITY_QUEUE_RADIX_INITIAL_ENTRIES : lower->capacity;
+		while (capacity < needed[target]) capacity *= 2;
+		struct priority_queue_radix_entry *entries = realloc(lower->entries,
+		                                                     capacity * sizeof(struct priority_queue_radix_entry));
+		if (entries == NULL) return -1;
+		lower->entries  = entries;
+		lower->capacity = capacity;
+	}
+
+	self->floor = floor;
+	self->nonempty &= ~(UINT64_C(1) << (index - 1));
+	size_t length  = bucket->length;
+	bucket->length = 0;
+	for (size_t i = 0; i < length; i++) {
+		struct priority_queue_radix_entry entry = bucket->entries[i];
+		// Room was reserved above, so this cannot fail
+		(void)priority_queue_radix_push(self, priority_queue_radix_bucket_index(floor, entry.key), entry.key,
+		                                entry.item);
+	}
+	return 0;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * Initializes an empty radix queue with a floor of 0. No memory is allocated
+ * until the first enqueue.
+ * @param self the radix queue to initialize
+ * @param get_key pointer to a function that extracts the ordering key from an element
+ **/
+void
+priority_queue_radix_initialize(struct priority_queue_radix *const self, priority_queue_get_key_t get_key)
+{
+	assert(self != NULL);
+	assert(get_key != NULL);
+
+	for (size_t i = 0; i < PRIORITY_QUEUE_RADIX_BUCKETS; i++) {
+		self->buckets[i] = (struct priority_queue_radix_bucket){ .entries = NULL };
+	}
+	self->get_key  = get_key;
+	self->min_key  = UINT64_MAX;
+	self->floor    = 0;
+	self->nonempty = 0;
+	self->length   = 0;
+}
+
+/**
+ * Releases the buckets' storage. Queued elements are not touched.
+ * @param self the radix queue to destroy
+ **/
+void
+priority_queue_radix_destroy(struct priority_queue_radix *const self)
+{
+	assert(self != NULL);
+
+	for (size_t i = 0; i < PRIORITY_QUEUE_RADIX_BUCKETS; i++) free(self->buckets[i].entries);
+	priority_queue_radix_initialize(self, self->get_key);
+}
+
+/**
+ * Removes all elements and resets the floor to 0, keeping bucket storage for reuse
+ * @param self the radix queue to clear
+ **/
+void
+priority_queue_radix_clear(struct priority_queue_radix *const self)
+{
+	assert(self != NULL);
+
+	for (size_t i = 0; i < PRIORITY_QUEUE_RADIX_BUCKETS; i++) self->buckets[i].length = 0;
+	self->min_key  = UINT64_MAX;
+	self->floor    = 0;
+	self->nonempty = 0;
+	self->length   = 0;
+}
+
+/**
+ * @param self the radix queue
+ * @param value the value we want to add; its key must be at least self->floor
+ * @returns 0 on success. PRIORITY_QUEUE_RADIX_BELOW_FLOOR when the key is
+ * smaller than the last dequeued key. -1 when allocation fails
+ **/
+int
+priority_queue_radix_enqueue(struct priority_queue_radix *const self, void *value)
+{
+	assert(self != NULL);
+
+	uint64_t key = self->get_key(value);
+	if (key < self->floor) return PRIORITY_QUEUE_RADIX_BELOW_FLOOR;
+	if (priority_queue_radix_push(self, priority_queue_radix_bucket_index(self->floor, key), key, value) != 0) {
+		return -1;
+	}
+
+	self->length++;
+	if (key < self->min_key) self->min_key = key;
+	return 0;
+}
+
+/**
+ * Removes an element with the smallest key and raises the floor to that key
+ * @param self the radix queue
+ * @returns The minimum-key element, or NULL when empty or when redistributing
+ * a bucket fails to allocate. Use priority_queue_radix_try_dequeue to tell
+ * the two apart
+ **/
+void *
+priority_queue_radix_dequeue(struct priority_queue_radix *const self)
+{
+	void *min = NULL;
+	return priority_queue_radix_try_dequeue(self, &min) == 0 ? min : NULL;
+}
+
+/**
+ * Like priority_queue_radix_dequeue, but reports why nothing was removed
+ * @param self the radix queue
+ * @param out receives the minimum-key element on success
+ * @returns 0 on success. -1 when the queue is empty. PRIORITY_QUEUE_RADIX_NO_MEMORY
+ * when redistributing a bucket fails to allocate, leaving the queue unchanged
+ **/
+int
+priority_queue_radix_try_dequeue(struct priority_queue_radix *const self, void **out)
+{
+	assert(self != NULL);
+	assert(out != NULL);
+
+	if (self->length == 0) return -1;
+	if (self->buckets[0].length == 0 && priority_queue_radix_redistribute(self) != 0) {
+		return PRIORITY_QUEUE_RADIX_NO_MEMORY;
+	}
+
+	// Every key in bucket 0 equals the floor, so any entry will do
+	struct priority_queue_radix_bucket *bucket = &self->buckets[0];
+	*out                                       = bucket->entries[--bucket->length].item;
+	bucket->min_index                          = 0;
+	self->length--;
+	priority_queue_radix_update_min_key(self);
+	return 0;
+}
+
+/**
+ * @param self the radix queue
+ * @returns an element with the smallest key without removing it, or NULL if empty
+ **/
+void *
+priority_queue_radix_peek(const struct priority_queue_radix *const self)
+{
+	assert(self != NULL);
+
+	size_t index = priority_queue_radix_first_bucket(self);
+	if (index == PRIORITY_QUEUE_RADIX_BUCKETS) return NULL;
+	const struct priority_queue_radix_bucket *bucket = &self->buckets[index];
+	return bucket->entries[bucket->min_index].item;
+}
+
+/**
+ * @param self the radix queue
+ * @returns the number of elements in the queue
+ **/
+size_t
+priority_queue_radix_length(const struct priority_queue_radix *const self)
+{
+	assert(self != NULL);
+
+	return self->length;
+}
+
+/**
+ * @param self the radix queue
+ * @returns true if the queue contains no elements
+ **/
+bool
+priority_queue_radix_is_empty(const struct priority_queue_radix *const self)
+{
+	assert(self != NULL);
+
+	return self->length == 0;
+}
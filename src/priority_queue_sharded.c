@@ -0,0 +1,167 @@
+#include "priority_queue_sharded.h"
+#include <assert.h>
+#include <stdint.h>
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * Finds the shard, other than the worker's own, with the earliest published key
+ * @param self the sharded priority queue
+ * @param worker the shard to skip
+ * @returns the victim's index, or shard_count when every other shard looks empty
+ */
+static size_t
+priority_queue_sharded_find_victim(const struct priority_queue_sharded *const self, size_t worker)
+{
+	size_t   victim     = self->shard_count;
+	uint64_t victim_key = UINT64_MAX;
+	for (size_t i = 0; i < self->shard_count; i++) {
+		if (i == worker) continue;
+		uint64_t key = priority_queue_concurrent_peek_key(&self->shards[i]);
+		if (key < victim_key) {
+			victim     = i;
+			victim_key = key;
+		}
+	}
+	return victim;
+}
+
+/**
+ * @param self the sharded priority queue
+ * @param worker the worker about to dequeue
+ * @returns true if some other shard's earliest key beats the worker's by more than steal_slack
+ */
+static inline bool
+priority_queue_sharded_should_steal(const struct priority_queue_sharded *const self, size_t worker)
+{
+	uint64_t local_key = priority_queue_concurrent_peek_key(&self->shards[worker]);
+	if (local_key == UINT64_MAX) return true;
+	if (self->steal_slack == UINT64_MAX || local_key <= self->steal_slack) return false;
+
+	uint64_t threshold = local_key - self->steal_slack;
+	for (size_t i = 0; i < self->shard_count; i++) {
+		if (i != worker && priority_queue_concurrent_peek_key(&self->shards[i]) < threshold) return true;
+	}
+	return false;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * Initializes a sharded queue over caller-owned shards, which must already be
+ * initialized with priority_queue_concurrent_initialize or _initialize_dynamic
+ * @param self the sharded priority queue to initialize
+ * @param shards one concurrent queue per worker
+ * @param shard_count the number of workers
+ * @param config steal batch size and slack
+ **/
+void
+priority_queue_sharded_initialize(struct priority_queue_sharded *const self, struct priority_queue_concurrent *shards,
+                                  size_t shard_count, const struct priority_queue_sharded_config *config)
+{
+	assert(self != NULL);
+	assert(shards != NULL && shard_count > 0);
+	assert(config != NULL);
+	assert(config->steal_batch >= 1 && config->steal_batch <= PRIORITY_QUEUE_SHARDED_MAX_STEAL);
+
+	self->shards      = shards;
+	self->shard_count = shard_count;
+	self->steal_batch = config->steal_batch;
+	self->steal_slack = config->steal_slack;
+}
+
+/**
+ * Adds a value to the worker's own shard
+ * @param self the sharded priority queue
+ * @param worker the calling worker
+ * @param value the value we want to add
+ * @returns 0 on success. -1 when the worker's shard is full
+ **/
+int
+priority_queue_sharded_enqueue(struct priority_queue_sharded *const self, size_t worker, void *value)
+{
+	assert(self != NULL);
+	assert(worker < self->shard_count);
+
+	return priority_queue_concurrent_enqueue(&self->shards[worker], value);
+}
+
+/**
+ * Moves a batch of the earliest elements from the shard with the earliest
+ * published key into the worker's shard
+ * @param self the sharded priority queue
+ * @param worker the calling worker
+ * @returns the number of elements moved
+ **/
+size_t
+priority_queue_sharded_steal(struct priority_queue_sharded *const self, size_t worker)
+{
+	assert(self != NULL);
+	assert(worker < self->shard_count);
+
+	size_t victim = priority_queue_sharded_find_victim(self, worker);
+	if (victim == self->shard_count) return 0;
+
+	assert(victim != worker);
+
+	// Hold both locks for the move, so the room measured in our own shard is still there when the stolen
+	// elements arrive. Locks are taken in shard order, so two workers stealing from each other cannot deadlock
+	struct priority_queue_concurrent *own    = &self->shards[worker];
+	struct priority_queue_concurrent *other  = &self->shards[victim];
+	struct priority_queue_concurrent *first  = worker < victim ? own : other;
+	struct priority_queue_concurrent *second = worker < victim ? other : own;
+	priority_queue_concurrent_lock(first);
+	priority_queue_concurrent_lock(second);
+
+	// Never take more than our own shard can hold without growing, so stolen elements always have a home
+	size_t room  = own->queue.capacity - own->queue.first_free;
+	size_t batch = room < self->steal_batch ? room : self->steal_batch;
+	void  *stolen[PRIORITY_QUEUE_SHARDED_MAX_STEAL];
+	size_t count = priority_queue_dequeue_until(&other->queue, UINT64_MAX, stolen, batch);
+	size_t moved = priority_queue_enqueue_batch(&own->queue, stolen, count);
+	assert(moved == count);
+
+	// Unlocking republishes both shards' min_key
+	priority_queue_concurrent_unlock(second);
+	priority_queue_concurrent_unlock(first);
+	return moved;
+}
+
+/**
+ * Removes the earliest element the worker can see: from its own shard, after
+ * stealing first if the shard is empty or trails another by more than steal_slack
+ * @param self the sharded priority queue
+ * @param worker the calling worker
+ * @returns an element, or NULL when every shard is empty
+ **/
+void *
+priority_queue_sharded_dequeue(struct priority_queue_sharded *const self, size_t worker)
+{
+	assert(self != NULL);
+	assert(worker < self->shard_count);
+
+	if (priority_queue_sharded_should_steal(self, worker)) (void)priority_queue_sharded_steal(self, worker);
+	return priority_queue_concurrent_dequeue(&self->shards[worker]);
+}
+
+/**
+ * Reads the earliest key across all shards without taking any lock
+ * @param self the sharded priority queue
+ * @returns the smallest published key, or UINT64_MAX if every shard is empty
+ **/
+uint64_t
+priority_queue_sharded_peek_key(const struct priority_queue_sharded *const self)
+{
+	assert(self != NULL);
+
+	uint64_t min_key = UINT64_MAX;
+	for (size_t i = 0; i < self->shard_count; i++) {
+		uint64_t key = priority_queue_concurrent_peek_key(&self->shards[i]);
+		if (key < min_key) min_key = key;
+	}
+	return min_key;
+}
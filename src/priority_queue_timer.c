@@ -0,0 +1,224 @@
+/* clock_gettime and the timerfd API */
+#define _GNU_SOURCE
+
+#include "priority_queue_timer.h"
+
+#ifdef __linux__
+
+#include <assert.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define PRIORITY_QUEUE_TIMER_NS_PER_SEC UINT64_C(1000000000)
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * Creates the timerfd once the queue is initialized
+ * @param self the timer queue
+ * @param clock the clock keys are measured on
+ * @returns 0 on success. -1 if timerfd_create fails, with errno set
+ */
+static inline int
+priority_queue_timer_open(struct priority_queue_timer *const self, clockid_t clock)
+{
+	self->clock     = clock;
+	self->armed_key = UINT64_MAX;
+	self->fd        = timerfd_create(clock, TFD_NONBLOCK | TFD_CLOEXEC);
+	return self->fd < 0 ? -1 : 0;
+}
+
+/**
+ * Arms the timer at the queue's min_key, or disarms it when the queue is
+ * empty, unless it is already armed there
+ * @param self the timer queue
+ * @returns 0 on success. PRIORITY_QUEUE_TIMER_ARM_FAILED if timerfd_settime fails, with errno set
+ */
+static inline int
+priority_queue_timer_sync(struct priority_queue_timer *const self)
+{
+	uint64_t key = self->queue.min_key;
+	if (key == self->armed_key) return 0;
+
+	// An it_value of zero disarms the timer
+	struct itimerspec spec = { 0 };
+	if (key != UINT64_MAX) {
+		// A zero expiry would disarm instead of firing at once, so it becomes the earliest nonzero time
+		uint64_t expiry       = key == 0 ? 1 : key;
+		spec.it_value.tv_sec  = (time_t)(expiry / PRIORITY_QUEUE_TIMER_NS_PER_SEC);
+		spec.it_value.tv_nsec = (long)(expiry % PRIORITY_QUEUE_TIMER_NS_PER_SEC);
+	}
+	if (timerfd_settime(self->fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) return PRIORITY_QUEUE_TIMER_ARM_FAILED;
+	self->armed_key = key;
+	return 0;
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+#if PRIORITY_QUEUE_CAPACITY > 0
+/**
+ * Initializes a timer queue with the storage embedded in its struct priority_queue
+ * @param self the timer queue to initialize
+ * @param get_key pointer to a function that returns an element's expiry in nanoseconds on clock
+ * @param clock the clock expiries are measured on, e.g. CLOCK_MONOTONIC
+ * @returns 0 on success. -1 if the timerfd cannot be created, with errno set
+ **/
+int
+priority_queue_timer_initialize(struct priority_queue_timer *const self, priority_queue_get_key_t get_key,
+                                clockid_t clock)
+{
+	assert(self != NULL);
+
+	priority_queue_initialize(&self->queue, get_key);
+	return priority_queue_timer_open(self, clock);
+}
+#endif
+
+/**
+ * Initializes a timer queue whose storage comes from an allocator; see priority_queue_initialize_dynamic
+ * @param self the timer queue to initialize
+ * @param get_key pointer to a function that returns an element's expiry in nanoseconds on clock
+ * @param clock the clock expiries are measured on, e.g. CLOCK_MONOTONIC
+ * @param config initial capacity, growth policy, allocator and indexed mode
+ * @returns 0 on success. -1 if the queue cannot be allocated or the timerfd cannot be created
+ **/
+int
+priority_queue_timer_initialize_dynamic(struct priority_queue_timer *const self, priority_queue_get_key_t get_key,
+                                        clockid_t clock, const struct priority_queue_config *config)
+{
+	assert(self != NULL);
+
+	if (priority_queue_initialize_dynamic(&self->queue, get_key, config) != 0) return -1;
+	if (priority_queue_timer_open(self, clock) != 0) {
+		priority_queue_destroy(&self->queue);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Closes the timerfd and releases the queue's storage. Queued elements are not touched.
+ * @param self the timer queue to destroy
+ **/
+void
+priority_queue_timer_destroy(struct priority_queue_timer *const self)
+{
+	assert(self != NULL);
+
+	if (self->fd >= 0) close(self->fd);
+	self->fd = -1;
+	priority_queue_destroy(&self->queue);
+}
+
+/**
+ * @param self the timer queue
+ * @returns the timerfd to register with epoll for EPOLLIN. It is readable
+ * once the earliest queued expiry has passed
+ **/
+int
+priority_queue_timer_fd(const struct priority_queue_timer *const self)
+{
+	assert(self != NULL);
+
+	return self->fd;
+}
+
+/**
+ * @param self the timer queue
+ * @param value the element to add
+ * @returns 0 on success. -1 when the queue is full.
+ * PRIORITY_QUEUE_TIMER_ARM_FAILED if value was queued as a new earliest
+ * expiry but the timer could not be moved; call priority_queue_timer_rearm
+ * again later
+ **/
+int
+priority_queue_timer_enqueue(struct priority_queue_timer *const self, void *value)
+{
+	assert(self != NULL);
+
+	if (priority_queue_enqueue(&self->queue, value) != 0) return -1;
+	return priority_queue_timer_sync(self);
+}
+
+/**
+ * Removes the earliest element whether or not it is due, and moves the timer
+ * to the next expiry
+ * @param self the timer queue
+ * @returns the element with the earliest expiry, or NULL if empty
+ **/
+void *
+priority_queue_timer_dequeue(struct priority_queue_timer *const self)
+{
+	assert(self != NULL);
+
+	void *value = priority_queue_dequeue(&self->queue);
+	// On failure the timer stays at the old expiry, which at worst wakes the loop early
+	(void)priority_queue_timer_sync(self);
+	return value;
+}
+
+/**
+ * Delivers every expired element, up to max_out of them, in expiry order. Call
+ * it when the fd is readable; it consumes the fd's readiness, and the timer is
+ * armed for whatever is left. If more than max_out elements were due, the new
+ * expiry is already past and the fd is readable again at once.
+ * @param self the timer queue
+ * @param out buffer receiving the expired elements
+ * @param max_out capacity of out
+ * @returns the number of elements written to out
+ **/
+size_t
+priority_queue_timer_dispatch(struct priority_queue_timer *const self, void **out, size_t max_out)
+{
+	assert(self != NULL);
+
+	uint64_t expirations;
+	if (read(self->fd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations)) {
+		// The timer fired and is now disarmed, even if the root did not change
+		self->armed_key = UINT64_MAX;
+	}
+
+	size_t count = priority_queue_dequeue_until(&self->queue, priority_queue_timer_now(self), out, max_out);
+	// On failure armed_key still differs from min_key, so the next call tries again
+	(void)priority_queue_timer_sync(self);
+	return count;
+}
+
+/**
+ * Arms the timer at the queue's min_key, or disarms it when the queue is
+ * empty. Makes no system call when it is already armed there.
+ * @param self the timer queue
+ * @returns 0 on success. PRIORITY_QUEUE_TIMER_ARM_FAILED if timerfd_settime fails, with errno set
+ **/
+int
+priority_queue_timer_rearm(struct priority_queue_timer *const self)
+{
+	assert(self != NULL);
+
+	return priority_queue_timer_sync(self);
+}
+
+/**
+ * Reads the queue's clock. timerfd_create accepted the clock when the queue
+ * was initialized, so reading it cannot fail; that is asserted, not returned.
+ * @param self the timer queue
+ * @returns the current time on the queue's clock, in nanoseconds, for computing expiries
+ **/
+uint64_t
+priority_queue_timer_now(const struct priority_queue_timer *const self)
+{
+	assert(self != NULL);
+
+	struct timespec now    = { 0 };
+	int             status = clock_gettime(self->clock, &now);
+	assert(status == 0);
+	(void)status;
+	return (uint64_t)now.tv_sec * PRIORITY_QUEUE_TIMER_NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+#endif /* __linux__ */
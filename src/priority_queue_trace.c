@@ -0,0 +1,185 @@
+#include "priority_queue_trace.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Records rebased and written per fwrite while dumping */
+#define PRIORITY_QUEUE_TRACE_DUMP_CHUNK 256
+
+/****************************
+ * Private Helper Functions *
+ ****************************/
+
+/**
+ * @returns CLOCK_MONOTONIC in nanoseconds
+ */
+static inline uint64_t
+priority_queue_trace_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @param self the trace
+ * @param i 0 for the oldest record still held, up to priority_queue_trace_length - 1
+ * @returns that record
+ */
+static inline const struct priority_queue_trace_record *
+priority_queue_trace_at(const struct priority_queue_trace *const self, size_t i)
+{
+	uint64_t sequence = self->written - priority_queue_trace_length(self) + i;
+	return &self->records[sequence & (self->capacity - 1)];
+}
+
+/*********************
+ * Public API        *
+ *********************/
+
+/**
+ * Starts an empty trace. Its clock starts now.
+ * @param self the trace to initialize
+ * @param records caller-owned storage for the ring
+ * @param capacity number of records, a power of two
+ **/
+void
+priority_queue_trace_initialize(struct priority_queue_trace *const self, struct priority_queue_trace_record *records,
+                                size_t capacity)
+{
+	assert(self != NULL);
+	assert(records != NULL);
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+	self->records  = records;
+	self->capacity = capacity;
+	self->written  = 0;
+	self->start_ns = priority_queue_trace_now();
+}
+
+/**
+ * Records an operation, overwriting the oldest record when the ring is full
+ * @param self the trace
+ * @param op the operation
+ * @param key the key of the element it touched, 0 for a clear
+ **/
+void
+priority_queue_trace_append(struct priority_queue_trace *const self, enum priority_queue_trace_op op, uint64_t key)
+{
+	assert(self != NULL);
+
+	struct priority_queue_trace_record *record = &self->records[self->written & (self->capacity - 1)];
+
+	record->key   = key;
+	record->stamp = (priority_queue_trace_now() - self->start_ns) << 8 | op;
+	self->written++;
+}
+
+/**
+ * @param self the trace
+ * @returns the number of records the ring holds
+ **/
+size_t
+priority_queue_trace_length(const struct priority_queue_trace *const self)
+{
+	assert(self != NULL);
+
+	return self->written < self->capacity ? (size_t)self->written : self->capacity;
+}
+
+/**
+ * Writes a header and the held records, oldest first. With anonymize, the
+ * smallest key is subtracted from every key, so only the order and spacing of
+ * keys leaves the process, along with the relative timestamps.
+ * @param self the trace
+ * @param out stream to write to
+ * @param anonymize whether to rebase keys to start at 0
+ * @returns 0 on success. -1 if a write fails
+ **/
+int
+priority_queue_trace_dump(const struct priority_queue_trace *const self, FILE *out, bool anonymize)
+{
+	assert(self != NULL);
+	assert(out != NULL);
+
+	size_t   length = priority_queue_trace_length(self);
+	uint64_t base   = UINT64_MAX;
+	for (size_t i = 0; i < length; i++) {
+		const struct priority_queue_trace_record *record = priority_queue_trace_at(self, i);
+		if (priority_queue_trace_record_op(record) != PRIORITY_QUEUE_TRACE_CLEAR && record->key < base) {
+			base = record->key;
+		}
+	}
+	if (!anonymize || base == UINT64_MAX) base = 0;
+
+	struct priority_queue_trace_header header = {
+		.magic       = PRIORITY_QUEUE_TRACE_MAGIC,
+		.version     = PRIORITY_QUEUE_TRACE_VERSION,
+		.record_size = sizeof(struct priority_queue_trace_record),
+		.count       = length,
+		.dropped     = self->written - length,
+	};
+	if (fwrite(&header, sizeof(header), 1, out) != 1) return -1;
+
+	struct priority_queue_trace_record chunk[PRIORITY_QUEUE_TRACE_DUMP_CHUNK];
+	for (size_t done = 0; done < length;) {
+		size_t n = length - done;
+		if (n > PRIORITY_QUEUE_TRACE_DUMP_CHUNK) n = PRIORITY_QUEUE_TRACE_DUMP_CHUNK;
+		for (size_t i = 0; i < n; i++) {
+			chunk[i] = *priority_queue_trace_at(self, done + i);
+			// A clear's key is always 0
+			if (priority_queue_trace_record_op(&chunk[i]) != PRIORITY_QUEUE_TRACE_CLEAR) {
+				chunk[i].key -= base;
+			}
+		}
+		if (fwrite(chunk, sizeof(chunk[0]), n, out) != n) return -1;
+		done += n;
+	}
+	return fflush(out) == 0 ? 0 : -1;
+}
+
+/**
+ * Reads a trace written by priority_queue_trace_dump
+ * @param in stream positioned at the header
+ * @param records receives a malloc'd array of the records, oldest first, for the caller to free
+ * @param count receives the number of records
+ * @returns 0 on success. -1 if a read or allocation fails.
+ * PRIORITY_QUEUE_TRACE_BAD_FORMAT if the header, the length or an operation is not valid
+ **/
+int
+priority_queue_trace_load(FILE *in, struct priority_queue_trace_record **records, size_t *count)
+{
+	assert(in != NULL);
+	assert(records != NULL);
+	assert(count != NULL);
+
+	struct priority_queue_trace_header header;
+	if (fread(&header, sizeof(header), 1, in) != 1) return ferror(in) ? -1 : PRIORITY_QUEUE_TRACE_BAD_FORMAT;
+	if (header.magic != PRIORITY_QUEUE_TRACE_MAGIC || header.version != PRIORITY_QUEUE_TRACE_VERSION
+	    || header.record_size != sizeof(struct priority_queue_trace_record)
+	    || header.count > SIZE_MAX / sizeof(struct priority_queue_trace_record)) {
+		return PRIORITY_QUEUE_TRACE_BAD_FORMAT;
+	}
+
+	size_t                              length = (size_t)header.count;
+	struct priority_queue_trace_record *loaded = malloc(length > 0 ? length * sizeof(*loaded) : 1);
+	if (loaded == NULL) return -1;
+	if (fread(loaded, sizeof(*loaded), length, in) != length) {
+		int status = ferror(in) ? -1 : PRIORITY_QUEUE_TRACE_BAD_FORMAT;
+		free(loaded);
+		return status;
+	}
+	for (size_t i = 0; i < length; i++) {
+		enum priority_queue_trace_op op = priority_queue_trace_record_op(&loaded[i]);
+		if (op != PRIORITY_QUEUE_TRACE_ENQUEUE && op != PRIORITY_QUEUE_TRACE_DEQUEUE
+		    && op != PRIORITY_QUEUE_TRACE_CLEAR) {
+			free(loaded);
+			return PRIORITY_QUEUE_TRACE_BAD_FORMAT;
+		}
+	}
+
+	*records = loaded;
+	*count   = length;
+	return 0;
+}
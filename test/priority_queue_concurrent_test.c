@@ -0,0 +1,219 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "priority_queue_concurrent.h"
+
+struct sandbox_request {
+	uint64_t    absolute_deadline;
+	_Atomic int dequeued;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+struct priority_queue_concurrent cpq;
+
+void
+setUp(void)
+{
+	struct priority_queue_config config = { .capacity = 64, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_initialize_dynamic(&cpq, sandbox_request_get_key, &config));
+}
+
+void
+tearDown(void)
+{
+	priority_queue_concurrent_destroy(&cpq);
+}
+
+void
+initialize_publishes_UINT64_MAX(void)
+{
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_concurrent_peek_key(&cpq));
+}
+
+void
+enqueue_and_dequeue_publish_min_key(void)
+{
+	struct sandbox_request sandbox_10 = { .absolute_deadline = 10 };
+	struct sandbox_request sandbox_5  = { .absolute_deadline = 5 };
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_enqueue(&cpq, &sandbox_10));
+	TEST_ASSERT_EQUAL_UINT64(10, priority_queue_concurrent_peek_key(&cpq));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_enqueue(&cpq, &sandbox_5));
+	TEST_ASSERT_EQUAL_UINT64(5, priority_queue_concurrent_peek_key(&cpq));
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_concurrent_length(&cpq));
+
+	TEST_ASSERT_EQUAL_PTR(&sandbox_5, priority_queue_concurrent_dequeue(&cpq));
+	TEST_ASSERT_EQUAL_UINT64(10, priority_queue_concurrent_peek_key(&cpq));
+	TEST_ASSERT_EQUAL_PTR(&sandbox_10, priority_queue_concurrent_dequeue(&cpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_concurrent_peek_key(&cpq));
+	TEST_ASSERT_NULL(priority_queue_concurrent_dequeue(&cpq));
+}
+
+void
+try_operations_fail_fast_while_locked(void)
+{
+	struct sandbox_request sandbox_one = { .absolute_deadline = 10 };
+	void                  *out         = NULL;
+
+	priority_queue_concurrent_lock(&cpq);
+	TEST_ASSERT_FALSE(priority_queue_concurrent_try_lock(&cpq));
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_BUSY, priority_queue_concurrent_try_enqueue(&cpq, &sandbox_one));
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_BUSY, priority_queue_concurrent_try_dequeue(&cpq, &out));
+	priority_queue_concurrent_unlock(&cpq);
+
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_concurrent_try_dequeue(&cpq, &out));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_try_enqueue(&cpq, &sandbox_one));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_try_dequeue(&cpq, &out));
+	TEST_ASSERT_EQUAL_PTR(&sandbox_one, out);
+}
+
+void
+unlock_publishes_direct_queue_changes(void)
+{
+	struct sandbox_request sandbox_one = { .absolute_deadline = 42 };
+
+	priority_queue_concurrent_lock(&cpq);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&cpq.queue, &sandbox_one));
+	priority_queue_concurrent_unlock(&cpq);
+	TEST_ASSERT_EQUAL_UINT64(42, priority_queue_concurrent_peek_key(&cpq));
+}
+
+void
+dequeue_until_skips_lock_when_nothing_is_due(void)
+{
+	struct sandbox_request sandbox_one = { .absolute_deadline = 42 };
+	void                  *out[2];
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_enqueue(&cpq, &sandbox_one));
+
+	priority_queue_concurrent_lock(&cpq);
+	// Would deadlock if it took the lock
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_concurrent_dequeue_until(&cpq, 41, out, 2));
+	priority_queue_concurrent_unlock(&cpq);
+
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_concurrent_dequeue_until(&cpq, 42, out, 2));
+	TEST_ASSERT_EQUAL_PTR(&sandbox_one, out[0]);
+}
+
+void
+peek_k_leaves_elements_queued(void)
+{
+	struct sandbox_request sandboxes[3] = { { .absolute_deadline = 30 },
+		                                { .absolute_deadline = 10 },
+		                                { .absolute_deadline = 20 } };
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_enqueue(&cpq, &sandboxes[i]));
+
+	void *out[2];
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_concurrent_peek_k(&cpq, out, 2));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[1], out[0]);
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[2], out[1]);
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_concurrent_length(&cpq));
+	TEST_ASSERT_EQUAL_UINT64(10, priority_queue_concurrent_peek_key(&cpq));
+}
+
+enum
+{
+	stress_threads            = 4,
+	stress_items_per_producer = 2000
+};
+
+static struct sandbox_request stress_items[stress_threads][stress_items_per_producer];
+static _Atomic size_t         stress_dequeued;
+
+static void *
+stress_producer(void *arg)
+{
+	struct sandbox_request *items = arg;
+	for (size_t i = 0; i < stress_items_per_producer; i++) {
+		while (priority_queue_concurrent_enqueue(&cpq, &items[i]) != 0) sched_yield();
+	}
+	return NULL;
+}
+
+static void *
+stress_consumer(void *arg)
+{
+	(void)arg;
+	while (atomic_load(&stress_dequeued) < stress_threads * stress_items_per_producer) {
+		void *out;
+		if (priority_queue_concurrent_try_dequeue(&cpq, &out) != 0) {
+			sched_yield();
+			continue;
+		}
+		struct sandbox_request *sandbox = out;
+		TEST_ASSERT_EQUAL_INT(0, atomic_fetch_add(&sandbox->dequeued, 1));
+		atomic_fetch_add(&stress_dequeued, 1);
+	}
+	return NULL;
+}
+
+void
+concurrent_producers_and_consumers_dequeue_each_element_once(void)
+{
+	uint64_t state = 17;
+	for (size_t t = 0; t < stress_threads; t++) {
+		for (size_t i = 0; i < stress_items_per_producer; i++) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			stress_items[t][i].absolute_deadline = state % 100000;
+			atomic_init(&stress_items[t][i].dequeued, 0);
+		}
+	}
+	atomic_init(&stress_dequeued, 0);
+
+	pthread_t producers[stress_threads], consumers[stress_threads];
+	for (size_t t = 0; t < stress_threads; t++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&producers[t], NULL, stress_producer, stress_items[t]));
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&consumers[t], NULL, stress_consumer, NULL));
+	}
+	for (size_t t = 0; t < stress_threads; t++) {
+		pthread_join(producers[t], NULL);
+		pthread_join(consumers[t], NULL);
+	}
+
+	TEST_ASSERT_EQUAL_UINT(stress_threads * stress_items_per_producer, atomic_load(&stress_dequeued));
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_concurrent_length(&cpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_concurrent_peek_key(&cpq));
+}
+
+void
+dynamic_concurrent_queue_grows(void)
+{
+	struct priority_queue_concurrent dynamic;
+	struct priority_queue_config     config    = { .capacity = 2, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE };
+	struct sandbox_request           items[64] = { 0 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_initialize_dynamic(&dynamic, sandbox_request_get_key, &config));
+
+	for (size_t i = 0; i < 64; i++) {
+		items[i].absolute_deadline = 64 - i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_enqueue(&dynamic, &items[i]));
+	}
+	TEST_ASSERT_EQUAL_UINT64(1, priority_queue_concurrent_peek_key(&dynamic));
+
+	priority_queue_concurrent_destroy(&dynamic);
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_concurrent_test.c");
+	RUN_TEST(initialize_publishes_UINT64_MAX);
+	RUN_TEST(enqueue_and_dequeue_publish_min_key);
+	RUN_TEST(try_operations_fail_fast_while_locked);
+	RUN_TEST(unlock_publishes_direct_queue_changes);
+	RUN_TEST(dequeue_until_skips_lock_when_nothing_is_due);
+	RUN_TEST(peek_k_leaves_elements_queued);
+	RUN_TEST(concurrent_producers_and_consumers_dequeue_each_element_once);
+	RUN_TEST(dynamic_concurrent_queue_grows);
+
+	return UnityEnd();
+}
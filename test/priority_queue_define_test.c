@@ -0,0 +1,217 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "test_random.h"
+#include "priority_queue.h"
+#include "priority_queue_define.h"
+
+struct timer {
+	uint64_t deadline;
+	int      id;
+};
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+PRIORITY_QUEUE_DEFINE(timer_queue, struct timer, elem->deadline, 8)
+PRIORITY_QUEUE_DEFINE(request_queue, struct sandbox_request *, (*elem)->absolute_deadline, 4096)
+PRIORITY_QUEUE_DEFINE(timer_heap, struct timer, elem->deadline, 32)
+PRIORITY_QUEUE_DEFINE_SMALL(small_timer_queue, struct timer, elem->deadline, 32)
+
+struct timer_queue   tq;
+struct request_queue rq;
+
+void
+setUp(void)
+{
+	timer_queue_initialize(&tq);
+	request_queue_initialize(&rq);
+}
+
+void
+tearDown(void)
+{
+}
+
+void
+initialize_is_empty_with_UINT64_MAX_min_key(void)
+{
+	struct timer out = { 0 };
+	TEST_ASSERT_TRUE(timer_queue_is_empty(&tq));
+	TEST_ASSERT_EQUAL_UINT(0, timer_queue_length(&tq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, tq.min_key);
+	TEST_ASSERT_NULL(timer_queue_peek(&tq));
+	TEST_ASSERT_EQUAL_INT(-1, timer_queue_dequeue(&tq, &out));
+}
+
+void
+values_are_stored_by_value_and_dequeued_in_order(void)
+{
+	uint64_t deadlines[] = { 50, 20, 80, 10, 30, 70, 60, 40 };
+	for (int i = 0; i < 8; i++) {
+		struct timer timer = { .deadline = deadlines[i], .id = i };
+		TEST_ASSERT_EQUAL_INT(0, timer_queue_enqueue(&tq, timer));
+		// The queue holds its own copy
+		timer.deadline = 0;
+	}
+	TEST_ASSERT_TRUE(timer_queue_is_full(&tq));
+	TEST_ASSERT_EQUAL_INT(-1, timer_queue_enqueue(&tq, (struct timer){ .deadline = 1 }));
+	TEST_ASSERT_EQUAL_UINT64(10, tq.min_key);
+	TEST_ASSERT_EQUAL_INT(3, timer_queue_peek(&tq)->id);
+
+	for (uint64_t expected = 10; expected <= 80; expected += 10) {
+		struct timer out = { 0 };
+		TEST_ASSERT_EQUAL_INT(0, timer_queue_dequeue(&tq, &out));
+		TEST_ASSERT_EQUAL_UINT64(expected, out.deadline);
+		TEST_ASSERT_EQUAL_UINT64(deadlines[out.id], out.deadline);
+	}
+	TEST_ASSERT_TRUE(timer_queue_is_empty(&tq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, tq.min_key);
+}
+
+void
+clear_allows_reuse(void)
+{
+	struct timer out = { 0 };
+	TEST_ASSERT_EQUAL_INT(0, timer_queue_enqueue(&tq, (struct timer){ .deadline = 5 }));
+	timer_queue_clear(&tq);
+	TEST_ASSERT_TRUE(timer_queue_is_empty(&tq));
+	TEST_ASSERT_EQUAL_INT(0, timer_queue_enqueue(&tq, (struct timer){ .deadline = 9, .id = 1 }));
+	TEST_ASSERT_EQUAL_INT(0, timer_queue_dequeue(&tq, &out));
+	TEST_ASSERT_EQUAL_INT(1, out.id);
+}
+
+void
+pointer_instantiation_matches_priority_queue_slot_for_slot(void)
+{
+	enum { count = 2000 };
+	static struct sandbox_request sandboxes[count];
+	static struct priority_queue  pq;
+	uint64_t                      state  = TEST_RANDOM_SEED;
+	struct priority_queue_config  config = { .capacity = count, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_initialize_dynamic(&pq, sandbox_request_get_key, &config));
+
+	// A random mix of enqueues and dequeues; both queues must make identical moves
+	size_t next = 0;
+	for (size_t step = 0; step < 3 * count; step++) {
+		if (next < count && next_random_key(&state) % 3 != 0) {
+			sandboxes[next].absolute_deadline = next_random_key(&state) % 1000;
+			TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[next]));
+			TEST_ASSERT_EQUAL_INT(0, request_queue_enqueue(&rq, &sandboxes[next]));
+			next++;
+		} else {
+			struct sandbox_request *expected = priority_queue_dequeue(&pq);
+			struct sandbox_request *actual   = NULL;
+			TEST_ASSERT_EQUAL_INT(expected == NULL ? -1 : 0, request_queue_dequeue(&rq, &actual));
+			TEST_ASSERT_EQUAL_PTR(expected, actual);
+		}
+		TEST_ASSERT_EQUAL_UINT64(pq.min_key, rq.min_key);
+		TEST_ASSERT_EQUAL_UINT(priority_queue_length(&pq), request_queue_length(&rq));
+	}
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < pq.first_free; i++) {
+		TEST_ASSERT_EQUAL_PTR(pq.items[i], rq.items[i]);
+		TEST_ASSERT_EQUAL_UINT64(pq.keys[i], rq.keys[i]);
+	}
+	priority_queue_destroy(&pq);
+}
+
+void
+small_queue_has_the_generated_interface(void)
+{
+	struct small_timer_queue stq;
+	struct timer             out = { 0 };
+	small_timer_queue_initialize(&stq);
+	TEST_ASSERT_TRUE(small_timer_queue_is_empty(&stq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, stq.min_key);
+	TEST_ASSERT_NULL(small_timer_queue_peek(&stq));
+	TEST_ASSERT_EQUAL_INT(-1, small_timer_queue_dequeue(&stq, &out));
+
+	for (int i = 0; i < 32; i++) {
+		struct timer timer = { .deadline = (uint64_t)(i * 7 % 32), .id = i };
+		TEST_ASSERT_EQUAL_INT(0, small_timer_queue_enqueue(&stq, timer));
+	}
+	TEST_ASSERT_TRUE(small_timer_queue_is_full(&stq));
+	TEST_ASSERT_EQUAL_INT(-1, small_timer_queue_enqueue(&stq, (struct timer){ .deadline = 1 }));
+	TEST_ASSERT_EQUAL_UINT64(0, stq.min_key);
+	TEST_ASSERT_EQUAL_INT(0, small_timer_queue_peek(&stq)->id);
+
+	for (uint64_t expected = 0; expected < 32; expected++) {
+		TEST_ASSERT_EQUAL_INT(0, small_timer_queue_dequeue(&stq, &out));
+		TEST_ASSERT_EQUAL_UINT64(expected, out.deadline);
+	}
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, stq.min_key);
+
+	TEST_ASSERT_EQUAL_INT(0, small_timer_queue_enqueue(&stq, (struct timer){ .deadline = 5 }));
+	small_timer_queue_clear(&stq);
+	TEST_ASSERT_TRUE(small_timer_queue_is_empty(&stq));
+}
+
+void
+small_queue_dequeues_the_same_keys_as_the_heap(void)
+{
+	struct small_timer_queue stq;
+	struct timer_heap        th;
+	uint64_t                 state = TEST_RANDOM_SEED;
+	small_timer_queue_initialize(&stq);
+	timer_heap_initialize(&th);
+
+	for (int step = 0; step < 5000; step++) {
+		if (!timer_heap_is_full(&th) && next_random_key(&state) % 2 == 0) {
+			struct timer timer = { .deadline = next_random_key(&state) % 64, .id = step };
+			TEST_ASSERT_EQUAL_INT(0, timer_heap_enqueue(&th, timer));
+			TEST_ASSERT_EQUAL_INT(0, small_timer_queue_enqueue(&stq, timer));
+		} else {
+			struct timer expected = { 0 }, actual = { 0 };
+			int          status = timer_heap_dequeue(&th, &expected);
+			TEST_ASSERT_EQUAL_INT(status, small_timer_queue_dequeue(&stq, &actual));
+			if (status == 0) TEST_ASSERT_EQUAL_UINT64(expected.deadline, actual.deadline);
+		}
+		TEST_ASSERT_EQUAL_UINT64(th.min_key, stq.min_key);
+		TEST_ASSERT_EQUAL_UINT(timer_heap_length(&th), small_timer_queue_length(&stq));
+	}
+}
+
+#ifdef PRIORITY_QUEUE_BHEAP
+void
+bheap_parent_and_child_indices_agree(void)
+{
+	for (size_t i = PRIORITY_QUEUE_ROOT + 1; i < 64 * PRIORITY_QUEUE_BHEAP_PAGE; i++) {
+		size_t parent = priority_queue_parent_index(i);
+		size_t first  = priority_queue_first_child_index(parent);
+		// Children follow their parent, so slots filled in order stay connected
+		TEST_ASSERT_TRUE(parent < i);
+		TEST_ASSERT_TRUE(i >= first && i < first + priority_queue_child_count(parent));
+	}
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_first_child_index(PRIORITY_QUEUE_ROOT));
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_BHEAP_PAGE, priority_queue_first_child_index(PRIORITY_QUEUE_BHEAP_HALF));
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_BHEAP_PAGE + 2, priority_queue_first_child_index(PRIORITY_QUEUE_BHEAP_PAGE));
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_child_count(PRIORITY_QUEUE_BHEAP_PAGE + 1));
+}
+#endif
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_define_test.c");
+	RUN_TEST(initialize_is_empty_with_UINT64_MAX_min_key);
+	RUN_TEST(values_are_stored_by_value_and_dequeued_in_order);
+	RUN_TEST(clear_allows_reuse);
+	RUN_TEST(pointer_instantiation_matches_priority_queue_slot_for_slot);
+	RUN_TEST(small_queue_has_the_generated_interface);
+	RUN_TEST(small_queue_dequeues_the_same_keys_as_the_heap);
+#ifdef PRIORITY_QUEUE_BHEAP
+	RUN_TEST(bheap_parent_and_child_indices_agree);
+#endif
+
+	return UnityEnd();
+}
@@ -0,0 +1,186 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "priority_queue_inbox.h"
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+	void    *inbox_next;
+	int      dequeued;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+struct priority_queue_inbox inbox;
+
+void
+setUp(void)
+{
+	struct priority_queue_config config = { .capacity = 64, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_inbox_initialize_dynamic(&inbox, sandbox_request_get_key,
+	                                                                 offsetof(struct sandbox_request, inbox_next),
+	                                                                 &config));
+}
+
+void
+tearDown(void)
+{
+	priority_queue_inbox_destroy(&inbox);
+}
+
+void
+pushes_reach_the_heap_on_dequeue(void)
+{
+	struct sandbox_request sandboxes[5] = { { .absolute_deadline = 30 },
+		                                { .absolute_deadline = 10 },
+		                                { .absolute_deadline = 50 },
+		                                { .absolute_deadline = 20 },
+		                                { .absolute_deadline = 40 } };
+	for (size_t i = 0; i < 5; i++) priority_queue_inbox_push(&inbox, &sandboxes[i]);
+
+	// Producers never touch the heap
+	TEST_ASSERT_TRUE(priority_queue_is_empty(&inbox.queue));
+	TEST_ASSERT_FALSE(priority_queue_inbox_is_empty(&inbox));
+
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[1], priority_queue_inbox_peek(&inbox));
+	TEST_ASSERT_EQUAL_UINT(5, priority_queue_length(&inbox.queue));
+	uint64_t expected[] = { 10, 20, 30, 40, 50 };
+	for (size_t i = 0; i < 5; i++) {
+		struct sandbox_request *sandbox = priority_queue_inbox_dequeue(&inbox);
+		TEST_ASSERT_EQUAL_UINT64(expected[i], sandbox->absolute_deadline);
+	}
+	TEST_ASSERT_NULL(priority_queue_inbox_dequeue(&inbox));
+	TEST_ASSERT_TRUE(priority_queue_inbox_is_empty(&inbox));
+}
+
+void
+push_batch_publishes_every_value(void)
+{
+	struct sandbox_request sandboxes[200];
+	void                  *values[200];
+	for (size_t i = 0; i < 200; i++) {
+		sandboxes[i].absolute_deadline = 1000 - i;
+		values[i]                      = &sandboxes[i];
+	}
+	priority_queue_inbox_push_batch(&inbox, values, 150);
+	priority_queue_inbox_push_batch(&inbox, &values[150], 50);
+	priority_queue_inbox_push_batch(&inbox, values, 0);
+
+	// Several drain chunks' worth
+	TEST_ASSERT_EQUAL_UINT(200, priority_queue_inbox_drain(&inbox));
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_inbox_drain(&inbox));
+	for (size_t i = 0; i < 200; i++) {
+		struct sandbox_request *sandbox = priority_queue_inbox_dequeue(&inbox);
+		TEST_ASSERT_EQUAL_UINT64(801 + i, sandbox->absolute_deadline);
+	}
+}
+
+void
+full_heap_keeps_the_rest_pending(void)
+{
+	priority_queue_inbox_destroy(&inbox);
+	struct priority_queue_config config = { .capacity = 4, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_inbox_initialize_dynamic(&inbox, sandbox_request_get_key,
+	                                                                 offsetof(struct sandbox_request, inbox_next),
+	                                                                 &config));
+
+	struct sandbox_request sandboxes[7];
+	for (size_t i = 0; i < 7; i++) {
+		sandboxes[i].absolute_deadline = 10 * (i + 1);
+		priority_queue_inbox_push(&inbox, &sandboxes[i]);
+	}
+	TEST_ASSERT_EQUAL_UINT(4, priority_queue_inbox_drain(&inbox));
+	TEST_ASSERT_TRUE(priority_queue_is_full(&inbox.queue));
+	TEST_ASSERT_NOT_NULL(inbox.pending);
+
+	// Each dequeue frees a slot that the next drain refills from pending
+	size_t dequeued = 0;
+	while (priority_queue_inbox_dequeue(&inbox) != NULL) dequeued++;
+	TEST_ASSERT_EQUAL_UINT(7, dequeued);
+	TEST_ASSERT_TRUE(priority_queue_inbox_is_empty(&inbox));
+}
+
+enum
+{
+	producer_count     = 4,
+	items_per_producer = 5000
+};
+
+static struct sandbox_request stress_requests[producer_count][items_per_producer];
+
+static void *
+stress_producer(void *arg)
+{
+	struct sandbox_request *requests = arg;
+	for (size_t i = 0; i < items_per_producer; i += 2) {
+		if (i % 10 == 0) {
+			void *values[] = { &requests[i], &requests[i + 1] };
+			priority_queue_inbox_push_batch(&inbox, values, 2);
+		} else {
+			priority_queue_inbox_push(&inbox, &requests[i]);
+			priority_queue_inbox_push(&inbox, &requests[i + 1]);
+		}
+	}
+	return NULL;
+}
+
+void
+many_producers_one_consumer_deliver_every_element_once(void)
+{
+	priority_queue_inbox_destroy(&inbox);
+	struct priority_queue_config config = { .capacity = 64, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_inbox_initialize_dynamic(&inbox, sandbox_request_get_key,
+	                                                                 offsetof(struct sandbox_request, inbox_next),
+	                                                                 &config));
+
+	uint64_t state = 7;
+	for (size_t p = 0; p < producer_count; p++) {
+		for (size_t i = 0; i < items_per_producer; i++) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			stress_requests[p][i].absolute_deadline = state % 1000000;
+			stress_requests[p][i].dequeued          = 0;
+		}
+	}
+
+	pthread_t threads[producer_count];
+	for (size_t p = 0; p < producer_count; p++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[p], NULL, stress_producer, stress_requests[p]));
+	}
+
+	size_t total = 0;
+	while (total < producer_count * items_per_producer) {
+		struct sandbox_request *sandbox = priority_queue_inbox_dequeue(&inbox);
+		if (sandbox == NULL) {
+			sched_yield();
+			continue;
+		}
+		TEST_ASSERT_EQUAL_INT(0, sandbox->dequeued++);
+		total++;
+	}
+	for (size_t p = 0; p < producer_count; p++) pthread_join(threads[p], NULL);
+
+	TEST_ASSERT_TRUE(priority_queue_inbox_is_empty(&inbox));
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_inbox_test.c");
+	RUN_TEST(pushes_reach_the_heap_on_dequeue);
+	RUN_TEST(push_batch_publishes_every_value);
+	RUN_TEST(full_heap_keeps_the_rest_pending);
+	RUN_TEST(many_producers_one_consumer_deliver_every_element_once);
+
+	return UnityEnd();
+}
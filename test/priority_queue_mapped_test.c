@@ -0,0 +1,365 @@
+/* mkstemp, ftruncate, mmap and fork */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "vendor/unity.h"
+#include "test_random.h"
+#include "priority_queue_mapped.h"
+
+#define CAPACITY    256
+#define REGION_SIZE (64 * 1024)
+
+/* Elements are laid out as an array of struct sandbox_request */
+#define ELEMENT_SIZE sizeof(struct sandbox_request)
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+	uint64_t id;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+static int   region_fd;
+static void *region;
+
+static void *
+map_region(void)
+{
+	void *base = mmap(NULL, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, region_fd, 0);
+	TEST_ASSERT_TRUE(base != MAP_FAILED);
+	return base;
+}
+
+/* The element area follows the queue; elements are laid out as an array there */
+static struct sandbox_request *
+elements_of(void *base)
+{
+	return (struct sandbox_request *)((char *)base + priority_queue_mapped_size(CAPACITY));
+}
+
+/* Attaches with the element size and key of this test's elements */
+static int
+attach(struct priority_queue_mapped *queue, void *base, size_t region_size)
+{
+	return priority_queue_mapped_attach(queue, base, region_size, ELEMENT_SIZE, sandbox_request_get_key);
+}
+
+/* Fills the queue with count elements with pseudo-random keys */
+static void
+fill(struct priority_queue_mapped *queue, size_t count)
+{
+	struct sandbox_request *sandboxes = elements_of(queue->base);
+	uint64_t                state     = TEST_RANDOM_SEED;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i] = (struct sandbox_request){ .absolute_deadline = next_random_key(&state) % 1000, .id = i };
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_enqueue(queue, &sandboxes[i]));
+	}
+}
+
+/* Dequeues up to count elements, checking key order, and returns the last key */
+static uint64_t
+drain(struct priority_queue_mapped *queue, size_t count, uint64_t last)
+{
+	for (size_t i = 0; i < count; i++) {
+		struct sandbox_request *sandbox = priority_queue_mapped_dequeue(queue);
+		TEST_ASSERT_NOT_NULL(sandbox);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		TEST_ASSERT_TRUE((char *)sandbox >= (char *)elements_of(queue->base));
+		last = sandbox->absolute_deadline;
+	}
+	return last;
+}
+
+void
+setUp(void)
+{
+	char path[] = "/tmp/priority_queue_mapped_test.XXXXXX";
+	region_fd   = mkstemp(path);
+	TEST_ASSERT_TRUE(region_fd >= 0);
+	unlink(path);
+	TEST_ASSERT_EQUAL_INT(0, ftruncate(region_fd, REGION_SIZE));
+	region = map_region();
+}
+
+void
+tearDown(void)
+{
+	munmap(region, REGION_SIZE);
+	close(region_fd);
+}
+
+void
+create_rejects_regions_that_cannot_hold_the_queue(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_mapped_create(&mpq, region, REGION_SIZE, 0, ELEMENT_SIZE,
+	                                                       sandbox_request_get_key));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_mapped_create(&mpq, region, priority_queue_mapped_size(CAPACITY) - 1,
+	                                                       CAPACITY, ELEMENT_SIZE, sandbox_request_get_key));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_mapped_create(&mpq, (char *)region + 4, REGION_SIZE - 4, CAPACITY,
+	                                                       ELEMENT_SIZE, sandbox_request_get_key));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY, 0,
+	                                                       sandbox_request_get_key));
+	// Room for the queue but not for a single element
+	size_t no_element_room = priority_queue_mapped_size(CAPACITY) + ELEMENT_SIZE - 1;
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_mapped_create(&mpq, region, no_element_room, CAPACITY, ELEMENT_SIZE,
+	                                                       sandbox_request_get_key));
+	TEST_ASSERT_EQUAL_UINT64(SIZE_MAX, priority_queue_mapped_size(SIZE_MAX));
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_empty(&mpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, mpq.header->min_key);
+	TEST_ASSERT_NULL(priority_queue_mapped_peek(&mpq));
+	TEST_ASSERT_NULL(priority_queue_mapped_dequeue(&mpq));
+}
+
+void
+enqueue_rejects_elements_outside_the_element_area_and_when_full(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+	struct sandbox_request outside = { .absolute_deadline = 1 };
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_OUTSIDE, priority_queue_mapped_enqueue(&mpq, &outside));
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_OUTSIDE, priority_queue_mapped_enqueue(&mpq, mpq.keys));
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_OUTSIDE,
+	                      priority_queue_mapped_enqueue(&mpq, (char *)region + REGION_SIZE));
+
+	fill(&mpq, CAPACITY);
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_full(&mpq));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_mapped_enqueue(&mpq, elements_of(region)));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_verify(&mpq));
+	drain(&mpq, CAPACITY, 0);
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_empty(&mpq));
+}
+
+void
+enqueue_rejects_an_element_that_straddles_the_end_of_the_region(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+
+	// Starts inside the region but its last bytes would lie past the end
+	char *straddling = (char *)region + REGION_SIZE - ELEMENT_SIZE / 2;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_OUTSIDE, priority_queue_mapped_enqueue(&mpq, straddling));
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_empty(&mpq));
+
+	// The last element that fits ends exactly at the end of the region
+	struct sandbox_request *last = (struct sandbox_request *)((char *)region + REGION_SIZE - ELEMENT_SIZE);
+	last->absolute_deadline      = 7;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_enqueue(&mpq, last));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_verify(&mpq));
+
+	// verify applies the same bound to offsets already in the slots
+	mpq.offsets[PRIORITY_QUEUE_ROOT] += ELEMENT_SIZE / 2;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, priority_queue_mapped_verify(&mpq));
+	mpq.offsets[PRIORITY_QUEUE_ROOT] -= ELEMENT_SIZE / 2;
+	TEST_ASSERT_EQUAL_PTR(last, priority_queue_mapped_dequeue(&mpq));
+}
+
+void
+queue_resumes_after_remapping_and_at_another_address(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+	fill(&mpq, 200);
+	uint64_t last = drain(&mpq, 50, 0);
+
+	// A restart: the mapping goes away and comes back, possibly elsewhere
+	munmap(region, REGION_SIZE);
+	region = map_region();
+	TEST_ASSERT_EQUAL_INT(0, attach(&mpq, region, REGION_SIZE));
+	TEST_ASSERT_EQUAL_UINT(150, priority_queue_mapped_length(&mpq));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_verify(&mpq));
+	last = drain(&mpq, 50, last);
+
+	// A copy at a certainly different address holds the same queue
+	uint64_t *copy = malloc(REGION_SIZE);
+	TEST_ASSERT_NOT_NULL(copy);
+	memcpy(copy, region, REGION_SIZE);
+	struct priority_queue_mapped copied;
+	TEST_ASSERT_EQUAL_INT(0, attach(&copied, copy, REGION_SIZE));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_verify(&copied));
+	for (size_t i = 0; i < 100; i++) {
+		struct sandbox_request *original = priority_queue_mapped_dequeue(&mpq);
+		struct sandbox_request *moved    = priority_queue_mapped_dequeue(&copied);
+		TEST_ASSERT_TRUE(original->absolute_deadline >= last);
+		TEST_ASSERT_EQUAL_UINT64(original->id, moved->id);
+		TEST_ASSERT_EQUAL_PTR((char *)copy + ((char *)original - (char *)region), moved);
+		last = original->absolute_deadline;
+	}
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_empty(&mpq));
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_empty(&copied));
+	free(copy);
+}
+
+void
+sibling_process_resumes_the_queue(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+	fill(&mpq, 100);
+
+	pid_t pid = fork();
+	TEST_ASSERT_TRUE(pid >= 0);
+	if (pid == 0) {
+		// The child maps the file on its own and takes the 40 earliest elements
+		void                        *child_region = map_region();
+		struct priority_queue_mapped child;
+		if (attach(&child, child_region, REGION_SIZE) != 0) _exit(1);
+		for (size_t i = 0; i < 40; i++) {
+			if (priority_queue_mapped_dequeue(&child) == NULL) _exit(2);
+		}
+		_exit(0);
+	}
+	int status;
+	TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+	TEST_ASSERT_TRUE(WIFEXITED(status));
+	TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+
+	TEST_ASSERT_EQUAL_INT(0, attach(&mpq, region, REGION_SIZE));
+	TEST_ASSERT_EQUAL_UINT(60, priority_queue_mapped_length(&mpq));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_verify(&mpq));
+	drain(&mpq, 60, 0);
+}
+
+void
+attach_rejects_regions_that_must_not_be_trusted(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_BAD_MAGIC, attach(&mpq, region, REGION_SIZE));
+	TEST_ASSERT_EQUAL_INT(-1, attach(&mpq, region, 8));
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+	fill(&mpq, 10);
+	struct priority_queue_mapped_header *header = region;
+	struct priority_queue_mapped_header  saved  = *header;
+
+	header->version++;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_INCOMPATIBLE, attach(&mpq, region, REGION_SIZE));
+	*header = saved;
+	header->arity *= 2;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_INCOMPATIBLE, attach(&mpq, region, REGION_SIZE));
+	*header = saved;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_INCOMPATIBLE,
+	                      priority_queue_mapped_attach(&mpq, region, REGION_SIZE, ELEMENT_SIZE + 8,
+	                                                   sandbox_request_get_key));
+
+	// A writer that died between begin and end leaves the generation odd
+	*header = saved;
+	header->generation++;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_TORN, attach(&mpq, region, REGION_SIZE));
+
+	*header = saved;
+	header->first_free += 3;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, attach(&mpq, region, REGION_SIZE));
+
+	// A valid header for a larger mapping than the one at hand
+	*header = saved;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, attach(&mpq, region, REGION_SIZE / 2));
+
+	*header = saved;
+	TEST_ASSERT_EQUAL_INT(0, attach(&mpq, region, REGION_SIZE));
+	drain(&mpq, 10, 0);
+}
+
+void
+verify_detects_damaged_slots(void)
+{
+	struct priority_queue_mapped mpq;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY,
+	                                                      ELEMENT_SIZE, sandbox_request_get_key));
+	fill(&mpq, 100);
+	size_t leaf = PRIORITY_QUEUE_ROOT + 99;
+
+	uint64_t saved_offset = mpq.offsets[leaf];
+	mpq.offsets[leaf]     = 0;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, priority_queue_mapped_verify(&mpq));
+	mpq.offsets[leaf] = REGION_SIZE;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, priority_queue_mapped_verify(&mpq));
+	mpq.offsets[leaf] = saved_offset;
+
+	// An element whose key changed behind the queue's back
+	struct sandbox_request *sandbox = (struct sandbox_request *)(mpq.base + saved_offset);
+	sandbox->absolute_deadline++;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, priority_queue_mapped_verify(&mpq));
+	sandbox->absolute_deadline--;
+
+	uint64_t saved_key = mpq.keys[leaf];
+	mpq.keys[leaf]     = 0;
+	sandbox->absolute_deadline = 0;
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_MAPPED_CORRUPT, priority_queue_mapped_verify(&mpq));
+	mpq.keys[leaf]             = saved_key;
+	sandbox->absolute_deadline = saved_key;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_verify(&mpq));
+
+	priority_queue_mapped_clear(&mpq);
+	TEST_ASSERT_TRUE(priority_queue_mapped_is_empty(&mpq));
+	TEST_ASSERT_EQUAL_INT(0, attach(&mpq, region, REGION_SIZE));
+}
+
+/* The mapped queue keeps its own sifts over offsets[], so check they make the
+ * same moves as struct priority_queue */
+void
+queue_matches_priority_queue_slot_for_slot(void)
+{
+	struct priority_queue_mapped mpq;
+	struct priority_queue        pq;
+	struct priority_queue_config config = { .capacity = CAPACITY, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_create(&mpq, region, REGION_SIZE, CAPACITY, ELEMENT_SIZE,
+	                                                      sandbox_request_get_key));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_initialize_dynamic(&pq, sandbox_request_get_key, &config));
+
+	struct sandbox_request *sandboxes = elements_of(region);
+	uint64_t                state     = TEST_RANDOM_SEED;
+	size_t                  next      = 0;
+	for (size_t step = 0; step < 3 * CAPACITY; step++) {
+		if (next < CAPACITY && next_random_key(&state) % 3 != 0) {
+			sandboxes[next].absolute_deadline = next_random_key(&state) % 100;
+			TEST_ASSERT_EQUAL_INT(0, priority_queue_mapped_enqueue(&mpq, &sandboxes[next]));
+			TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[next]));
+			next++;
+		} else {
+			TEST_ASSERT_EQUAL_PTR(priority_queue_dequeue(&pq), priority_queue_mapped_dequeue(&mpq));
+		}
+		TEST_ASSERT_EQUAL_UINT64(pq.first_free, mpq.header->first_free);
+	}
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < pq.first_free; i++) {
+		TEST_ASSERT_EQUAL_UINT64(pq.keys[i], mpq.keys[i]);
+		TEST_ASSERT_EQUAL_PTR(pq.items[i], mpq.base + mpq.offsets[i]);
+	}
+	priority_queue_destroy(&pq);
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_mapped_test.c");
+	RUN_TEST(create_rejects_regions_that_cannot_hold_the_queue);
+	RUN_TEST(enqueue_rejects_elements_outside_the_element_area_and_when_full);
+	RUN_TEST(enqueue_rejects_an_element_that_straddles_the_end_of_the_region);
+	RUN_TEST(queue_resumes_after_remapping_and_at_another_address);
+	RUN_TEST(sibling_process_resumes_the_queue);
+	RUN_TEST(attach_rejects_regions_that_must_not_be_trusted);
+	RUN_TEST(verify_detects_damaged_slots);
+	RUN_TEST(queue_matches_priority_queue_slot_for_slot);
+
+	return UnityEnd();
+}
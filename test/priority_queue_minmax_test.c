@@ -0,0 +1,173 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "test_random.h"
+#include "priority_queue_minmax.h"
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+#define CAPACITY 1000
+
+struct priority_queue_minmax mmpq;
+
+void
+setUp(void)
+{
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_minmax_initialize(&mmpq, sandbox_request_get_key, CAPACITY));
+}
+
+void
+tearDown(void)
+{
+	priority_queue_minmax_destroy(&mmpq);
+}
+
+/* Checks that min_key and max_key match a brute-force scan of the queued keys */
+static void
+assert_cached_keys(void)
+{
+	uint64_t min = UINT64_MAX, max = 0;
+	for (size_t i = 1; i < mmpq.first_free; i++) {
+		if (mmpq.keys[i] < min) min = mmpq.keys[i];
+		if (mmpq.keys[i] > max) max = mmpq.keys[i];
+	}
+	TEST_ASSERT_EQUAL_UINT64(min, mmpq.min_key);
+	TEST_ASSERT_EQUAL_UINT64(max, mmpq.max_key);
+}
+
+void
+initialize_rejects_zero_capacity_and_starts_empty(void)
+{
+	struct priority_queue_minmax queue;
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_minmax_initialize(&queue, sandbox_request_get_key, 0));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_minmax_initialize(&queue, sandbox_request_get_key, SIZE_MAX));
+
+	TEST_ASSERT_TRUE(priority_queue_minmax_is_empty(&mmpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, mmpq.min_key);
+	TEST_ASSERT_EQUAL_UINT64(0, mmpq.max_key);
+	TEST_ASSERT_NULL(priority_queue_minmax_peek(&mmpq));
+	TEST_ASSERT_NULL(priority_queue_minmax_peek_max(&mmpq));
+	TEST_ASSERT_NULL(priority_queue_minmax_dequeue(&mmpq));
+	TEST_ASSERT_NULL(priority_queue_minmax_dequeue_max(&mmpq));
+}
+
+void
+both_ends_drain_random_keys_in_order(void)
+{
+	static struct sandbox_request sandboxes[CAPACITY];
+	uint64_t                      state = TEST_RANDOM_SEED;
+	for (size_t i = 0; i < CAPACITY; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 500;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_minmax_enqueue(&mmpq, &sandboxes[i]));
+		assert_cached_keys();
+	}
+	struct sandbox_request extra = { .absolute_deadline = 1 };
+	TEST_ASSERT_TRUE(priority_queue_minmax_is_full(&mmpq));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_minmax_enqueue(&mmpq, &extra));
+
+	// Alternate ends: the smallest keys rise and the largest fall until they meet
+	uint64_t low = 0, high = UINT64_MAX;
+	for (size_t i = 0; i < CAPACITY; i++) {
+		bool                    from_max = i % 3 == 0;
+		struct sandbox_request *peeked   = from_max ? priority_queue_minmax_peek_max(&mmpq)
+		                                            : priority_queue_minmax_peek(&mmpq);
+		struct sandbox_request *sandbox  = from_max ? priority_queue_minmax_dequeue_max(&mmpq)
+		                                            : priority_queue_minmax_dequeue(&mmpq);
+		TEST_ASSERT_EQUAL_PTR(peeked, sandbox);
+		if (from_max) {
+			TEST_ASSERT_TRUE(sandbox->absolute_deadline <= high);
+			high = sandbox->absolute_deadline;
+		} else {
+			TEST_ASSERT_TRUE(sandbox->absolute_deadline >= low);
+			low = sandbox->absolute_deadline;
+		}
+		TEST_ASSERT_TRUE(low <= high);
+		assert_cached_keys();
+	}
+	TEST_ASSERT_TRUE(priority_queue_minmax_is_empty(&mmpq));
+}
+
+void
+enqueue_or_evict_sheds_the_latest_deadline(void)
+{
+	struct priority_queue_minmax queue;
+	struct sandbox_request       sandboxes[5] = { { 50 }, { 10 }, { 40 }, { 5 }, { 40 } };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_minmax_initialize(&queue, sandbox_request_get_key, 3));
+
+	// Not full: nothing is shed
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_NULL(priority_queue_minmax_enqueue_or_evict(&queue, &sandboxes[i]));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_minmax_peek_max(&queue));
+
+	// An earlier deadline replaces the latest one, even when it is the new minimum
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_minmax_enqueue_or_evict(&queue, &sandboxes[3]));
+	TEST_ASSERT_EQUAL_UINT64(5, queue.min_key);
+	TEST_ASSERT_EQUAL_UINT64(40, queue.max_key);
+
+	// A tie with the maximum, or anything later, is shed itself
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[4], priority_queue_minmax_enqueue_or_evict(&queue, &sandboxes[4]));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_minmax_enqueue_or_evict(&queue, &sandboxes[0]));
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_minmax_length(&queue));
+
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[3], priority_queue_minmax_dequeue(&queue));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[1], priority_queue_minmax_dequeue(&queue));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[2], priority_queue_minmax_dequeue(&queue));
+	priority_queue_minmax_destroy(&queue);
+
+	// With room for one element the root is also the maximum
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_minmax_initialize(&queue, sandbox_request_get_key, 1));
+	TEST_ASSERT_NULL(priority_queue_minmax_enqueue_or_evict(&queue, &sandboxes[0]));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_minmax_enqueue_or_evict(&queue, &sandboxes[1]));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[1], priority_queue_minmax_peek(&queue));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[1], priority_queue_minmax_peek_max(&queue));
+	priority_queue_minmax_destroy(&queue);
+}
+
+void
+overload_keeps_the_earliest_deadlines(void)
+{
+	enum { offered = 20000 };
+	static struct sandbox_request sandboxes[offered];
+	static unsigned               kept[offered];
+	uint64_t                      state = 7;
+	size_t                        shed  = 0;
+	for (size_t i = 0; i < offered; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % offered;
+		if (priority_queue_minmax_enqueue_or_evict(&mmpq, &sandboxes[i]) != NULL) shed++;
+		if (i % 97 == 0) assert_cached_keys();
+	}
+	TEST_ASSERT_EQUAL_UINT(offered - CAPACITY, shed);
+
+	// Counting sort of every offered key gives the CAPACITY earliest ones
+	for (size_t i = 0; i < offered; i++) kept[sandboxes[i].absolute_deadline]++;
+	uint64_t expected = 0;
+	for (size_t i = 0; i < CAPACITY; i++) {
+		while (kept[expected] == 0) expected++;
+		kept[expected]--;
+		struct sandbox_request *sandbox = priority_queue_minmax_dequeue(&mmpq);
+		TEST_ASSERT_EQUAL_UINT64(expected, sandbox->absolute_deadline);
+	}
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_minmax_test.c");
+	RUN_TEST(initialize_rejects_zero_capacity_and_starts_empty);
+	RUN_TEST(both_ends_drain_random_keys_in_order);
+	RUN_TEST(enqueue_or_evict_sheds_the_latest_deadline);
+	RUN_TEST(overload_keeps_the_earliest_deadlines);
+
+	return UnityEnd();
+}
@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vendor/unity.h"
+#include "priority_queue_multiclass.h"
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+#define CLASS_CAPACITY 16
+
+struct priority_queue            classes[PRIORITY_QUEUE_MULTICLASS_MAX];
+struct priority_queue_multiclass mcpq;
+
+void
+setUp(void)
+{
+	struct priority_queue_config config = { .capacity = CLASS_CAPACITY, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	for (size_t i = 0; i < PRIORITY_QUEUE_MULTICLASS_MAX; i++) {
+		int status = priority_queue_initialize_dynamic(&classes[i], sandbox_request_get_key, &config);
+		TEST_ASSERT_EQUAL_INT(0, status);
+	}
+}
+
+void
+tearDown(void)
+{
+	for (size_t i = 0; i < PRIORITY_QUEUE_MULTICLASS_MAX; i++) priority_queue_destroy(&classes[i]);
+}
+
+void
+strict_priority_between_classes_and_deadline_order_within(void)
+{
+	priority_queue_multiclass_initialize(&mcpq, classes, 3, 0);
+	TEST_ASSERT_TRUE(priority_queue_multiclass_is_empty(&mcpq));
+	TEST_ASSERT_NULL(priority_queue_multiclass_dequeue(&mcpq));
+	TEST_ASSERT_EQUAL_UINT(SIZE_MAX, priority_queue_multiclass_next_class(&mcpq));
+
+	struct sandbox_request batch[] = { { 5 }, { 1 }, { 3 } }, interactive[] = { { 50 }, { 40 } };
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 1, &batch[i]));
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_multiclass_next_class(&mcpq));
+	for (size_t i = 0; i < 2; i++) {
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 0, &interactive[i]));
+	}
+	TEST_ASSERT_EQUAL_UINT64(0x3, mcpq.nonempty);
+	TEST_ASSERT_EQUAL_UINT64(40, priority_queue_multiclass_min_key(&mcpq, 0));
+	TEST_ASSERT_EQUAL_UINT64(1, priority_queue_multiclass_min_key(&mcpq, 1));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_multiclass_min_key(&mcpq, 2));
+
+	// Class 0 goes first even though class 1 has earlier deadlines
+	struct sandbox_request *expected[] = { &interactive[1], &interactive[0], &batch[1], &batch[2], &batch[0] };
+	for (size_t i = 0; i < 5; i++) {
+		TEST_ASSERT_EQUAL_PTR(expected[i], priority_queue_multiclass_peek(&mcpq));
+		TEST_ASSERT_EQUAL_PTR(expected[i], priority_queue_multiclass_dequeue(&mcpq));
+	}
+	TEST_ASSERT_TRUE(priority_queue_multiclass_is_empty(&mcpq));
+	TEST_ASSERT_NULL(priority_queue_multiclass_peek(&mcpq));
+}
+
+void
+bitmap_covers_all_sixty_four_classes(void)
+{
+	priority_queue_multiclass_initialize(&mcpq, classes, PRIORITY_QUEUE_MULTICLASS_MAX, 0);
+
+	struct sandbox_request requests[PRIORITY_QUEUE_MULTICLASS_MAX];
+	for (size_t i = PRIORITY_QUEUE_MULTICLASS_MAX; i-- > 0;) {
+		requests[i].absolute_deadline = PRIORITY_QUEUE_MULTICLASS_MAX - i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, i, &requests[i]));
+		TEST_ASSERT_EQUAL_UINT(i, priority_queue_multiclass_next_class(&mcpq));
+	}
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, mcpq.nonempty);
+	for (size_t i = 0; i < PRIORITY_QUEUE_MULTICLASS_MAX; i++) {
+		TEST_ASSERT_EQUAL_PTR(&requests[i], priority_queue_multiclass_dequeue(&mcpq));
+	}
+	TEST_ASSERT_EQUAL_UINT64(0, mcpq.nonempty);
+
+	// A full class reports the failure and leaves the bitmap alone
+	struct sandbox_request filler = { 7 };
+	for (size_t i = 0; i < CLASS_CAPACITY; i++) {
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 63, &filler));
+	}
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_multiclass_enqueue(&mcpq, 63, &filler));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_C(1) << 63, mcpq.nonempty);
+}
+
+void
+aging_serves_a_starving_class(void)
+{
+	priority_queue_multiclass_initialize(&mcpq, classes, 3, 3);
+
+	struct sandbox_request interactive[8], best_effort = { 0 };
+	for (size_t i = 0; i < 8; i++) {
+		interactive[i].absolute_deadline = 100 + i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 0, &interactive[i]));
+	}
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 2, &best_effort));
+
+	// Three dequeues pass class 2 over; the fourth serves it, then class 0 resumes
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_PTR(&interactive[i], priority_queue_multiclass_dequeue(&mcpq));
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_multiclass_next_class(&mcpq));
+	TEST_ASSERT_EQUAL_PTR(&best_effort, priority_queue_multiclass_dequeue(&mcpq));
+	for (size_t i = 3; i < 8; i++) TEST_ASSERT_EQUAL_PTR(&interactive[i], priority_queue_multiclass_dequeue(&mcpq));
+	TEST_ASSERT_TRUE(priority_queue_multiclass_is_empty(&mcpq));
+
+	// Without aging the low class waits until the high class drains
+	priority_queue_multiclass_initialize(&mcpq, classes, 3, 0);
+	for (size_t i = 0; i < 8; i++) {
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 0, &interactive[i]));
+	}
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_multiclass_enqueue(&mcpq, 2, &best_effort));
+	for (size_t i = 0; i < 8; i++) TEST_ASSERT_EQUAL_PTR(&interactive[i], priority_queue_multiclass_dequeue(&mcpq));
+	TEST_ASSERT_EQUAL_PTR(&best_effort, priority_queue_multiclass_dequeue(&mcpq));
+}
+
+void
+refresh_tracks_direct_changes_to_a_class(void)
+{
+	struct sandbox_request early = { 10 }, late = { 20 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&classes[1], &late));
+
+	// Classes that already hold elements are picked up at initialization
+	priority_queue_multiclass_initialize(&mcpq, classes, 2, 0);
+	TEST_ASSERT_EQUAL_UINT64(0x2, mcpq.nonempty);
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&classes[0], &early));
+	priority_queue_multiclass_refresh(&mcpq, 0);
+	TEST_ASSERT_EQUAL_UINT64(0x3, mcpq.nonempty);
+
+	TEST_ASSERT_EQUAL_PTR(&late, priority_queue_dequeue(&classes[1]));
+	priority_queue_multiclass_refresh(&mcpq, 1);
+	TEST_ASSERT_EQUAL_UINT64(0x1, mcpq.nonempty);
+
+	TEST_ASSERT_EQUAL_PTR(&early, priority_queue_multiclass_dequeue(&mcpq));
+	TEST_ASSERT_NULL(priority_queue_multiclass_dequeue(&mcpq));
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_multiclass_test.c");
+	RUN_TEST(strict_priority_between_classes_and_deadline_order_within);
+	RUN_TEST(bitmap_covers_all_sixty_four_classes);
+	RUN_TEST(aging_serves_a_starving_class);
+	RUN_TEST(refresh_tracks_direct_changes_to_a_class);
+
+	return UnityEnd();
+}
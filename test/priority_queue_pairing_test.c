@@ -0,0 +1,205 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "test_random.h"
+#include "priority_queue_pairing.h"
+
+struct sandbox_request {
+	uint64_t                           absolute_deadline;
+	struct priority_queue_pairing_node pq_node;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+struct priority_queue_pairing ppq;
+
+static void
+initialize_pairing(struct priority_queue_pairing *queue)
+{
+	priority_queue_pairing_initialize(queue, sandbox_request_get_key, offsetof(struct sandbox_request, pq_node));
+}
+
+void
+setUp(void)
+{
+	initialize_pairing(&ppq);
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+assert_drains_in_order(struct priority_queue_pairing *queue, size_t expected_length)
+{
+	TEST_ASSERT_EQUAL_UINT(expected_length, priority_queue_pairing_length(queue));
+	uint64_t last = 0;
+	while (!priority_queue_pairing_is_empty(queue)) {
+		struct sandbox_request *peeked = priority_queue_pairing_peek(queue);
+		TEST_ASSERT_EQUAL_UINT64(peeked->absolute_deadline, queue->min_key);
+		struct sandbox_request *sandbox = priority_queue_pairing_dequeue(queue);
+		TEST_ASSERT_EQUAL_PTR(peeked, sandbox);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		last = sandbox->absolute_deadline;
+		expected_length--;
+	}
+	TEST_ASSERT_EQUAL_UINT(0, expected_length);
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, queue->min_key);
+	TEST_ASSERT_NULL(priority_queue_pairing_dequeue(queue));
+}
+
+void
+initialize_is_empty_with_UINT64_MAX_min_key(void)
+{
+	TEST_ASSERT_TRUE(priority_queue_pairing_is_empty(&ppq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, ppq.min_key);
+	TEST_ASSERT_NULL(priority_queue_pairing_peek(&ppq));
+	TEST_ASSERT_NULL(priority_queue_pairing_dequeue(&ppq));
+}
+
+void
+random_keys_drain_in_order_without_a_capacity_limit(void)
+{
+	enum { count = 100000 };
+	static struct sandbox_request sandboxes[count];
+	uint64_t                      state = TEST_RANDOM_SEED;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 50000;
+		priority_queue_pairing_enqueue(&ppq, &sandboxes[i]);
+	}
+	assert_drains_in_order(&ppq, count);
+}
+
+void
+meld_moves_every_element_and_empties_the_source(void)
+{
+	static struct sandbox_request sandboxes[200];
+	struct priority_queue_pairing other;
+	initialize_pairing(&other);
+	for (size_t i = 0; i < 200; i++) {
+		sandboxes[i].absolute_deadline = (i * 37) % 200;
+		priority_queue_pairing_enqueue(i % 2 == 0 ? &ppq : &other, &sandboxes[i]);
+	}
+
+	priority_queue_pairing_meld(&ppq, &other);
+	TEST_ASSERT_TRUE(priority_queue_pairing_is_empty(&other));
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_pairing_length(&other));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, other.min_key);
+	TEST_ASSERT_EQUAL_UINT64(0, ppq.min_key);
+	assert_drains_in_order(&ppq, 200);
+
+	// Melding an empty heap, in either direction, changes nothing
+	struct sandbox_request sandbox = { .absolute_deadline = 9 };
+	priority_queue_pairing_enqueue(&other, &sandbox);
+	priority_queue_pairing_meld(&ppq, &other);
+	priority_queue_pairing_meld(&ppq, &other);
+	TEST_ASSERT_EQUAL_UINT64(9, ppq.min_key);
+	assert_drains_in_order(&ppq, 1);
+}
+
+void
+update_key_moves_element_both_ways(void)
+{
+	static struct sandbox_request sandboxes[64];
+	for (size_t i = 0; i < 64; i++) {
+		sandboxes[i].absolute_deadline = 100 + i;
+		priority_queue_pairing_enqueue(&ppq, &sandboxes[i]);
+	}
+	// Dequeue once so the heap has some depth
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_pairing_dequeue(&ppq));
+
+	sandboxes[40].absolute_deadline = 1;
+	priority_queue_pairing_update_key(&ppq, &sandboxes[40]);
+	TEST_ASSERT_EQUAL_UINT64(1, ppq.min_key);
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[40], priority_queue_pairing_peek(&ppq));
+
+	sandboxes[40].absolute_deadline = 1000;
+	priority_queue_pairing_update_key(&ppq, &sandboxes[40]);
+	TEST_ASSERT_EQUAL_UINT64(101, ppq.min_key);
+	assert_drains_in_order(&ppq, 63);
+}
+
+void
+remove_takes_out_root_and_inner_elements(void)
+{
+	static struct sandbox_request sandboxes[32];
+	for (size_t i = 0; i < 32; i++) {
+		sandboxes[i].absolute_deadline = i;
+		priority_queue_pairing_enqueue(&ppq, &sandboxes[i]);
+	}
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_pairing_dequeue(&ppq));
+
+	priority_queue_pairing_remove(&ppq, &sandboxes[1]);
+	TEST_ASSERT_EQUAL_UINT64(2, ppq.min_key);
+	priority_queue_pairing_remove(&ppq, &sandboxes[17]);
+	priority_queue_pairing_remove(&ppq, &sandboxes[31]);
+	TEST_ASSERT_EQUAL_UINT(28, priority_queue_pairing_length(&ppq));
+
+	for (size_t i = 2; i < 31; i++) {
+		if (i == 17) continue;
+		TEST_ASSERT_EQUAL_PTR(&sandboxes[i], priority_queue_pairing_dequeue(&ppq));
+	}
+	TEST_ASSERT_TRUE(priority_queue_pairing_is_empty(&ppq));
+}
+
+void
+random_removes_and_updates_keep_order(void)
+{
+	enum { count = 2000 };
+	static struct sandbox_request sandboxes[count];
+	static bool                   queued[count];
+	uint64_t                      state = 42;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 10000;
+		priority_queue_pairing_enqueue(&ppq, &sandboxes[i]);
+		queued[i] = true;
+	}
+
+	size_t length = count;
+	for (size_t step = 0; step < 3000; step++) {
+		size_t i = next_random_key(&state) % count;
+		switch (next_random_key(&state) % 3) {
+		case 0:
+			if (!queued[i]) break;
+			priority_queue_pairing_remove(&ppq, &sandboxes[i]);
+			queued[i] = false;
+			length--;
+			break;
+		case 1:
+			if (!queued[i]) break;
+			sandboxes[i].absolute_deadline = next_random_key(&state) % 10000;
+			priority_queue_pairing_update_key(&ppq, &sandboxes[i]);
+			break;
+		default: {
+			struct sandbox_request *sandbox = priority_queue_pairing_dequeue(&ppq);
+			if (sandbox == NULL) break;
+			queued[sandbox - sandboxes] = false;
+			length--;
+		}
+		}
+	}
+	assert_drains_in_order(&ppq, length);
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_pairing_test.c");
+	RUN_TEST(initialize_is_empty_with_UINT64_MAX_min_key);
+	RUN_TEST(random_keys_drain_in_order_without_a_capacity_limit);
+	RUN_TEST(meld_moves_every_element_and_empties_the_source);
+	RUN_TEST(update_key_moves_element_both_ways);
+	RUN_TEST(remove_takes_out_root_and_inner_elements);
+	RUN_TEST(random_removes_and_updates_keep_order);
+
+	return UnityEnd();
+}
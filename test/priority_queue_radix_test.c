@@ -0,0 +1,165 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "test_random.h"
+#include "priority_queue_radix.h"
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+struct priority_queue_radix rpq;
+
+void
+setUp(void)
+{
+	priority_queue_radix_initialize(&rpq, sandbox_request_get_key);
+}
+
+void
+tearDown(void)
+{
+	priority_queue_radix_destroy(&rpq);
+}
+
+void
+initialize_is_empty_with_UINT64_MAX_min_key(void)
+{
+	TEST_ASSERT_TRUE(priority_queue_radix_is_empty(&rpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, rpq.min_key);
+	TEST_ASSERT_NULL(priority_queue_radix_peek(&rpq));
+	TEST_ASSERT_NULL(priority_queue_radix_dequeue(&rpq));
+}
+
+void
+dequeue_returns_in_key_order_and_tracks_min_key(void)
+{
+	struct sandbox_request sandboxes[6] = { { 40 }, { 7 }, { 1000 }, { 7 }, { 300 }, { 41 } };
+	for (size_t i = 0; i < 6; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &sandboxes[i]));
+	TEST_ASSERT_EQUAL_UINT(6, priority_queue_radix_length(&rpq));
+	TEST_ASSERT_EQUAL_UINT64(7, rpq.min_key);
+	TEST_ASSERT_EQUAL_UINT64(7, ((struct sandbox_request *)priority_queue_radix_peek(&rpq))->absolute_deadline);
+
+	uint64_t expected[] = { 7, 7, 40, 41, 300, 1000 };
+	for (size_t i = 0; i < 6; i++) {
+		struct sandbox_request *sandbox = priority_queue_radix_dequeue(&rpq);
+		TEST_ASSERT_EQUAL_UINT64(expected[i], sandbox->absolute_deadline);
+		TEST_ASSERT_EQUAL_UINT64(expected[i], rpq.floor);
+		TEST_ASSERT_EQUAL_UINT64(i + 1 < 6 ? expected[i + 1] : UINT64_MAX, rpq.min_key);
+	}
+	TEST_ASSERT_TRUE(priority_queue_radix_is_empty(&rpq));
+}
+
+void
+try_dequeue_reports_empty_apart_from_removing(void)
+{
+	struct sandbox_request sandboxes[3] = { { 300 }, { 5 }, { 40 } };
+	void                  *out          = &sandboxes[0];
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_radix_try_dequeue(&rpq, &out));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], out);
+
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &sandboxes[i]));
+	uint64_t expected[] = { 5, 40, 300 };
+	for (size_t i = 0; i < 3; i++) {
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_try_dequeue(&rpq, &out));
+		TEST_ASSERT_EQUAL_UINT64(expected[i], ((struct sandbox_request *)out)->absolute_deadline);
+	}
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_radix_try_dequeue(&rpq, &out));
+}
+
+void
+enqueue_below_floor_is_rejected(void)
+{
+	struct sandbox_request late  = { 100 };
+	struct sandbox_request early = { 99 };
+	struct sandbox_request same  = { 100 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &late));
+	TEST_ASSERT_EQUAL_PTR(&late, priority_queue_radix_dequeue(&rpq));
+
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_RADIX_BELOW_FLOOR, priority_queue_radix_enqueue(&rpq, &early));
+	TEST_ASSERT_TRUE(priority_queue_radix_is_empty(&rpq));
+	// The floor itself is allowed
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &same));
+	TEST_ASSERT_EQUAL_UINT64(100, rpq.min_key);
+}
+
+void
+keys_spanning_all_64_bits_drain_in_order(void)
+{
+	static struct sandbox_request sandboxes[64];
+	for (size_t i = 0; i < 64; i++) {
+		sandboxes[i].absolute_deadline = UINT64_MAX >> i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &sandboxes[i]));
+	}
+	for (size_t i = 64; i-- > 0;) {
+		struct sandbox_request *sandbox = priority_queue_radix_dequeue(&rpq);
+		TEST_ASSERT_EQUAL_UINT64(UINT64_MAX >> i, sandbox->absolute_deadline);
+	}
+}
+
+void
+clear_resets_floor_and_allows_reuse(void)
+{
+	struct sandbox_request late  = { 500 };
+	struct sandbox_request early = { 5 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &late));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &late));
+	TEST_ASSERT_EQUAL_PTR(&late, priority_queue_radix_dequeue(&rpq));
+
+	priority_queue_radix_clear(&rpq);
+	TEST_ASSERT_TRUE(priority_queue_radix_is_empty(&rpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, rpq.min_key);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &early));
+	TEST_ASSERT_EQUAL_PTR(&early, priority_queue_radix_dequeue(&rpq));
+}
+
+void
+hold_model_trace_dequeues_in_deadline_order(void)
+{
+	enum { count = 4096, steps = 20000 };
+	static struct sandbox_request sandboxes[count];
+	uint64_t                      state = TEST_RANDOM_SEED;
+
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 10000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, &sandboxes[i]));
+	}
+
+	// Hold model: each dequeued request comes back with a later deadline
+	uint64_t last = 0;
+	for (size_t i = 0; i < steps; i++) {
+		struct sandbox_request *sandbox = priority_queue_radix_dequeue(&rpq);
+		TEST_ASSERT_NOT_NULL(sandbox);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		last = sandbox->absolute_deadline;
+		TEST_ASSERT_TRUE(rpq.min_key >= last);
+
+		sandbox->absolute_deadline = last + next_random_key(&state) % 10000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_radix_enqueue(&rpq, sandbox));
+	}
+	TEST_ASSERT_EQUAL_UINT(count, priority_queue_radix_length(&rpq));
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_radix_test.c");
+	RUN_TEST(initialize_is_empty_with_UINT64_MAX_min_key);
+	RUN_TEST(dequeue_returns_in_key_order_and_tracks_min_key);
+	RUN_TEST(try_dequeue_reports_empty_apart_from_removing);
+	RUN_TEST(enqueue_below_floor_is_rejected);
+	RUN_TEST(keys_spanning_all_64_bits_drain_in_order);
+	RUN_TEST(clear_resets_floor_and_allows_reuse);
+	RUN_TEST(hold_model_trace_dequeues_in_deadline_order);
+
+	return UnityEnd();
+}
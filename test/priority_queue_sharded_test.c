@@ -0,0 +1,191 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "priority_queue_sharded.h"
+
+struct sandbox_request {
+	uint64_t    absolute_deadline;
+	_Atomic int dequeued;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+enum
+{
+	worker_count = 4
+};
+
+static struct priority_queue_concurrent shards[worker_count];
+struct priority_queue_sharded           spq;
+
+static void
+initialize_sharded(size_t steal_batch, uint64_t steal_slack)
+{
+	struct priority_queue_sharded_config config       = { .steal_batch = steal_batch, .steal_slack = steal_slack };
+	struct priority_queue_config         queue_config = { .capacity = 64, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE };
+	for (size_t i = 0; i < worker_count; i++) {
+		struct priority_queue_concurrent *shard = &shards[i];
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_concurrent_initialize_dynamic(shard, sandbox_request_get_key,
+		                                                                      &queue_config));
+	}
+	priority_queue_sharded_initialize(&spq, shards, worker_count, &config);
+}
+
+static void
+destroy_sharded(void)
+{
+	for (size_t i = 0; i < worker_count; i++) priority_queue_concurrent_destroy(&shards[i]);
+}
+
+void
+setUp(void)
+{
+	initialize_sharded(4, UINT64_MAX);
+}
+
+void
+tearDown(void)
+{
+	destroy_sharded();
+}
+
+void
+enqueue_stays_on_the_workers_shard(void)
+{
+	struct sandbox_request sandbox_one = { .absolute_deadline = 10 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 2, &sandbox_one));
+	TEST_ASSERT_EQUAL_UINT64(10, priority_queue_concurrent_peek_key(&shards[2]));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_concurrent_peek_key(&shards[0]));
+	TEST_ASSERT_EQUAL_UINT64(10, priority_queue_sharded_peek_key(&spq));
+}
+
+void
+idle_worker_steals_a_batch_of_the_earliest(void)
+{
+	struct sandbox_request sandboxes[10];
+	for (size_t i = 0; i < 10; i++) {
+		sandboxes[i].absolute_deadline = 100 - i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 0, &sandboxes[i]));
+	}
+
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[9], priority_queue_sharded_dequeue(&spq, 1));
+	// The other three of the batch of four now live on worker 1
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_concurrent_length(&shards[1]));
+	TEST_ASSERT_EQUAL_UINT(6, priority_queue_concurrent_length(&shards[0]));
+	TEST_ASSERT_EQUAL_UINT64(92, priority_queue_concurrent_peek_key(&shards[1]));
+	TEST_ASSERT_EQUAL_UINT64(95, priority_queue_concurrent_peek_key(&shards[0]));
+}
+
+void
+steal_picks_the_victim_with_the_earliest_key(void)
+{
+	struct sandbox_request late  = { .absolute_deadline = 50 };
+	struct sandbox_request early = { .absolute_deadline = 5 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 1, &late));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 3, &early));
+
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_sharded_steal(&spq, 0));
+	TEST_ASSERT_EQUAL_UINT64(5, priority_queue_concurrent_peek_key(&shards[0]));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_concurrent_peek_key(&shards[3]));
+}
+
+void
+slack_steals_from_a_much_earlier_shard(void)
+{
+	destroy_sharded();
+	initialize_sharded(1, 10);
+	struct sandbox_request local  = { .absolute_deadline = 100 };
+	struct sandbox_request close  = { .absolute_deadline = 95 };
+	struct sandbox_request urgent = { .absolute_deadline = 20 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 0, &local));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 1, &close));
+
+	// Within the slack, so the worker keeps its own element
+	TEST_ASSERT_EQUAL_PTR(&local, priority_queue_sharded_dequeue(&spq, 0));
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 0, &local));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_sharded_enqueue(&spq, 2, &urgent));
+	TEST_ASSERT_EQUAL_PTR(&urgent, priority_queue_sharded_dequeue(&spq, 0));
+}
+
+void
+dequeue_on_all_empty_returns_null(void)
+{
+	TEST_ASSERT_NULL(priority_queue_sharded_dequeue(&spq, 0));
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_sharded_steal(&spq, 0));
+}
+
+enum
+{
+	stress_items = 20000
+};
+
+static struct sandbox_request stress_requests[stress_items];
+static _Atomic size_t         stress_dequeued;
+
+static void *
+stress_worker(void *arg)
+{
+	size_t worker = (size_t)(uintptr_t)arg;
+	// Worker 0 produces everything; the rest only get work by stealing
+	if (worker == 0) {
+		for (size_t i = 0; i < stress_items; i++) {
+			while (priority_queue_sharded_enqueue(&spq, 0, &stress_requests[i]) != 0) sched_yield();
+		}
+	}
+	while (atomic_load(&stress_dequeued) < stress_items) {
+		struct sandbox_request *sandbox = priority_queue_sharded_dequeue(&spq, worker);
+		if (sandbox == NULL) {
+			sched_yield();
+			continue;
+		}
+		TEST_ASSERT_EQUAL_INT(0, atomic_fetch_add(&sandbox->dequeued, 1));
+		atomic_fetch_add(&stress_dequeued, 1);
+	}
+	return NULL;
+}
+
+void
+workers_steal_and_dequeue_every_element_once(void)
+{
+	uint64_t state = 3;
+	for (size_t i = 0; i < stress_items; i++) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		stress_requests[i].absolute_deadline = state % 1000000;
+		atomic_init(&stress_requests[i].dequeued, 0);
+	}
+	atomic_init(&stress_dequeued, 0);
+
+	pthread_t threads[worker_count];
+	for (size_t i = 0; i < worker_count; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, stress_worker, (void *)(uintptr_t)i));
+	}
+	for (size_t i = 0; i < worker_count; i++) pthread_join(threads[i], NULL);
+
+	TEST_ASSERT_EQUAL_UINT(stress_items, atomic_load(&stress_dequeued));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, priority_queue_sharded_peek_key(&spq));
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_sharded_test.c");
+	RUN_TEST(enqueue_stays_on_the_workers_shard);
+	RUN_TEST(idle_worker_steals_a_batch_of_the_earliest);
+	RUN_TEST(steal_picks_the_victim_with_the_earliest_key);
+	RUN_TEST(slack_steals_from_a_much_earlier_shard);
+	RUN_TEST(dequeue_on_all_empty_returns_null);
+	RUN_TEST(workers_steal_and_dequeue_every_element_once);
+
+	return UnityEnd();
+}
@@ -1,13 +1,18 @@
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "vendor/unity.h"
+#include "test_random.h"
 #include "priority_queue.h"
 
 struct sandbox_request {
 	uint64_t absolute_deadline;
+	size_t   pq_index;
+	uint64_t estimated_cost;
 };
 
 struct sandbox_request *
@@ -25,24 +30,70 @@ sandbox_request_get_key(void *element_raw)
 	return element->absolute_deadline;
 }
 
+/* Tests guarded by PRIORITY_QUEUE_ARITY == 2 assert exact slot positions of the
+ * default 1-indexed binary layout; everything else holds for any arity. */
 struct priority_queue pq;
 
+static size_t get_key_calls;
+
+uint64_t
+sandbox_request_get_key_counted(void *element_raw)
+{
+	get_key_calls++;
+	return sandbox_request_get_key(element_raw);
+}
+
+/* Elements the shared queue holds when built with -DPRIORITY_QUEUE_CAPACITY=0 */
+#define TEST_DYNAMIC_CAPACITY 4096
+
+/* Sets up pq with embedded storage, or with fixed-size dynamic storage when the
+ * embedded arrays are compiled out, so every test runs in both builds */
+static void
+initialize(priority_queue_get_key_t get_key, size_t index_offset)
+{
+#if PRIORITY_QUEUE_CAPACITY > 0
+	if (index_offset == PRIORITY_QUEUE_UNINDEXED) {
+		priority_queue_initialize(&pq, get_key);
+	} else {
+		priority_queue_initialize_indexed(&pq, get_key, index_offset);
+	}
+#else
+	struct priority_queue_config config = { .capacity     = TEST_DYNAMIC_CAPACITY,
+		                                .growth       = PRIORITY_QUEUE_GROWTH_FIXED,
+		                                .indexed      = index_offset != PRIORITY_QUEUE_UNINDEXED,
+		                                .index_offset = index_offset };
+	priority_queue_destroy(&pq);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_initialize_dynamic(&pq, get_key, &config));
+#endif
+}
+
+/* Replaces the queue from setUp with one built from config */
+static int
+initialize_dynamic(const struct priority_queue_config *config)
+{
+	priority_queue_destroy(&pq);
+	return priority_queue_initialize_dynamic(&pq, sandbox_request_get_key, config);
+}
+
 void
 setUp(void)
 {
-	priority_queue_initialize(&pq, sandbox_request_get_key);
+	initialize(sandbox_request_get_key, PRIORITY_QUEUE_UNINDEXED);
 }
 
 void
 tearDown(void)
 {
+	priority_queue_destroy(&pq);
 }
 
+#if PRIORITY_QUEUE_ARITY == 2
 void
 initialize_should_set_first_free_to_1(void)
 {
 	TEST_ASSERT_EQUAL_UINT(1, pq.first_free);
 }
+#endif
 
 void
 initialize_should_set_min_key_to_UINT64_MAX(void)
@@ -50,12 +101,15 @@ initialize_should_set_min_key_to_UINT64_MAX(void)
 	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, pq.min_key);
 }
 
+#if PRIORITY_QUEUE_ARITY == 2
 void
 length_should_be_one_less_than_first_free(void)
 {
 	TEST_ASSERT_EQUAL_UINT(pq.first_free - 1, priority_queue_length(&pq));
 }
+#endif
 
+#if PRIORITY_QUEUE_ARITY == 2
 void
 enqueue_should_increment_first_free_and_length(void)
 {
@@ -65,6 +119,7 @@ enqueue_should_increment_first_free_and_length(void)
 	TEST_ASSERT_EQUAL_UINT(1, priority_queue_length(&pq));
 	free(sandbox_one);
 }
+#endif
 
 void
 enqueue_first_call_should_set_min_key(void)
@@ -75,6 +130,7 @@ enqueue_first_call_should_set_min_key(void)
 	free(sandbox_one);
 }
 
+#if PRIORITY_QUEUE_ARITY == 2
 void
 enqueue_first_call_should_set_index_1(void)
 {
@@ -83,6 +139,7 @@ enqueue_first_call_should_set_index_1(void)
 	TEST_ASSERT_EQUAL_PTR(sandbox_one, pq.items[1]);
 	free(sandbox_one);
 }
+#endif
 
 void
 enqueue_returns_neg1_on_full(void)
@@ -90,8 +147,10 @@ enqueue_returns_neg1_on_full(void)
 	struct sandbox_request *sandbox_one = sandbox_request_allocate(10);
 
 	// Fill up the priority queue up to the max
-	// This is one less than PRIORITY_QUEUE_CAPACITY because a min heap does not use the 0th element
-	for (size_t i = 0; i < PRIORITY_QUEUE_CAPACITY - 1; i++) TEST_ASSERT_EQUAL_INT32(0, priority_queue_enqueue(&pq, sandbox_one));
+	// This is PRIORITY_QUEUE_ROOT less than the capacity because the heap does not use the slots below the root
+	for (size_t i = 0; i < pq.capacity - PRIORITY_QUEUE_ROOT; i++) {
+		TEST_ASSERT_EQUAL_INT32(0, priority_queue_enqueue(&pq, sandbox_one));
+	}
 
 	// And then add one more
 	TEST_ASSERT_EQUAL_INT32(-1, priority_queue_enqueue(&pq, sandbox_one));
@@ -126,6 +185,7 @@ dequeue_of_one(void)
 	free(sandbox_one);
 }
 
+#if PRIORITY_QUEUE_ARITY == 2
 void
 dequeue_should_return_in_priority_order(void)
 {
@@ -192,6 +252,7 @@ dequeue_should_return_in_priority_order(void)
 
 	TEST_ASSERT_EQUAL_PTR(NULL, priority_queue_dequeue(&pq));
 }
+#endif
 
 void
 peek_on_empty_returns_null(void)
@@ -239,7 +300,7 @@ void
 is_full_returns_true_when_at_capacity(void)
 {
 	struct sandbox_request *sandbox_one = sandbox_request_allocate(10);
-	for (size_t i = 0; i < PRIORITY_QUEUE_CAPACITY - 1; i++) (void)priority_queue_enqueue(&pq, sandbox_one);
+	for (size_t i = 0; i < pq.capacity - PRIORITY_QUEUE_ROOT; i++) (void)priority_queue_enqueue(&pq, sandbox_one);
 	TEST_ASSERT_TRUE(priority_queue_is_full(&pq));
 	free(sandbox_one);
 }
@@ -284,21 +345,900 @@ clear_allows_reuse(void)
 	free(sandbox_two);
 }
 
+void
+get_key_called_once_per_enqueue(void)
+{
+	initialize(sandbox_request_get_key_counted, PRIORITY_QUEUE_UNINDEXED);
+	get_key_calls = 0;
+
+	struct sandbox_request *sandboxes[8];
+	uint64_t                deadlines[8] = { 40, 10, 70, 20, 80, 30, 60, 50 };
+	for (size_t i = 0; i < 8; i++) {
+		sandboxes[i] = sandbox_request_allocate(deadlines[i]);
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandboxes[i]));
+	}
+	TEST_ASSERT_EQUAL_UINT(8, get_key_calls);
+
+	uint64_t last = 0;
+	while (!priority_queue_is_empty(&pq)) {
+		struct sandbox_request *sandbox = priority_queue_dequeue(&pq);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		last = sandbox->absolute_deadline;
+	}
+	TEST_ASSERT_EQUAL_UINT(8, get_key_calls);
+
+	for (size_t i = 0; i < 8; i++) free(sandboxes[i]);
+}
+
+#if PRIORITY_QUEUE_ARITY == 2
+void
+keys_track_items(void)
+{
+	struct sandbox_request *sandbox_one = sandbox_request_allocate(10);
+	struct sandbox_request *sandbox_two = sandbox_request_allocate(5);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_two));
+
+	TEST_ASSERT_EQUAL_UINT64(5, pq.keys[1]);
+	TEST_ASSERT_EQUAL_UINT64(10, pq.keys[2]);
+
+	free(sandbox_one);
+	free(sandbox_two);
+}
+#endif
+
+void
+dequeue_returns_random_keys_in_order(void)
+{
+	enum { count = 1000 };
+	static struct sandbox_request sandboxes[count];
+	uint64_t                      state = TEST_RANDOM_SEED;
+
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 500;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+
+	uint64_t last = 0;
+	for (size_t i = 0; i < count; i++) {
+		TEST_ASSERT_EQUAL_UINT64(((struct sandbox_request *)priority_queue_peek(&pq))->absolute_deadline, pq.min_key);
+		struct sandbox_request *sandbox = priority_queue_dequeue(&pq);
+		TEST_ASSERT_NOT_NULL(sandbox);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		last = sandbox->absolute_deadline;
+	}
+	TEST_ASSERT_TRUE(priority_queue_is_empty(&pq));
+}
+
+void
+dequeue_orders_keys_across_the_sign_bit(void)
+{
+	enum { count = 1000 };
+	static struct sandbox_request sandboxes[count];
+	uint64_t                      state = TEST_RANDOM_SEED;
+
+	// Full 64-bit keys, so half of them would compare as negative if treated as signed
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = i % 7 == 0 ? UINT64_MAX - i % 3 : next_random_key(&state);
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+
+	uint64_t last = 0;
+	for (size_t i = 0; i < count; i++) {
+		struct sandbox_request *sandbox = priority_queue_dequeue(&pq);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		last = sandbox->absolute_deadline;
+	}
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, last);
+}
+
+static void
+assert_drains_in_order(size_t expected_length)
+{
+	TEST_ASSERT_EQUAL_UINT(expected_length, priority_queue_length(&pq));
+	uint64_t last = 0;
+	while (!priority_queue_is_empty(&pq)) {
+		TEST_ASSERT_EQUAL_UINT64(((struct sandbox_request *)priority_queue_peek(&pq))->absolute_deadline, pq.min_key);
+		struct sandbox_request *sandbox = priority_queue_dequeue(&pq);
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		last = sandbox->absolute_deadline;
+	}
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, pq.min_key);
+}
+
+void
+enqueue_batch_into_empty_queue(void)
+{
+	enum { count = 300 };
+	static struct sandbox_request sandboxes[count];
+	void                         *values[count];
+	uint64_t                      state = 42;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 1000;
+		values[i]                      = &sandboxes[i];
+	}
+
+	initialize(sandbox_request_get_key_counted, PRIORITY_QUEUE_UNINDEXED);
+	get_key_calls = 0;
+	TEST_ASSERT_EQUAL_UINT(count, priority_queue_enqueue_batch(&pq, values, count));
+	TEST_ASSERT_EQUAL_UINT(count, get_key_calls);
+	assert_drains_in_order(count);
+}
+
+void
+enqueue_batch_into_populated_queue(void)
+{
+	enum { count = 200 };
+	static struct sandbox_request sandboxes[count];
+	void                         *values[count];
+	uint64_t                      state = 7;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 1000;
+		values[i]                      = &sandboxes[i];
+	}
+
+	// Small existing heap, large batch: the whole heap is rebuilt
+	for (size_t i = 0; i < 10; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, values[i]));
+	TEST_ASSERT_EQUAL_UINT(40, priority_queue_enqueue_batch(&pq, &values[10], 40));
+	// Large existing heap, small batch: only the new slots' ancestors are rebuilt
+	for (size_t i = 50; i < 190; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, values[i]));
+	TEST_ASSERT_EQUAL_UINT(10, priority_queue_enqueue_batch(&pq, &values[190], 10));
+	assert_drains_in_order(count);
+}
+
+void
+enqueue_batch_new_minimum_updates_min_key(void)
+{
+	struct sandbox_request *sandbox_10 = sandbox_request_allocate(10);
+	struct sandbox_request *sandbox_3  = sandbox_request_allocate(3);
+	struct sandbox_request *sandbox_7  = sandbox_request_allocate(7);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_10));
+
+	void *values[] = { sandbox_7, sandbox_3 };
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_enqueue_batch(&pq, values, 2));
+	TEST_ASSERT_EQUAL_UINT64(3, pq.min_key);
+	TEST_ASSERT_EQUAL_PTR(sandbox_3, priority_queue_peek(&pq));
+
+	free(sandbox_10);
+	free(sandbox_3);
+	free(sandbox_7);
+}
+
+void
+enqueue_batch_returns_accepted_count_when_full(void)
+{
+	struct sandbox_request *sandbox_one = sandbox_request_allocate(10);
+	void                   *values[8]   = { sandbox_one, sandbox_one, sandbox_one, sandbox_one,
+		                                sandbox_one, sandbox_one, sandbox_one, sandbox_one };
+
+	// Leave exactly three free slots
+	for (size_t i = 0; i < pq.capacity - PRIORITY_QUEUE_ROOT - 3; i++) {
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	}
+
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_enqueue_batch(&pq, values, 8));
+	TEST_ASSERT_TRUE(priority_queue_is_full(&pq));
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_enqueue_batch(&pq, values, 8));
+
+	free(sandbox_one);
+}
+
+void
+dequeue_until_on_empty_returns_zero(void)
+{
+	void *out[4];
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_dequeue_until(&pq, UINT64_MAX, out, 4));
+}
+
+void
+dequeue_until_stops_at_key_limit(void)
+{
+	struct sandbox_request *sandboxes[6];
+	uint64_t                deadlines[6] = { 30, 10, 60, 20, 50, 40 };
+	for (size_t i = 0; i < 6; i++) {
+		sandboxes[i] = sandbox_request_allocate(deadlines[i]);
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandboxes[i]));
+	}
+
+	void *out[6];
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_dequeue_until(&pq, 30, out, 6));
+	TEST_ASSERT_EQUAL_PTR(sandboxes[1], out[0]);
+	TEST_ASSERT_EQUAL_PTR(sandboxes[3], out[1]);
+	TEST_ASSERT_EQUAL_PTR(sandboxes[0], out[2]);
+	TEST_ASSERT_EQUAL_UINT64(40, pq.min_key);
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_length(&pq));
+
+	for (size_t i = 0; i < 6; i++) free(sandboxes[i]);
+}
+
+void
+dequeue_until_respects_max_out(void)
+{
+	struct sandbox_request *sandboxes[5];
+	for (size_t i = 0; i < 5; i++) {
+		sandboxes[i] = sandbox_request_allocate(5 - i);
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandboxes[i]));
+	}
+
+	void *out[2];
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_dequeue_until(&pq, UINT64_MAX, out, 2));
+	TEST_ASSERT_EQUAL_PTR(sandboxes[4], out[0]);
+	TEST_ASSERT_EQUAL_PTR(sandboxes[3], out[1]);
+	TEST_ASSERT_EQUAL_UINT64(3, pq.min_key);
+
+	for (size_t i = 0; i < 5; i++) free(sandboxes[i]);
+}
+
+void
+dequeue_until_bulk_extracts_in_order(void)
+{
+	enum { count = 1000 };
+	static struct sandbox_request sandboxes[count];
+	static void                  *out[count];
+	uint64_t                      state    = 1234;
+	size_t                        expected = 0;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 1000;
+		if (sandboxes[i].absolute_deadline <= 900) expected++;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+
+	// Far more than n / log n elements qualify, so this takes the bulk path
+	TEST_ASSERT_EQUAL_UINT(expected, priority_queue_dequeue_until(&pq, 900, out, count));
+	for (size_t i = 0; i < expected; i++) {
+		uint64_t deadline = ((struct sandbox_request *)out[i])->absolute_deadline;
+		TEST_ASSERT_TRUE(deadline <= 900);
+		if (i > 0) {
+			TEST_ASSERT_TRUE(((struct sandbox_request *)out[i - 1])->absolute_deadline <= deadline);
+		}
+	}
+	TEST_ASSERT_TRUE(pq.min_key > 900);
+	assert_drains_in_order(count - expected);
+}
+
+void
+dequeue_until_bounded_drain_returns_smallest_keys(void)
+{
+	enum { count = 1000, batch = 100 };
+	static struct sandbox_request sandboxes[count];
+	static void                  *out[batch];
+	uint64_t                      state = 4321;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 1000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+
+	// Everything qualifies but only batch fit, so the drain pops past n / log n instead of extracting in bulk
+	TEST_ASSERT_EQUAL_UINT(batch, priority_queue_dequeue_until(&pq, UINT64_MAX, out, batch));
+	for (size_t i = 1; i < batch; i++) {
+		TEST_ASSERT_TRUE(((struct sandbox_request *)out[i - 1])->absolute_deadline
+		                 <= ((struct sandbox_request *)out[i])->absolute_deadline);
+	}
+	TEST_ASSERT_TRUE(((struct sandbox_request *)out[batch - 1])->absolute_deadline <= pq.min_key);
+	assert_drains_in_order(count - batch);
+}
+
+static void
+initialize_indexed(void)
+{
+	initialize(sandbox_request_get_key, offsetof(struct sandbox_request, pq_index));
+}
+
+void
+peek_k_returns_smallest_keys_in_order_without_changing_queue(void)
+{
+	enum { count = 1000, k = 100 };
+	static struct sandbox_request sandboxes[count];
+	static uint64_t               keys_before[count + PRIORITY_QUEUE_ROOT];
+	static void                  *items_before[count + PRIORITY_QUEUE_ROOT];
+	uint64_t                      state = TEST_RANDOM_SEED;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 500;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+	memcpy(keys_before, pq.keys, sizeof(keys_before));
+	memcpy(items_before, pq.items, sizeof(items_before));
+
+	void *out[PRIORITY_QUEUE_PEEK_K_MAX + 1];
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_peek_k(&pq, out, 0));
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_PEEK_K_MAX, priority_queue_peek_k(&pq, out, PRIORITY_QUEUE_PEEK_K_MAX + 1));
+	TEST_ASSERT_EQUAL_UINT(k, priority_queue_peek_k(&pq, out, k));
+	TEST_ASSERT_EQUAL_MEMORY(keys_before, pq.keys, sizeof(keys_before));
+	TEST_ASSERT_EQUAL_MEMORY(items_before, pq.items, sizeof(items_before));
+	TEST_ASSERT_EQUAL_UINT(count, priority_queue_length(&pq));
+
+	// Equal keys may come out in either order, so compare keys rather than elements
+	for (size_t i = 0; i < k; i++) {
+		struct sandbox_request *sandbox = priority_queue_dequeue(&pq);
+		TEST_ASSERT_EQUAL_UINT64(sandbox->absolute_deadline, sandbox_request_get_key(out[i]));
+	}
+
+	struct sandbox_request sandbox_one = { .absolute_deadline = 7 };
+	priority_queue_clear(&pq);
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_peek_k(&pq, out, k));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandbox_one));
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_peek_k(&pq, out, k));
+	TEST_ASSERT_EQUAL_PTR(&sandbox_one, out[0]);
+}
+
+void
+iterator_visits_each_element_once_in_order(void)
+{
+	enum { count = 1000 };
+	static struct sandbox_request       sandboxes[count];
+	static struct priority_queue_cursor frontier[count];
+	static bool                         visited[count];
+	uint64_t                            state = 42;
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 5000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+
+	struct priority_queue_iterator iterator;
+	priority_queue_iterator_initialize(&iterator, &pq, frontier, count);
+	uint64_t last = 0;
+	size_t   seen = 0;
+	for (struct sandbox_request *sandbox; (sandbox = priority_queue_iterator_next(&iterator)) != NULL; seen++) {
+		TEST_ASSERT_TRUE(sandbox->absolute_deadline >= last);
+		TEST_ASSERT_FALSE(visited[sandbox - sandboxes]);
+		visited[sandbox - sandboxes] = true;
+		last                         = sandbox->absolute_deadline;
+	}
+	TEST_ASSERT_EQUAL_UINT(count, seen);
+	TEST_ASSERT_NULL(priority_queue_iterator_next(&iterator));
+
+	// A frontier of 3 entries visits exactly the 3 smallest elements
+	void *smallest[3];
+	TEST_ASSERT_EQUAL_UINT(3, priority_queue_peek_k(&pq, smallest, 3));
+	priority_queue_iterator_initialize(&iterator, &pq, frontier, 3);
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_PTR(smallest[i], priority_queue_iterator_next(&iterator));
+	TEST_ASSERT_NULL(priority_queue_iterator_next(&iterator));
+}
+
+void
+indexed_enqueue_and_dequeue_track_slot(void)
+{
+	initialize_indexed();
+	struct sandbox_request *sandbox_one = sandbox_request_allocate(10);
+	struct sandbox_request *sandbox_two = sandbox_request_allocate(5);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_two));
+
+	TEST_ASSERT_EQUAL_PTR(sandbox_one, pq.items[sandbox_one->pq_index]);
+	TEST_ASSERT_EQUAL_PTR(sandbox_two, pq.items[sandbox_two->pq_index]);
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_ROOT, sandbox_two->pq_index);
+
+	TEST_ASSERT_EQUAL_PTR(sandbox_two, priority_queue_dequeue(&pq));
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_UNINDEXED, sandbox_two->pq_index);
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_ROOT, sandbox_one->pq_index);
+
+	TEST_ASSERT_EQUAL_PTR(sandbox_one, priority_queue_dequeue(&pq));
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_UNINDEXED, sandbox_one->pq_index);
+
+	free(sandbox_one);
+	free(sandbox_two);
+}
+
+void
+remove_root_updates_min_key(void)
+{
+	initialize_indexed();
+	struct sandbox_request *sandboxes[4];
+	uint64_t                deadlines[4] = { 20, 5, 15, 10 };
+	for (size_t i = 0; i < 4; i++) {
+		sandboxes[i] = sandbox_request_allocate(deadlines[i]);
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandboxes[i]));
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, sandboxes[1]));
+	TEST_ASSERT_EQUAL_UINT64(10, pq.min_key);
+	TEST_ASSERT_EQUAL_UINT(PRIORITY_QUEUE_UNINDEXED, sandboxes[1]->pq_index);
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_remove(&pq, sandboxes[1]));
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, sandboxes[0]));
+	TEST_ASSERT_EQUAL_PTR(sandboxes[3], priority_queue_dequeue(&pq));
+	TEST_ASSERT_EQUAL_PTR(sandboxes[2], priority_queue_dequeue(&pq));
+	TEST_ASSERT_TRUE(priority_queue_is_empty(&pq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, pq.min_key);
+
+	for (size_t i = 0; i < 4; i++) free(sandboxes[i]);
+}
+
+void
+remove_last_element_empties_queue(void)
+{
+	initialize_indexed();
+	struct sandbox_request *sandbox_one = sandbox_request_allocate(10);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, sandbox_one));
+	TEST_ASSERT_TRUE(priority_queue_is_empty(&pq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, pq.min_key);
+	free(sandbox_one);
+}
+
+void
+update_key_moves_element_both_ways(void)
+{
+	initialize_indexed();
+	struct sandbox_request *sandboxes[5];
+	for (size_t i = 0; i < 5; i++) {
+		sandboxes[i] = sandbox_request_allocate(10 * (i + 1));
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandboxes[i]));
+	}
+
+	// Earlier deadline becomes the new root
+	sandboxes[4]->absolute_deadline = 1;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_update_key(&pq, sandboxes[4]));
+	TEST_ASSERT_EQUAL_UINT64(1, pq.min_key);
+	TEST_ASSERT_EQUAL_PTR(sandboxes[4], priority_queue_peek(&pq));
+
+	// Later deadline pushes the old root down
+	sandboxes[4]->absolute_deadline = 100;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_update_key(&pq, sandboxes[4]));
+	TEST_ASSERT_EQUAL_UINT64(10, pq.min_key);
+
+	struct sandbox_request *stranger = sandbox_request_allocate(3);
+	stranger->pq_index               = PRIORITY_QUEUE_UNINDEXED;
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_update_key(&pq, stranger));
+
+	for (size_t i = 0; i < 4; i++) TEST_ASSERT_EQUAL_PTR(sandboxes[i], priority_queue_dequeue(&pq));
+	TEST_ASSERT_EQUAL_PTR(sandboxes[4], priority_queue_dequeue(&pq));
+
+	for (size_t i = 0; i < 5; i++) free(sandboxes[i]);
+	free(stranger);
+}
+
+void
+indexed_random_removes_and_updates_keep_order(void)
+{
+	enum { count = 500 };
+	static struct sandbox_request sandboxes[count];
+	uint64_t                      state = 99;
+
+	initialize_indexed();
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 10000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+	for (size_t i = 0; i < count; i += 3) TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, &sandboxes[i]));
+	for (size_t i = 1; i < count; i += 3) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 10000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_update_key(&pq, &sandboxes[i]));
+	}
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < pq.first_free; i++) {
+		TEST_ASSERT_EQUAL_UINT(i, ((struct sandbox_request *)pq.items[i])->pq_index);
+	}
+	assert_drains_in_order(count - (count + 2) / 3);
+}
+
+struct counting_allocator {
+	size_t allocations;
+	size_t releases;
+	size_t live_bytes;
+	bool   refuse;
+};
+
+static void *
+counting_allocate(void *context, size_t size, size_t alignment)
+{
+	struct counting_allocator *counter = context;
+	if (counter->refuse) return NULL;
+	counter->allocations++;
+	counter->live_bytes += size;
+	return aligned_alloc(alignment, size);
+}
+
+static void
+counting_release(void *context, void *ptr, size_t size)
+{
+	struct counting_allocator *counter = context;
+	counter->releases++;
+	counter->live_bytes -= size;
+	free(ptr);
+}
+
+void
+dynamic_queue_grows_past_initial_capacity(void)
+{
+	enum { count = 1000 };
+	static struct sandbox_request sandboxes[count];
+	uint64_t                      state  = 5;
+	struct priority_queue_config  config = { .capacity = 4, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = next_random_key(&state) % 5000;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+	TEST_ASSERT_FALSE(priority_queue_is_full(&pq));
+	TEST_ASSERT_TRUE(pq.capacity >= count + PRIORITY_QUEUE_ROOT);
+	assert_drains_in_order(count);
+
+	priority_queue_destroy(&pq);
+}
+
+void
+dynamic_fixed_queue_rejects_when_full(void)
+{
+	struct sandbox_request      *sandbox_one = sandbox_request_allocate(10);
+	struct priority_queue_config config      = { .capacity = 4, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	for (size_t i = 0; i < 4; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_TRUE(priority_queue_is_full(&pq));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_enqueue(&pq, sandbox_one));
+
+	priority_queue_destroy(&pq);
+	free(sandbox_one);
+}
+
+void
+dynamic_max_capacity_limits_growth(void)
+{
+	struct sandbox_request      *sandbox_one = sandbox_request_allocate(10);
+	void                        *values[8]   = { sandbox_one, sandbox_one, sandbox_one, sandbox_one,
+		                                sandbox_one, sandbox_one, sandbox_one, sandbox_one };
+	struct priority_queue_config config      = {
+		     .capacity = 2, .max_capacity = 10, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE
+	};
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	TEST_ASSERT_EQUAL_UINT(8, priority_queue_enqueue_batch(&pq, values, 8));
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_enqueue_batch(&pq, values, 8));
+	TEST_ASSERT_TRUE(priority_queue_is_full(&pq));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_EQUAL_UINT(10, priority_queue_length(&pq));
+
+	priority_queue_destroy(&pq);
+	free(sandbox_one);
+}
+
+void
+dynamic_queue_is_full_after_allocator_refuses_growth(void)
+{
+	struct sandbox_request               *sandbox_one = sandbox_request_allocate(10);
+	struct counting_allocator             counter     = { 0 };
+	const struct priority_queue_allocator allocator   = { counting_allocate, counting_release, &counter };
+	struct priority_queue_config          config      = {
+		               .capacity = 4, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE, .allocator = &allocator
+	};
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	while (pq.first_free < pq.capacity) TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_FALSE(priority_queue_is_full(&pq));
+	counter.refuse = true;
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_TRUE(priority_queue_is_full(&pq));
+
+	// A dequeue frees a slot, and the next full enqueue tries the allocator again
+	TEST_ASSERT_NOT_NULL(priority_queue_dequeue(&pq));
+	TEST_ASSERT_FALSE(priority_queue_is_full(&pq));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	counter.refuse = false;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandbox_one));
+	TEST_ASSERT_FALSE(priority_queue_is_full(&pq));
+
+	priority_queue_destroy(&pq);
+	free(sandbox_one);
+}
+
+void
+dynamic_queue_shrinks_and_releases_through_allocator(void)
+{
+	enum { count = 512 };
+	static struct sandbox_request         sandboxes[count];
+	struct counting_allocator             counter   = { 0 };
+	const struct priority_queue_allocator allocator = { counting_allocate, counting_release, &counter };
+	struct priority_queue_config          config    = {
+		          .capacity = 8, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK, .allocator = &allocator
+	};
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+	size_t initial_capacity = pq.capacity;
+	size_t initial_bytes    = counter.live_bytes;
+
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = count - i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+	TEST_ASSERT_TRUE(counter.live_bytes > initial_bytes);
+	TEST_ASSERT_EQUAL_UINT(1, counter.allocations - counter.releases);
+
+	assert_drains_in_order(count);
+	TEST_ASSERT_EQUAL_UINT(initial_capacity, pq.capacity);
+	TEST_ASSERT_EQUAL_UINT(initial_bytes, counter.live_bytes);
+
+	priority_queue_destroy(&pq);
+	TEST_ASSERT_EQUAL_UINT(counter.allocations, counter.releases);
+	TEST_ASSERT_EQUAL_UINT(0, counter.live_bytes);
+}
+
+void
+dynamic_queue_shrink_keeps_room_for_every_element(void)
+{
+	enum { count = 64 };
+	static struct sandbox_request sandboxes[count];
+	struct priority_queue_config  config = { .capacity = 4, .growth = PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	// Every queue length on the way down is a chance to shrink below first_free
+	for (size_t i = 0; i < count; i++) {
+		sandboxes[i].absolute_deadline = i;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+	for (size_t i = 0; i < count; i++) {
+		TEST_ASSERT_EQUAL_PTR(&sandboxes[i], priority_queue_dequeue(&pq));
+		TEST_ASSERT_TRUE(pq.first_free <= pq.capacity);
+	}
+	priority_queue_destroy(&pq);
+}
+
+void
+dynamic_indexed_queue_supports_remove(void)
+{
+	struct sandbox_request      *sandboxes[20];
+	struct priority_queue_config config = { .capacity     = 2,
+		                                .growth       = PRIORITY_QUEUE_GROWTH_DOUBLE,
+		                                .indexed      = true,
+		                                .index_offset = offsetof(struct sandbox_request, pq_index) };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	for (size_t i = 0; i < 20; i++) {
+		sandboxes[i] = sandbox_request_allocate(i);
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, sandboxes[i]));
+	}
+	// Indices survive the resizes, since they are slot positions rather than addresses
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, sandboxes[0]));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, sandboxes[13]));
+	TEST_ASSERT_EQUAL_UINT64(1, pq.min_key);
+	assert_drains_in_order(18);
+
+	priority_queue_destroy(&pq);
+	for (size_t i = 0; i < 20; i++) free(sandboxes[i]);
+}
+
+uint64_t
+sandbox_request_get_cost(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->estimated_cost;
+}
+
+/* Checks the aggregates and a few cost_until answers against a scan of every slot */
+static void
+assert_aggregates_match_scan(uint64_t key_limit)
+{
+	struct priority_queue_aggregates expected = { .min_key = UINT64_MAX };
+	uint64_t                         until    = 0;
+	for (size_t i = PRIORITY_QUEUE_ROOT; i < pq.first_free; i++) {
+		uint64_t key = sandbox_request_get_key(pq.items[i]);
+		uint64_t cost = sandbox_request_get_cost(pq.items[i]);
+		expected.count++;
+		expected.total_cost += cost;
+		expected.key_sum += key;
+		if (key < expected.min_key) expected.min_key = key;
+		if (key > expected.max_key) expected.max_key = key;
+		if (key <= key_limit) until += cost;
+	}
+
+	// cost_until goes first, so it also runs while max_key may be stale
+	TEST_ASSERT_EQUAL_UINT64(until, priority_queue_cost_until(&pq, key_limit));
+	TEST_ASSERT_EQUAL_UINT64(expected.total_cost, priority_queue_cost_until(&pq, UINT64_MAX));
+	TEST_ASSERT_EQUAL_UINT64(expected.total_cost, priority_queue_cost_until(&pq, expected.max_key));
+
+	struct priority_queue_aggregates aggregates;
+	priority_queue_get_aggregates(&pq, &aggregates);
+	TEST_ASSERT_EQUAL_UINT(expected.count, aggregates.count);
+	TEST_ASSERT_EQUAL_UINT64(expected.total_cost, aggregates.total_cost);
+	TEST_ASSERT_EQUAL_UINT64(expected.key_sum, aggregates.key_sum);
+	TEST_ASSERT_EQUAL_UINT64(expected.min_key, aggregates.min_key);
+	TEST_ASSERT_EQUAL_UINT64(expected.max_key, aggregates.max_key);
+}
+
+void
+aggregates_follow_every_way_in_and_out(void)
+{
+	enum { count = 400 };
+	static struct sandbox_request sandboxes[count];
+	static bool                   queued[count];
+	struct priority_queue_config  config = { .capacity     = 4,
+		                                 .growth       = PRIORITY_QUEUE_GROWTH_DOUBLE_SHRINK,
+		                                 .indexed      = true,
+		                                 .index_offset = offsetof(struct sandbox_request, pq_index),
+		                                 .get_cost     = sandbox_request_get_cost };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+	assert_aggregates_match_scan(0);
+	for (size_t i = 0; i < count; i++) sandboxes[i].estimated_cost = i % 13 + 1;
+
+	uint64_t state = 99;
+	void    *out[count];
+	for (size_t step = 0; step < 4000; step++) {
+		size_t i = next_random_key(&state) % count;
+		switch (next_random_key(&state) % 6) {
+		case 0:
+		case 1:
+			if (queued[i]) break;
+			sandboxes[i].absolute_deadline = next_random_key(&state) % 1000;
+			TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+			queued[i] = true;
+			break;
+		case 2: {
+			struct sandbox_request *sandbox = priority_queue_dequeue(&pq);
+			if (sandbox != NULL) queued[sandbox - sandboxes] = false;
+			break;
+		}
+		case 3:
+			if (!queued[i]) break;
+			TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, &sandboxes[i]));
+			queued[i] = false;
+			break;
+		case 4:
+			if (!queued[i]) break;
+			sandboxes[i].absolute_deadline = next_random_key(&state) % 1000;
+			TEST_ASSERT_EQUAL_INT(0, priority_queue_update_key(&pq, &sandboxes[i]));
+			break;
+		default: {
+			size_t drained = priority_queue_dequeue_until(&pq, pq.min_key + 50, out, count);
+			for (size_t j = 0; j < drained; j++) queued[(struct sandbox_request *)out[j] - sandboxes] = false;
+		}
+		}
+		assert_aggregates_match_scan(next_random_key(&state) % 1000);
+	}
+
+	// A batch, and a drain large enough to take the bulk extraction path
+	size_t batched = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (!queued[i]) out[batched++] = &sandboxes[i];
+	}
+	TEST_ASSERT_EQUAL_UINT(batched, priority_queue_enqueue_batch(&pq, out, batched));
+	assert_aggregates_match_scan(500);
+	TEST_ASSERT_EQUAL_UINT(count, priority_queue_dequeue_until(&pq, UINT64_MAX, out, count));
+	assert_aggregates_match_scan(500);
+
+	priority_queue_destroy(&pq);
+}
+
+void
+removing_the_maximum_defers_its_rescan(void)
+{
+	static struct sandbox_request sandboxes[64];
+	struct priority_queue_config  config = { .capacity     = 64,
+		                                 .growth       = PRIORITY_QUEUE_GROWTH_FIXED,
+		                                 .indexed      = true,
+		                                 .index_offset = offsetof(struct sandbox_request, pq_index),
+		                                 .get_cost     = sandbox_request_get_cost };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+	for (size_t i = 0; i < 64; i++) {
+		sandboxes[i].absolute_deadline = 10 * (i + 1);
+		sandboxes[i].estimated_cost    = 1;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+
+	// Removal leaves the old maximum in place as an upper bound
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, &sandboxes[63]));
+	TEST_ASSERT_TRUE(pq.max_key_stale);
+	TEST_ASSERT_EQUAL_UINT64(63, priority_queue_cost_until(&pq, 635));
+	sandboxes[62].absolute_deadline = 5;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_update_key(&pq, &sandboxes[62]));
+	TEST_ASSERT_TRUE(pq.max_key_stale);
+	assert_aggregates_match_scan(615);
+	TEST_ASSERT_FALSE(pq.max_key_stale);
+	TEST_ASSERT_EQUAL_UINT64(620, pq.max_key);
+
+	// An enqueue at or past the bound makes it exact again without a scan
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&pq, &sandboxes[61]));
+	TEST_ASSERT_TRUE(pq.max_key_stale);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[63]));
+	TEST_ASSERT_FALSE(pq.max_key_stale);
+	TEST_ASSERT_EQUAL_UINT64(640, pq.max_key);
+	assert_aggregates_match_scan(600);
+
+	priority_queue_destroy(&pq);
+}
+
+void
+set_get_cost_recomputes_aggregates_of_a_queue_in_use(void)
+{
+	static struct sandbox_request sandboxes[100];
+	for (size_t i = 0; i < 100; i++) {
+		sandboxes[i].absolute_deadline = 1000 - 10 * i;
+		sandboxes[i].estimated_cost    = i + 1;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	}
+	priority_queue_set_get_cost(&pq, sandbox_request_get_cost);
+	assert_aggregates_match_scan(505);
+	TEST_ASSERT_EQUAL_UINT64(0, priority_queue_cost_until(&pq, pq.min_key - 1));
+
+	priority_queue_clear(&pq);
+	assert_aggregates_match_scan(505);
+	TEST_ASSERT_EQUAL_UINT64(0, priority_queue_cost_until(&pq, UINT64_MAX));
+
+	// Without a cost callback nothing is tracked
+	priority_queue_set_get_cost(&pq, NULL);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[0]));
+	TEST_ASSERT_EQUAL_UINT64(0, pq.total_cost);
+}
+
+#ifdef PRIORITY_QUEUE_STATS
+void
+stats_count_comparisons_moves_and_depths(void)
+{
+	struct sandbox_request sandboxes[3] = { { .absolute_deadline = 10 },
+		                                { .absolute_deadline = 20 },
+		                                { .absolute_deadline = 30 } };
+	for (size_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &sandboxes[i]));
+	TEST_ASSERT_EQUAL_PTR(&sandboxes[0], priority_queue_dequeue(&pq));
+
+	struct priority_queue_stats stats;
+	priority_queue_get_stats(&pq, &stats);
+	// Both later enqueues compare against the root; the dequeue compares 30 with its only child, 20
+	TEST_ASSERT_EQUAL_UINT64(3, stats.comparisons);
+	// The last element moves to the root, then sinks one level as 20 moves up
+	TEST_ASSERT_EQUAL_UINT64(2, stats.moves);
+	TEST_ASSERT_EQUAL_UINT64(3, stats.get_key_calls);
+	TEST_ASSERT_EQUAL_UINT64(3, stats.percolate_up_depth[0]);
+	TEST_ASSERT_EQUAL_UINT64(1, stats.percolate_down_depth[1]);
+	TEST_ASSERT_EQUAL_UINT(3, stats.high_water);
+}
+
+void
+stats_count_rejections_and_survive_clear(void)
+{
+	struct priority_queue_config config = { .capacity = 4, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	TEST_ASSERT_EQUAL_INT(0, initialize_dynamic(&config));
+
+	struct sandbox_request sandboxes[6];
+	void                  *values[6];
+	for (size_t i = 0; i < 6; i++) {
+		sandboxes[i].absolute_deadline = 6 - i;
+		values[i]                      = &sandboxes[i];
+	}
+	TEST_ASSERT_EQUAL_UINT(4, priority_queue_enqueue_batch(&pq, values, 6));
+	TEST_ASSERT_EQUAL_INT(-1, priority_queue_enqueue(&pq, &sandboxes[5]));
+
+	struct priority_queue_stats stats;
+	priority_queue_get_stats(&pq, &stats);
+	TEST_ASSERT_EQUAL_UINT64(3, stats.full_rejections);
+	TEST_ASSERT_EQUAL_UINT64(5, stats.get_key_calls);
+	TEST_ASSERT_EQUAL_UINT(4, stats.high_water);
+
+	priority_queue_clear(&pq);
+	priority_queue_get_stats(&pq, &stats);
+	TEST_ASSERT_EQUAL_UINT(4, stats.high_water);
+
+	priority_queue_reset_stats(&pq);
+	priority_queue_get_stats(&pq, &stats);
+	TEST_ASSERT_EQUAL_UINT64(0, stats.full_rejections);
+	TEST_ASSERT_EQUAL_UINT(0, stats.high_water);
+
+	priority_queue_destroy(&pq);
+}
+#endif
+
 int
 main(void)
 {
 	UnityBegin("priority_queue_test.c");
+#if PRIORITY_QUEUE_ARITY == 2
 	RUN_TEST(initialize_should_set_first_free_to_1);
+#endif
 	RUN_TEST(initialize_should_set_min_key_to_UINT64_MAX);
+#if PRIORITY_QUEUE_ARITY == 2
 	RUN_TEST(length_should_be_one_less_than_first_free);
+#endif
 	RUN_TEST(enqueue_first_call_should_set_min_key);
+#if PRIORITY_QUEUE_ARITY == 2
 	RUN_TEST(enqueue_should_increment_first_free_and_length);
+#endif
+#if PRIORITY_QUEUE_ARITY == 2
 	RUN_TEST(enqueue_first_call_should_set_index_1);
+#endif
 	RUN_TEST(enqueue_returns_neg1_on_full);
 	RUN_TEST(dequeue_on_empty_returns_null);
 	RUN_TEST(dequeue_last_element_should_set_UINT64_MAX);
 	RUN_TEST(dequeue_of_one);
+#if PRIORITY_QUEUE_ARITY == 2
 	RUN_TEST(dequeue_should_return_in_priority_order);
+#endif
 	RUN_TEST(peek_on_empty_returns_null);
 	RUN_TEST(peek_returns_min_without_removing);
 	RUN_TEST(is_empty_returns_true_on_empty_queue);
@@ -308,6 +1248,42 @@ main(void)
 	RUN_TEST(clear_empties_queue);
 	RUN_TEST(clear_preserves_get_key_callback);
 	RUN_TEST(clear_allows_reuse);
+	RUN_TEST(get_key_called_once_per_enqueue);
+	RUN_TEST(dequeue_returns_random_keys_in_order);
+	RUN_TEST(dequeue_orders_keys_across_the_sign_bit);
+	RUN_TEST(enqueue_batch_into_empty_queue);
+	RUN_TEST(enqueue_batch_into_populated_queue);
+	RUN_TEST(enqueue_batch_new_minimum_updates_min_key);
+	RUN_TEST(enqueue_batch_returns_accepted_count_when_full);
+	RUN_TEST(dequeue_until_on_empty_returns_zero);
+	RUN_TEST(dequeue_until_stops_at_key_limit);
+	RUN_TEST(dequeue_until_respects_max_out);
+	RUN_TEST(dequeue_until_bulk_extracts_in_order);
+	RUN_TEST(dequeue_until_bounded_drain_returns_smallest_keys);
+	RUN_TEST(peek_k_returns_smallest_keys_in_order_without_changing_queue);
+	RUN_TEST(iterator_visits_each_element_once_in_order);
+	RUN_TEST(indexed_enqueue_and_dequeue_track_slot);
+	RUN_TEST(remove_root_updates_min_key);
+	RUN_TEST(remove_last_element_empties_queue);
+	RUN_TEST(update_key_moves_element_both_ways);
+	RUN_TEST(indexed_random_removes_and_updates_keep_order);
+	RUN_TEST(dynamic_queue_grows_past_initial_capacity);
+	RUN_TEST(dynamic_fixed_queue_rejects_when_full);
+	RUN_TEST(dynamic_max_capacity_limits_growth);
+	RUN_TEST(dynamic_queue_is_full_after_allocator_refuses_growth);
+	RUN_TEST(dynamic_queue_shrinks_and_releases_through_allocator);
+	RUN_TEST(dynamic_queue_shrink_keeps_room_for_every_element);
+	RUN_TEST(dynamic_indexed_queue_supports_remove);
+	RUN_TEST(aggregates_follow_every_way_in_and_out);
+	RUN_TEST(removing_the_maximum_defers_its_rescan);
+	RUN_TEST(set_get_cost_recomputes_aggregates_of_a_queue_in_use);
+#if PRIORITY_QUEUE_ARITY == 2
+	RUN_TEST(keys_track_items);
+#endif
+#ifdef PRIORITY_QUEUE_STATS
+	RUN_TEST(stats_count_comparisons_moves_and_depths);
+	RUN_TEST(stats_count_rejections_and_survive_clear);
+#endif
 
 	return UnityEnd();
 }
@@ -0,0 +1,183 @@
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "vendor/unity.h"
+#include "priority_queue_timer.h"
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+	size_t   queue_index;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+#define MS UINT64_C(1000000)
+
+struct priority_queue_timer tpq;
+
+void
+setUp(void)
+{
+	struct priority_queue_config config = { .capacity     = 64,
+		                                .growth       = PRIORITY_QUEUE_GROWTH_FIXED,
+		                                .indexed      = true,
+		                                .index_offset = offsetof(struct sandbox_request, queue_index) };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_initialize_dynamic(&tpq, sandbox_request_get_key,
+	                                                                 CLOCK_MONOTONIC, &config));
+}
+
+void
+tearDown(void)
+{
+	priority_queue_timer_destroy(&tpq);
+}
+
+/* Reports whether the timerfd is readable, waiting at most timeout_ms */
+static bool
+fd_is_readable(int timeout_ms)
+{
+	struct pollfd pfd = { .fd = priority_queue_timer_fd(&tpq), .events = POLLIN };
+	return poll(&pfd, 1, timeout_ms) == 1 && (pfd.revents & POLLIN) != 0;
+}
+
+/* Returns the time left until the timerfd fires, 0 when disarmed */
+static uint64_t
+timer_remaining(void)
+{
+	struct itimerspec spec;
+	TEST_ASSERT_EQUAL_INT(0, timerfd_gettime(priority_queue_timer_fd(&tpq), &spec));
+	return (uint64_t)spec.it_value.tv_sec * 1000 * MS + (uint64_t)spec.it_value.tv_nsec;
+}
+
+void
+epoll_wakes_at_the_earliest_deadline(void)
+{
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	TEST_ASSERT_TRUE(epfd >= 0);
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = &tpq };
+	TEST_ASSERT_EQUAL_INT(0, epoll_ctl(epfd, EPOLL_CTL_ADD, priority_queue_timer_fd(&tpq), &event));
+
+	uint64_t               now   = priority_queue_timer_now(&tpq);
+	struct sandbox_request later = { now + 10000 * MS, 0 }, soon = { now + 20 * MS, 0 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &later));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &soon));
+
+	struct epoll_event ready;
+	TEST_ASSERT_EQUAL_INT(1, epoll_wait(epfd, &ready, 1, 5000));
+	TEST_ASSERT_EQUAL_PTR(&tpq, ready.data.ptr);
+	TEST_ASSERT_TRUE(priority_queue_timer_now(&tpq) >= soon.absolute_deadline);
+
+	void *out[4];
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_timer_dispatch(&tpq, out, 4));
+	TEST_ASSERT_EQUAL_PTR(&soon, out[0]);
+
+	// The readiness was consumed and the timer now waits for the later deadline
+	TEST_ASSERT_EQUAL_INT(0, epoll_wait(epfd, &ready, 1, 0));
+	TEST_ASSERT_EQUAL_UINT64(later.absolute_deadline, tpq.armed_key);
+	close(epfd);
+}
+
+void
+dispatch_delivers_expired_elements_in_batches(void)
+{
+	uint64_t               now = priority_queue_timer_now(&tpq);
+	struct sandbox_request expired[10], pending = { now + 10000 * MS, 0 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &pending));
+	for (size_t i = 0; i < 10; i++) {
+		expired[i].absolute_deadline = now - 10 * MS + (9 - i) * MS;
+		TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &expired[i]));
+	}
+	TEST_ASSERT_TRUE(fd_is_readable(1000));
+
+	// A batch smaller than the backlog leaves the timer armed in the past, so the fd stays readable
+	void *out[10];
+	TEST_ASSERT_EQUAL_UINT(4, priority_queue_timer_dispatch(&tpq, out, 4));
+	for (size_t i = 0; i < 4; i++) TEST_ASSERT_EQUAL_PTR(&expired[9 - i], out[i]);
+	TEST_ASSERT_TRUE(fd_is_readable(1000));
+
+	TEST_ASSERT_EQUAL_UINT(6, priority_queue_timer_dispatch(&tpq, out, 10));
+	for (size_t i = 0; i < 6; i++) TEST_ASSERT_EQUAL_PTR(&expired[5 - i], out[i]);
+	TEST_ASSERT_FALSE(fd_is_readable(0));
+	TEST_ASSERT_EQUAL_UINT(1, priority_queue_length(&tpq.queue));
+
+	// Dispatching before anything is due delivers nothing and keeps the timer
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_timer_dispatch(&tpq, out, 10));
+	TEST_ASSERT_EQUAL_UINT64(pending.absolute_deadline, tpq.armed_key);
+}
+
+void
+timer_rearms_only_when_the_root_changes(void)
+{
+	uint64_t               now    = priority_queue_timer_now(&tpq);
+	struct sandbox_request first  = { now + 10000 * MS, 0 }, behind = { now + 20000 * MS, 0 },
+	                       before = { now + 5000 * MS, 0 };
+	TEST_ASSERT_EQUAL_UINT64(0, timer_remaining());
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &first));
+	TEST_ASSERT_EQUAL_UINT64(first.absolute_deadline, tpq.armed_key);
+	TEST_ASSERT_TRUE(timer_remaining() > 5000 * MS);
+
+	// Behind the root: the timer is left alone
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &behind));
+	TEST_ASSERT_EQUAL_UINT64(first.absolute_deadline, tpq.armed_key);
+	TEST_ASSERT_TRUE(timer_remaining() <= 10000 * MS);
+
+	// A new root moves the timer forward, and dequeuing it moves the timer back
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &before));
+	TEST_ASSERT_EQUAL_UINT64(before.absolute_deadline, tpq.armed_key);
+	TEST_ASSERT_TRUE(timer_remaining() <= 5000 * MS);
+
+	TEST_ASSERT_EQUAL_PTR(&before, priority_queue_timer_dequeue(&tpq));
+	TEST_ASSERT_EQUAL_UINT64(first.absolute_deadline, tpq.armed_key);
+	TEST_ASSERT_TRUE(timer_remaining() > 5000 * MS);
+
+	// Draining the queue disarms the timer
+	TEST_ASSERT_EQUAL_PTR(&first, priority_queue_timer_dequeue(&tpq));
+	TEST_ASSERT_EQUAL_PTR(&behind, priority_queue_timer_dequeue(&tpq));
+	TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, tpq.armed_key);
+	TEST_ASSERT_EQUAL_UINT64(0, timer_remaining());
+	TEST_ASSERT_NULL(priority_queue_timer_dequeue(&tpq));
+}
+
+void
+rearm_follows_direct_queue_changes(void)
+{
+	uint64_t               now    = priority_queue_timer_now(&tpq);
+	struct sandbox_request zero   = { 0, 0 }, future = { now + 10000 * MS, 0 };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_enqueue(&tpq, &future));
+	TEST_ASSERT_FALSE(fd_is_readable(0));
+
+	// A deadline of 0 still fires rather than disarming the timer
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&tpq.queue, &zero));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_rearm(&tpq));
+	TEST_ASSERT_TRUE(fd_is_readable(1000));
+
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_remove(&tpq.queue, &zero));
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_timer_rearm(&tpq));
+	void *out[2];
+	TEST_ASSERT_EQUAL_UINT(0, priority_queue_timer_dispatch(&tpq, out, 2));
+	TEST_ASSERT_FALSE(fd_is_readable(0));
+	TEST_ASSERT_EQUAL_UINT64(future.absolute_deadline, tpq.armed_key);
+}
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_timer_test.c");
+	RUN_TEST(epoll_wakes_at_the_earliest_deadline);
+	RUN_TEST(dispatch_delivers_expired_elements_in_batches);
+	RUN_TEST(timer_rearms_only_when_the_root_changes);
+	RUN_TEST(rearm_follows_direct_queue_changes);
+
+	return UnityEnd();
+}
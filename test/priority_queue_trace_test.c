@@ -0,0 +1,180 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vendor/unity.h"
+#include "priority_queue.h"
+#include "priority_queue_trace.h"
+
+struct sandbox_request {
+	uint64_t absolute_deadline;
+};
+
+uint64_t
+sandbox_request_get_key(void *element_raw)
+{
+	struct sandbox_request *element = (struct sandbox_request *)element_raw;
+	return element->absolute_deadline;
+}
+
+#define RING_CAPACITY 8
+
+struct priority_queue_trace        trace;
+struct priority_queue_trace_record ring[RING_CAPACITY];
+
+void
+setUp(void)
+{
+	priority_queue_trace_initialize(&trace, ring, RING_CAPACITY);
+}
+
+void
+tearDown(void)
+{
+}
+
+/* Dumps the trace to a temporary file and loads it back */
+static struct priority_queue_trace_record *
+round_trip(bool anonymize, size_t *count)
+{
+	FILE *file = tmpfile();
+	TEST_ASSERT_NOT_NULL(file);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_trace_dump(&trace, file, anonymize));
+	rewind(file);
+	struct priority_queue_trace_record *records = NULL;
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_trace_load(file, &records, count));
+	fclose(file);
+	return records;
+}
+
+void
+ring_keeps_the_latest_records_in_order(void)
+{
+	for (uint64_t key = 0; key < RING_CAPACITY + 3; key++) {
+		priority_queue_trace_append(&trace, PRIORITY_QUEUE_TRACE_ENQUEUE, 100 + key);
+	}
+	TEST_ASSERT_EQUAL_UINT(RING_CAPACITY, priority_queue_trace_length(&trace));
+
+	size_t                              count;
+	struct priority_queue_trace_record *records = round_trip(false, &count);
+	TEST_ASSERT_EQUAL_UINT(RING_CAPACITY, count);
+	for (size_t i = 0; i < count; i++) {
+		TEST_ASSERT_EQUAL_UINT64(103 + i, records[i].key);
+		TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_TRACE_ENQUEUE, priority_queue_trace_record_op(&records[i]));
+		if (i > 0) {
+			TEST_ASSERT_TRUE(priority_queue_trace_record_time(&records[i])
+			                 >= priority_queue_trace_record_time(&records[i - 1]));
+		}
+	}
+	free(records);
+}
+
+void
+anonymized_dump_rebases_keys_and_keeps_operations(void)
+{
+	priority_queue_trace_append(&trace, PRIORITY_QUEUE_TRACE_ENQUEUE, 5000);
+	priority_queue_trace_append(&trace, PRIORITY_QUEUE_TRACE_ENQUEUE, 4000);
+	priority_queue_trace_append(&trace, PRIORITY_QUEUE_TRACE_DEQUEUE, 4000);
+	priority_queue_trace_append(&trace, PRIORITY_QUEUE_TRACE_CLEAR, 0);
+
+	size_t                              count;
+	struct priority_queue_trace_record *records = round_trip(true, &count);
+	TEST_ASSERT_EQUAL_UINT(4, count);
+	const uint64_t                     keys[] = { 1000, 0, 0, 0 };
+	const enum priority_queue_trace_op ops[]  = { PRIORITY_QUEUE_TRACE_ENQUEUE, PRIORITY_QUEUE_TRACE_ENQUEUE,
+		                                      PRIORITY_QUEUE_TRACE_DEQUEUE, PRIORITY_QUEUE_TRACE_CLEAR };
+	for (size_t i = 0; i < count; i++) {
+		TEST_ASSERT_EQUAL_UINT64(keys[i], records[i].key);
+		TEST_ASSERT_EQUAL_INT(ops[i], priority_queue_trace_record_op(&records[i]));
+	}
+	free(records);
+}
+
+void
+load_rejects_files_that_are_not_traces(void)
+{
+	priority_queue_trace_append(&trace, PRIORITY_QUEUE_TRACE_ENQUEUE, 1);
+	FILE *file = tmpfile();
+	TEST_ASSERT_NOT_NULL(file);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_trace_dump(&trace, file, false));
+
+	struct priority_queue_trace_header header;
+	struct priority_queue_trace_record record, *records;
+	size_t                             count;
+	rewind(file);
+	TEST_ASSERT_EQUAL_UINT(1, fread(&header, sizeof(header), 1, file));
+	TEST_ASSERT_EQUAL_UINT(1, fread(&record, sizeof(record), 1, file));
+
+	// Truncated: the header promises one more record than the file holds
+	header.count = 2;
+	rewind(file);
+	TEST_ASSERT_EQUAL_UINT(1, fwrite(&header, sizeof(header), 1, file));
+	rewind(file);
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_TRACE_BAD_FORMAT, priority_queue_trace_load(file, &records, &count));
+
+	// An operation this version does not know
+	header.count = 1;
+	record.stamp |= 0xFF;
+	rewind(file);
+	TEST_ASSERT_EQUAL_UINT(1, fwrite(&header, sizeof(header), 1, file));
+	TEST_ASSERT_EQUAL_UINT(1, fwrite(&record, sizeof(record), 1, file));
+	rewind(file);
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_TRACE_BAD_FORMAT, priority_queue_trace_load(file, &records, &count));
+
+	header.magic = 0;
+	rewind(file);
+	TEST_ASSERT_EQUAL_UINT(1, fwrite(&header, sizeof(header), 1, file));
+	rewind(file);
+	TEST_ASSERT_EQUAL_INT(PRIORITY_QUEUE_TRACE_BAD_FORMAT, priority_queue_trace_load(file, &records, &count));
+	fclose(file);
+}
+
+#ifdef PRIORITY_QUEUE_TRACE
+void
+queue_records_enqueues_dequeues_and_clears(void)
+{
+	struct priority_queue        pq;
+	struct priority_queue_config config = { .capacity = 16, .growth = PRIORITY_QUEUE_GROWTH_FIXED };
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_initialize_dynamic(&pq, sandbox_request_get_key, &config));
+
+	struct sandbox_request requests[] = { { 30 }, { 10 }, { 20 }, { 40 } };
+	void                  *batch[]    = { &requests[2], &requests[3] }, *out[4];
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &requests[0]));
+	priority_queue_set_trace(&pq, &trace);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &requests[1]));
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_enqueue_batch(&pq, batch, 2));
+	TEST_ASSERT_EQUAL_PTR(&requests[1], priority_queue_dequeue(&pq));
+	TEST_ASSERT_EQUAL_UINT(2, priority_queue_dequeue_until(&pq, 30, out, 4));
+	priority_queue_clear(&pq);
+	priority_queue_set_trace(&pq, NULL);
+	TEST_ASSERT_EQUAL_INT(0, priority_queue_enqueue(&pq, &requests[0]));
+
+	const uint64_t                     keys[] = { 10, 20, 40, 10, 20, 30, 0 };
+	const enum priority_queue_trace_op ops[]  = { PRIORITY_QUEUE_TRACE_ENQUEUE, PRIORITY_QUEUE_TRACE_ENQUEUE,
+		                                      PRIORITY_QUEUE_TRACE_ENQUEUE, PRIORITY_QUEUE_TRACE_DEQUEUE,
+		                                      PRIORITY_QUEUE_TRACE_DEQUEUE, PRIORITY_QUEUE_TRACE_DEQUEUE,
+		                                      PRIORITY_QUEUE_TRACE_CLEAR };
+	TEST_ASSERT_EQUAL_UINT(7, priority_queue_trace_length(&trace));
+	for (size_t i = 0; i < 7; i++) {
+		TEST_ASSERT_EQUAL_UINT64(keys[i], ring[i].key);
+		TEST_ASSERT_EQUAL_INT(ops[i], priority_queue_trace_record_op(&ring[i]));
+	}
+	priority_queue_destroy(&pq);
+}
+#endif
+
+int
+main(void)
+{
+	UnityBegin("priority_queue_trace_test.c");
+	RUN_TEST(ring_keeps_the_latest_records_in_order);
+	RUN_TEST(anonymized_dump_rebases_keys_and_keeps_operations);
+	RUN_TEST(load_rejects_files_that_are_not_traces);
+#ifdef PRIORITY_QUEUE_TRACE
+	RUN_TEST(queue_records_enqueues_dequeues_and_clears);
+#endif
+
+	return UnityEnd();
+}
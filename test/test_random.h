@@ -0,0 +1,19 @@
+#ifndef TEST_RANDOM_H
+#define TEST_RANDOM_H
+
+#include <stdint.h>
+
+/* Default seed for next_random_key, the 64-bit golden ratio */
+#define TEST_RANDOM_SEED UINT64_C(0x9E3779B97F4A7C15)
+
+/* xorshift64, so key sequences are reproducible across runs and platforms */
+static inline uint64_t
+next_random_key(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+#endif /* TEST_RANDOM_H */